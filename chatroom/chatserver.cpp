@@ -3,6 +3,7 @@
 #include "chatservice.hpp"
 #include <functional>
 #include "zy/log.h"
+#include "zy/frame_codec.h"
 
 
 using namespace std;
@@ -27,19 +28,19 @@ ChatServer::~ChatServer() {
 
 void ChatServer::handleClient(const Socket::ptr &client)
 {
-    string buf;
-    size_t len;
+    // 客户端的每条 JSON 消息以 '\0' 结尾，一次 recv 可能收到多条或者半条，由分帧器切分
+    // 接收缓冲区在连接的整个生命周期内复用，块从缓冲区块池借出
+    FrameCodec::ptr codec = FrameCodec::Delimited(std::make_shared<Connection>(client), '\0', 1024 * 1024);
+    StringView frame;
     while (true)
     {
-        buf.resize(4096);
-        // 反序列化
-        len = client->recv(&buf[0], buf.size());
-        if (len > 0)
+        FrameCodec::Status status = codec->readFrame(frame);
+        if (status == FrameCodec::FRAME)
         {
-            buf.resize(len);
+            // 反序列化
             try
             {
-                json js = json::parse(buf);
+                json js = json::parse(frame.begin(), frame.end());
                 auto msgHandler = ChatService::getInstance().getHandler(js["msgid"].get<int>());
                 msgHandler(client, js);
             }
@@ -53,8 +54,13 @@ void ChatServer::handleClient(const Socket::ptr &client)
                 ZY_LOG_ERROR(ZY_LOG_ROOT()) << "Exception: " << e.what();
             }
         }
-        else if (len == 0)
+        else
         {
+            // 对端关闭，或者接收出错（包括超时和超长的消息）
+            if (status != FrameCodec::CLOSED)
+            {
+                ZY_LOG_ERROR(ZY_LOG_ROOT()) << "recv() failed, errno = " << errno;
+            }
             ZY_LOG_INFO(ZY_LOG_ROOT()) << "client " << client->getPeerAddress()->toString() << " is gone";
             // 处理连接关闭或错误情况
             // TODO:改为shutdown实现优雅关闭
@@ -63,10 +69,6 @@ void ChatServer::handleClient(const Socket::ptr &client)
             break;
             // 或者执行其他清理操作
         }
-        else
-        {
-            ZY_LOG_ERROR(ZY_LOG_ROOT()) << "recv() failed";
-        }
     }
     //ZY_LOG_INFO(ZY_LOG_ROOT()) << "handleClient end";
-}
\ No newline at end of file
+}
@@ -41,6 +41,48 @@ MsgHandler ChatService::getHandler(int msgid)
     return msgHandlerMap_[msgid];
 }
 
+// 发给客户端的每条消息都带上结尾的 '\0'，和客户端发来的格式一致，多条消息合并发送时客户端据此切分
+
+void ChatService::reply(const Socket::ptr &client, const string &msg)
+{
+    Connection::ptr conn;
+    {
+        Mutex::Lock lock(clientMutex_);
+        for (auto &item : userConnMap_)
+        {
+            if (item.second->getSocket() == client)
+            {
+                conn = item.second;
+                break;
+            }
+        }
+    }
+    if (!conn)
+    {
+        // 还没有登录，套接字上没有其他写入者
+        conn = std::make_shared<Connection>(client);
+    }
+    conn->writeBuffered(msg.c_str(), msg.length() + 1);
+}
+
+bool ChatService::deliver(int userid, const string &msg)
+{
+    auto it = userConnMap_.find(userid);
+    if (it != userConnMap_.end())
+    {
+        // 写入连接的输出缓冲，当前协程让出后统一发送
+        it->second->writeBuffered(msg.c_str(), msg.length() + 1);
+        return true;
+    }
+    auto pending = loginPendingMap_.find(userid);
+    if (pending != loginPendingMap_.end())
+    {
+        pending->second.push_back(msg);
+        return true;
+    }
+    return false;
+}
+
 // 处理登录业务 id pwd pwd
 void ChatService::login(const Socket::ptr &client, json &js)
 {
@@ -58,15 +100,15 @@ void ChatService::login(const Socket::ptr &client, json &js)
             response["msgid"] = LOGIN_MSG_ACK;
             response["errno"] = 2;
             response["errmsg"] = "this account is using, input another!";
-            string s = response.dump();
-            client->send(s.c_str(), s.length());
+            reply(client, response.dump());
         }
         else
         {
             // 登录成功，更新用户状态信息 state offline => online
             {
+                // 从现在起转发给该用户的消息先暂存，等登录应答发出之后再写入连接
                 Mutex::Lock lock(clientMutex_);
-                userConnMap_.insert({id, client});
+                loginPendingMap_[id];
             }
 
             // id用户登录成功后，向redis订阅channel
@@ -133,9 +175,24 @@ void ChatService::login(const Socket::ptr &client, json &js)
                 response["groups"] = groupV;
             }
 
-
+            // 一轮中转发给同一个用户的多条消息合并成一次 writev；连接还没有登记，应答是它的第一条消息
+            Connection::ptr conn = std::make_shared<Connection>(client);
+            conn->setOutputBuffer();
             string s = response.dump();
-            client->send(s.c_str(), s.length());
+            conn->writeBuffered(s.c_str(), s.length() + 1);
+            {
+                Mutex::Lock lock(clientMutex_);
+                auto pending = loginPendingMap_.find(id);
+                if (pending != loginPendingMap_.end())
+                {
+                    for (const string &msg : pending->second)
+                    {
+                        conn->writeBuffered(msg.c_str(), msg.length() + 1);
+                    }
+                    loginPendingMap_.erase(pending);
+                }
+                userConnMap_.insert({id, conn});
+            }
         }
     }
     else
@@ -146,8 +203,7 @@ void ChatService::login(const Socket::ptr &client, json &js)
         response["errno"] = 1;
         response["errmsg"] = "wrong id or password";
         // 注册已经失败，不需要在json返回id
-        string s = response.dump();
-        client->send(s.c_str(), s.length());
+        reply(client, response.dump());
     }
 }
 
@@ -169,8 +225,7 @@ void ChatService::reg(const Socket::ptr &client, json &js)
         response["errno"] = 0;
         response["id"] = user.getId();
         // json::dump() 将序列化信息转换为std::string
-        string s = response.dump();
-        client->send(s.c_str(), s.length());
+        reply(client, response.dump());
     }
     else
     {
@@ -179,8 +234,7 @@ void ChatService::reg(const Socket::ptr &client, json &js)
         response["msgid"] = REGISTER_MSG_ACK;
         response["errno"] = 1;
         // 注册已经失败，不需要在json返回id
-        string s = response.dump();
-        client->send(s.c_str(), s.length());
+        reply(client, response.dump());
     }
 }
 
@@ -212,13 +266,9 @@ void ChatService::oneChatHandler(const Socket::ptr &client, json &js)
 
     {
         Mutex::Lock lock(clientMutex_);
-        auto it = userConnMap_.find(toId);
         // 确认是在线状态
-        if (it != userConnMap_.end())
+        if (deliver(toId, js.dump()))
         {
-            // TcpConnection::send() 直接发送消息
-            string s = js.dump();
-            it->second->send(s.c_str(), s.length());
             return;
         }
     }
@@ -244,7 +294,7 @@ void ChatService::clientCloseException(const Socket::ptr &client)
         Mutex::Lock lock(clientMutex_);
         for (auto it = userConnMap_.begin(); it != userConnMap_.end(); ++it)
         {
-            if (it->second == client)
+            if (it->second->getSocket() == client)
             {
                 // 从map表删除用户的链接信息
                 user.setId(it->first);
@@ -309,13 +359,8 @@ void ChatService::groupChat(const Socket::ptr &client, json &js)
     Mutex::Lock lock(clientMutex_);
     for (int id : userIdVec)
     {
-        auto it = userConnMap_.find(id);
-        if (it != userConnMap_.end())
-        {
-            // 转发群消息
-            it->second->send(s.c_str(), s.length());
-        }
-        else
+        // 转发群消息
+        if (!deliver(id, s))
         {
             // 查询toid是否在线
             User user = userModel_.query(id);
@@ -337,10 +382,8 @@ void ChatService::groupChat(const Socket::ptr &client, json &js)
 void ChatService::handleRedisSubscribeMessage(int userid, string msg)
 {
     Mutex::Lock lock(clientMutex_);
-    auto it = userConnMap_.find(userid);
-    if (it != userConnMap_.end())
+    if (deliver(userid, msg))
     {
-        it->second->send(msg.c_str(), msg.length());
         return;
     }
 
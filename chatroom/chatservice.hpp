@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <functional>
 #include "../zy/socket.h"
+#include "../zy/connection.h"
 #include "../thirdparty/json.hpp"
 
 #include "model/usermodel.hpp"
@@ -58,11 +59,17 @@ public:
 
 private:
     ChatService();
+    // 回复客户端，已经登录的客户端走它的连接，和转发给它的消息保持顺序
+    void reply(const Socket::ptr &client, const string &msg);
+    // 把消息交给本机在线或者正在登录的用户，调用者持有 clientMutex_，用户不在本机时返回 false
+    bool deliver(int userid, const string &msg);
     // 存储消息id和其对应的业务处理方法
     unordered_map<int, MsgHandler> msgHandlerMap_;
 
-    // 存储在线用户的通信连接
-    unordered_map<int, Socket::ptr> userConnMap_;
+    // 存储在线用户的通信连接，转发给用户的消息经过连接的输出缓冲合并发送
+    unordered_map<int, Connection::ptr> userConnMap_;
+    // 正在登录的用户，登录应答发出之前转发给他们的消息暂存在这里，应答之后按顺序写入连接
+    unordered_map<int, vector<string>> loginPendingMap_;
 
     // 数据操作类对象
     UserModel userModel_;
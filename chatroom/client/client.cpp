@@ -286,18 +286,28 @@ void doLoginResponse(json &responsejs)
 // 子线程 - 接收线程
 void readTaskHandler(int clientfd)
 {
+    // 服务器的每条消息以 '\0' 结尾，一次 recv 可能收到多条或者半条，没收完的部分留到下一次
+    string pending;
     for (;;)
     {
-        char buffer[1024] = {0};
-        int len = recv(clientfd, buffer, 1024, 0);  // 阻塞了
-        if (-1 == len || 0 == len)
+        size_t end = pending.find('\0');
+        if (end == string::npos)
         {
-            close(clientfd);
-            exit(-1);
+            char buffer[1024];
+            int len = recv(clientfd, buffer, 1024, 0);  // 阻塞了
+            if (-1 == len || 0 == len)
+            {
+                close(clientfd);
+                exit(-1);
+            }
+            pending.append(buffer, len);
+            continue;
         }
+        string message = pending.substr(0, end);
+        pending.erase(0, end + 1);
 
         // 接收ChatServer转发的数据，反序列化生成json数据对象
-        json js = json::parse(buffer);
+        json js = json::parse(message);
         int msgtype = js["msgid"].get<int>();
         if (ONE_CHAT_MSG == msgtype)
         {
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include "byte_array.h"
+#include "clock.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+/// 每轮编码的数值个数
+static const size_t COUNT = 1 << 20;
+/// 轮数
+static const int ROUNDS = 20;
+
+/**
+ * @brief 逐个 writeInt/readInt 和 writeArray/readArray 的吞吐
+ */
+template<typename T>
+static void bench_array(const char *name) {
+    std::vector<T> vals(COUNT), out(COUNT);
+    std::mt19937_64 rng(1);
+    for (auto &v : vals) {
+        v = static_cast<T>(rng());
+    }
+
+    ByteArray ba;
+    uint64_t begin = Clock::NowUs();
+    for (int r = 0; r < ROUNDS; ++r) {
+        for (T v : vals) {
+            ba.writeInt<T>(v);
+        }
+        for (T &v : out) {
+            v = ba.readInt<T>();
+        }
+    }
+    uint64_t single = Clock::NowUs() - begin;
+    ZY_ASSERT(out == vals);
+
+    begin = Clock::NowUs();
+    for (int r = 0; r < ROUNDS; ++r) {
+        ba.writeArray(vals.data(), vals.size());
+        ba.readArray(out.data(), out.size());
+    }
+    uint64_t bulk = Clock::NowUs() - begin;
+    ZY_ASSERT(out == vals);
+
+    uint64_t bytes = 2ull * ROUNDS * COUNT * sizeof(T);
+    std::cout << std::setw(10) << name << std::setw(14) << bytes / single << std::setw(14) << bytes / bulk << std::endl;
+}
+
+/**
+ * @brief 小数值的定长编码和变长编码的大小与速度
+ */
+static void bench_varint() {
+    std::vector<int64_t> vals(COUNT);
+    std::mt19937_64 rng(1);
+    // 典型的 id、长度和差值：大部分很小，有正有负
+    for (auto &v : vals) {
+        v = static_cast<int64_t>(rng() % 20000) - 10000;
+    }
+
+    ByteArray ba;
+    uint64_t begin = Clock::NowUs();
+    for (int64_t v : vals) {
+        ba.writeInt<int64_t>(v);
+    }
+    size_t fixed_size = ba.getReadableSize();
+    for (size_t i = 0; i < COUNT; ++i) {
+        ZY_ASSERT(ba.readInt<int64_t>() == vals[i]);
+    }
+    uint64_t fixed = Clock::NowUs() - begin;
+
+    begin = Clock::NowUs();
+    for (int64_t v : vals) {
+        ba.writeVarint<int64_t>(v);
+    }
+    size_t varint_size = ba.getReadableSize();
+    for (size_t i = 0; i < COUNT; ++i) {
+        ZY_ASSERT(ba.readVarint<int64_t>() == vals[i]);
+    }
+    uint64_t varint = Clock::NowUs() - begin;
+
+    std::cout << std::setw(10) << "fixed" << std::setw(14) << fixed_size << std::setw(14) << fixed << std::endl;
+    std::cout << std::setw(10) << "varint" << std::setw(14) << varint_size << std::setw(14) << varint << std::endl;
+}
+
+/**
+ * @brief 比较逐个转换字节序和整体转换（SSSE3 pshufb）的吞吐，以及变长编码对小数值的压缩
+ */
+int main() {
+    std::cout << std::setw(10) << "type" << std::setw(14) << "single MB/s" << std::setw(14) << "array MB/s" << std::endl;
+    bench_array<uint16_t>("uint16_t");
+    bench_array<uint32_t>("uint32_t");
+    bench_array<uint64_t>("uint64_t");
+    std::cout << std::endl << std::setw(10) << "int64_t" << std::setw(14) << "bytes" << std::setw(14) << "us" << std::endl;
+    bench_varint();
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include "reactor.h"
+#include "socket.h"
+#include "connection.h"
+#include "clock.h"
+#include "utils/macro.h"
+#include "test_util.h"
+
+using namespace zy;
+
+/// 每种长度发送的总字节数
+static const size_t TOTAL_BYTES = 256 * 1024 * 1024;
+
+/**
+ * @brief 原来的实现：先收发到临时的 std::string，再和字节数组互相拷贝
+ */
+class CopyingConnection : public Connection {
+public:
+    using Connection::Connection;
+    using Connection::read;
+    using Connection::write;
+
+    size_t read(ByteArray::ptr byte_array, size_t length) override {
+        std::string buffer;
+        buffer.resize(length);
+        size_t len = getSocket()->recv(&buffer[0], buffer.size());
+        if (len == 0 || len == static_cast<size_t>(-1)) {
+            return len;
+        }
+        byte_array->write(buffer.data(), len);
+        copied_ += len;
+        return len;
+    }
+
+    size_t write(ByteArray::ptr byte_array, size_t length) override {
+        std::string buffer;
+        buffer.resize(length);
+        byte_array->read(&buffer[0], length);
+        copied_ += length;
+        // 拷贝出来的数据已经从字节数组中消耗掉，必须全部发送
+        size_t offset = 0;
+        while (offset < length) {
+            size_t len = getSocket()->send(buffer.data() + offset, length - offset);
+            if (len == 0 || len == static_cast<size_t>(-1)) {
+                return len;
+            }
+            offset += len;
+        }
+        return length;
+    }
+
+    size_t getCopied() const { return copied_; }
+
+private:
+    size_t copied_ = 0;
+};
+
+/**
+ * @brief 用 length 大小的消息经过字节数组收发 TOTAL_BYTES 字节
+ * @param copied 输出参数，用户态在字节数组和临时缓冲区之间拷贝的字节数
+ * @return 发送端和接收端都完成的耗时
+ */
+static uint64_t run(size_t length, bool copying, uint64_t &copied) {
+    uint64_t elapsed = 0;
+    {
+        Reactor r("bench", 1);
+        r.addTask([length, copying, &elapsed, &copied]() {
+            Socket::ptr client, server;
+            make_pair(client, server);
+            std::shared_ptr<Connection> reader, writer;
+            if (copying) {
+                reader = std::make_shared<CopyingConnection>(client);
+                writer = std::make_shared<CopyingConnection>(server);
+            } else {
+                reader = std::make_shared<Connection>(client);
+                writer = std::make_shared<Connection>(server);
+            }
+
+            bool done = false;
+            Reactor::GetThis()->addTask([reader, length, &done]() {
+                ByteArray::ptr in(new ByteArray);
+                for (size_t received = 0; received < TOTAL_BYTES; received += length) {
+                    ZY_ASSERT(reader->readFixSize(in, length) == length);
+                    in->hasRead(length);
+                }
+                done = true;
+            });
+
+            std::string data(length, 'z');
+            ByteArray::ptr out(new ByteArray);
+            uint64_t begin = Clock::NowUs();
+            for (size_t sent = 0; sent < TOTAL_BYTES; sent += length) {
+                out->write(data.data(), data.size());
+                ZY_ASSERT(writer->writeFixSize(out, length) == length);
+            }
+            while (!done) {
+                usleep(100);
+            }
+            elapsed = Clock::NowUs() - begin;
+            if (copying) {
+                copied = std::static_pointer_cast<CopyingConnection>(reader)->getCopied()
+                         + std::static_pointer_cast<CopyingConnection>(writer)->getCopied();
+            } else {
+                copied = 0;
+            }
+            server->close();
+        });
+    }
+    return elapsed;
+}
+
+/**
+ * @brief 比较经过临时缓冲区拷贝和直接用字节数组的块收发的吞吐
+ * @note 两种方式填充发送数组的那次拷贝相同，copied 只统计 Connection 内部多出来的拷贝
+ */
+int main() {
+    std::cout << std::setw(10) << "length" << std::setw(14) << "copy MB/s" << std::setw(14) << "copied MB"
+              << std::setw(14) << "iovec MB/s" << std::setw(14) << "copied MB" << std::endl;
+    for (size_t length : {256, 4096, 65536, 1024 * 1024}) {
+        uint64_t copy_copied = 0, iovec_copied = 0;
+        uint64_t copy = run(length, true, copy_copied);
+        uint64_t iovec = run(length, false, iovec_copied);
+        std::cout << std::setw(10) << length
+                  << std::setw(14) << TOTAL_BYTES / copy << std::setw(14) << (copy_copied >> 20)
+                  << std::setw(14) << TOTAL_BYTES / iovec << std::setw(14) << (iovec_copied >> 20) << std::endl;
+    }
+    return 0;
+}
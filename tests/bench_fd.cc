@@ -0,0 +1,75 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include "reactor.h"
+#include "hook.h"
+#include "clock.h"
+#include "file_descriptor.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+static const size_t LOOPS = 2 * 1000 * 1000;
+
+struct Result {
+    std::atomic<uint64_t> get_ns{0};
+    std::atomic<uint64_t> raw_ns{0};
+    std::atomic<uint64_t> hooked_ns{0};
+};
+
+/**
+ * @brief 在一个非阻塞的 socket 上反复 recv，没有数据，每次都立即返回 EAGAIN：
+ * 原始 recv 的耗时是系统调用本身，hook 后多出来的就是查找文件描述符上下文的开销
+ */
+static void bench_one(Result &result) {
+    int sv[2];
+    ZY_ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) == 0);
+    // socketpair 没有被 hook，手动创建上下文，创建时已经非阻塞，记为用户设置的非阻塞
+    FdMgr::GetInstance().get(sv[0], true);
+    char c;
+
+    uint64_t sink = 0;
+    uint64_t begin = Clock::NowNs();
+    for (size_t i = 0; i < LOOPS; ++i) {
+        auto ctx = FdMgr::GetInstance().get(sv[0]);
+        sink += ctx->isSocket();
+    }
+    result.get_ns += (Clock::NowNs() - begin) / LOOPS;
+    ZY_ASSERT(sink == LOOPS);
+
+    begin = Clock::NowNs();
+    for (size_t i = 0; i < LOOPS / 10; ++i) {
+        ZY_ASSERT(recv_f(sv[0], &c, 1, 0) == -1);
+    }
+    result.raw_ns += (Clock::NowNs() - begin) / (LOOPS / 10);
+
+    begin = Clock::NowNs();
+    for (size_t i = 0; i < LOOPS / 10; ++i) {
+        ZY_ASSERT(recv(sv[0], &c, 1, 0) == -1);
+    }
+    result.hooked_ns += (Clock::NowNs() - begin) / (LOOPS / 10);
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int main() {
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "get ns/op"
+              << std::setw(14) << "raw recv ns" << std::setw(16) << "hooked recv ns" << std::endl;
+    for (uint32_t threads : {1, 2, 4, 8}) {
+        Result result;
+        {
+            Reactor r("bench_fd", threads - 1);
+            for (uint32_t i = 0; i < threads; ++i) {
+                r.addTask([&result]() { bench_one(result); });
+            }
+        }
+        std::cout << std::setw(8) << threads
+                  << std::setw(14) << result.get_ns / threads
+                  << std::setw(14) << result.raw_ns / threads
+                  << std::setw(16) << result.hooked_ns / threads << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include "reactor.h"
+#include "socket.h"
+#include "connection.h"
+#include "clock.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+/// 负载大小
+static const size_t PAYLOAD = 256 * 1024 * 1024;
+/// 每次写入的大小
+static const size_t CHUNK = 64 * 1024;
+
+/**
+ * @brief 读取 /proc/self/status 中的一项，单位 KB
+ */
+static size_t proc_status(const std::string &key) {
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, key.size(), key) == 0) {
+            return std::stoul(line.substr(key.size() + 1));
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 构造负载后通过回环连接发送，统计构造完成时的常驻内存和发送速度
+ * @param spill 溢出阈值，0 表示只使用内存
+ */
+static void bench(const char *name, size_t spill) {
+    Socket::ptr listener = Socket::CreateTCP();
+    ZY_ASSERT(listener->bind(IPv4Address::Create("127.0.0.1", 0)));
+    ZY_ASSERT(listener->listen());
+    Socket::ptr client = Socket::CreateTCP();
+    ZY_ASSERT(client->connect(listener->getLocalAddress()));
+    Socket::ptr server = listener->accept();
+    ZY_ASSERT(server);
+
+    size_t rss_before = proc_status("VmRSS:");
+    uint64_t begin = Clock::NowUs();
+    ByteArray::ptr ba(new ByteArray());
+    if (spill) {
+        ZY_ASSERT(ba->setSpill(spill));
+    }
+    std::string chunk(CHUNK, 'p');
+    for (size_t i = 0; i < PAYLOAD; i += CHUNK) {
+        ba->write(chunk.data(), chunk.size());
+    }
+    uint64_t fill = Clock::NowUs() - begin;
+    size_t rss = proc_status("VmRSS:");
+
+    Reactor::GetThis()->addTask([server, ba]() {
+        Connection conn(server);
+        ZY_ASSERT(conn.writeFixSize(ba, PAYLOAD) == PAYLOAD);
+        server->close();
+    });
+    begin = Clock::NowUs();
+    std::string buffer(1024 * 1024, '\0');
+    size_t total = 0;
+    while (true) {
+        size_t n = client->recv(&buffer[0], buffer.size());
+        if (n == 0 || n == static_cast<size_t>(-1)) {
+            break;
+        }
+        total += n;
+    }
+    uint64_t send = Clock::NowUs() - begin;
+    ZY_ASSERT(total == PAYLOAD);
+
+    std::cout << std::setw(12) << name
+              << std::setw(12) << (rss - std::min(rss, rss_before)) / 1024
+              << std::setw(12) << PAYLOAD / fill
+              << std::setw(12) << PAYLOAD / send << std::endl;
+}
+
+int main(int argc, char **argv) {
+    Reactor r("bench_spill");
+    r.addTask([]() {
+        std::cout << std::setw(12) << "mode" << std::setw(12) << "RSS MB"
+                  << std::setw(12) << "fill MB/s" << std::setw(12) << "send MB/s" << std::endl;
+        // 只使用内存时块池会缓存释放的块，放在最后
+        bench("spill 1MB", 1024 * 1024);
+        bench("memory", 0);
+    });
+    return 0;
+}
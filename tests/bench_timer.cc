@@ -0,0 +1,166 @@
+#include <set>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <ctime>
+#include "timer.h"
+#include "reactor.h"
+#include "loop_stats.h"
+#include "utils/util.h"
+
+using namespace zy;
+
+/**
+ * @brief 原先基于 std::set<Timer::ptr, Comparator> + RWMutex 的定时器实现，作为对照组
+ */
+class SetTimerManager {
+public:
+    struct SetTimer {
+        using ptr = std::shared_ptr<SetTimer>;
+        uint64_t period_;
+        uint64_t time_;
+        std::function<void()> cb_;
+    };
+
+    struct Comparator {
+        bool operator()(const SetTimer::ptr &lhs, const SetTimer::ptr &rhs) const {
+            if (lhs->time_ != rhs->time_) {
+                return lhs->time_ < rhs->time_;
+            }
+            return lhs.get() < rhs.get();
+        }
+    };
+
+    SetTimer::ptr addTimer(uint64_t period, std::function<void()> cb) {
+        SetTimer::ptr timer(new SetTimer{period, getCurrentTime() + period, std::move(cb)});
+        RWMutex::WriteLock lock(mutex_);
+        timers_.insert(timer);
+        return timer;
+    }
+
+    bool cancel(const SetTimer::ptr &timer) {
+        RWMutex::WriteLock lock(mutex_);
+        auto it = timers_.find(timer);
+        if (it == timers_.end()) {
+            return false;
+        }
+        timers_.erase(it);
+        return true;
+    }
+
+    bool refresh(const SetTimer::ptr &timer) {
+        RWMutex::WriteLock lock(mutex_);
+        auto it = timers_.find(timer);
+        if (it == timers_.end()) {
+            return false;
+        }
+        timers_.erase(it);
+        timer->time_ = getCurrentTime() + timer->period_;
+        timers_.insert(timer);
+        return true;
+    }
+
+private:
+    RWMutex mutex_;
+    std::set<SetTimer::ptr, Comparator> timers_;
+};
+
+static void print(const char *impl, const char *op, size_t n, uint64_t us) {
+    std::cout << std::setw(6) << impl << std::setw(10) << op << std::setw(10) << n
+              << std::setw(12) << us << " us" << std::setw(10) << us * 1000 / n << " ns/op" << std::endl;
+}
+
+/**
+ * @brief 模拟每个连接一个 2 分钟左右的接收超时：全部加入、全部刷新一次、全部取消
+ */
+static void bench(size_t n) {
+    std::mt19937 rng(n);
+    std::uniform_int_distribution<uint64_t> dist(60 * 1000, 180 * 1000);
+    std::vector<uint64_t> periods(n);
+    for (auto &period : periods) {
+        period = dist(rng);
+    }
+
+    {
+        SetTimerManager manager;
+        std::vector<SetTimerManager::SetTimer::ptr> timers(n);
+        uint64_t begin = LoopStats::NowUs();
+        for (size_t i = 0; i < n; ++i) {
+            timers[i] = manager.addTimer(periods[i], [](){});
+        }
+        print("set", "add", n, LoopStats::NowUs() - begin);
+
+        begin = LoopStats::NowUs();
+        for (auto &timer : timers) {
+            manager.refresh(timer);
+        }
+        print("set", "refresh", n, LoopStats::NowUs() - begin);
+
+        begin = LoopStats::NowUs();
+        for (auto &timer : timers) {
+            manager.cancel(timer);
+        }
+        print("set", "cancel", n, LoopStats::NowUs() - begin);
+    }
+
+    {
+        TimerManager manager;
+        // 当前线程成为定时器线程，定时器直接挂在本线程的时间轮上
+        manager.getNextTime();
+        std::vector<Timer::ptr> timers(n);
+        uint64_t begin = LoopStats::NowUs();
+        for (size_t i = 0; i < n; ++i) {
+            timers[i] = manager.addTimer(periods[i], [](){});
+        }
+        print("wheel", "add", n, LoopStats::NowUs() - begin);
+
+        begin = LoopStats::NowUs();
+        for (auto &timer : timers) {
+            timer->refresh();
+        }
+        print("wheel", "refresh", n, LoopStats::NowUs() - begin);
+
+        begin = LoopStats::NowUs();
+        for (auto &timer : timers) {
+            timer->cancel();
+        }
+        print("wheel", "cancel", n, LoopStats::NowUs() - begin);
+    }
+}
+
+/**
+ * @brief 模拟同一秒内接入的大量连接的超时：统计反应堆被唤醒的次数和消耗的 CPU 时间
+ */
+static void bench_wakeups(size_t n, uint32_t slack) {
+    std::mt19937 rng(n);
+    std::uniform_int_distribution<uint64_t> dist(1000, 2000);
+    LoopStats::SetEnabled(true);
+    LoopStatsMgr::GetInstance().reset();
+    std::clock_t cpu_begin = std::clock();
+    {
+        Reactor r("slack");
+        for (size_t i = 0; i < n; ++i) {
+            r.addTimer(dist(rng), [](){}, false, slack);
+        }
+    }
+    uint64_t cpu_us = (std::clock() - cpu_begin) * 1000000 / CLOCKS_PER_SEC;
+    uint64_t wakeups = 0;
+    for (auto &stats : LoopStatsMgr::GetInstance().getAll()) {
+        wakeups += stats->getHistogram(LoopStats::EPOLL_WAIT_US).getCount();
+    }
+    LoopStats::SetEnabled(false);
+    std::cout << std::setw(6) << "slack" << std::setw(10) << slack << std::setw(10) << n
+              << std::setw(12) << wakeups << " wakeups" << std::setw(10) << cpu_us << " us cpu" << std::endl;
+}
+
+int main() {
+    for (size_t n : {10000, 100000, 1000000}) {
+        bench(n);
+    }
+    for (uint32_t slack : {TimerSlack::PRECISE, TimerSlack::FINE, TimerSlack::COARSE}) {
+        bench_wakeups(10000, slack);
+    }
+    return 0;
+}
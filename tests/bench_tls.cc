@@ -0,0 +1,163 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include "reactor.h"
+#include "socket.h"
+#include "secure_socket.h"
+#include "clock.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+/// 握手次数
+static const int HANDSHAKES = 500;
+/// 吞吐测试发送的总字节数
+static const size_t TOTAL_BYTES = 256 * 1024 * 1024;
+/// 吞吐测试每次发送的长度
+static const size_t CHUNK = 64 * 1024;
+
+/**
+ * @brief 建立一对已连接的套接字，server_ctx 为空时是明文，服务端返回前已经完成握手
+ */
+static void make_pair(const TlsContext::ptr &server_ctx, const TlsContext::ptr &client_ctx,
+                      const std::string &host_name, Socket::ptr &client, Socket::ptr &server) {
+    Socket::ptr listener = server_ctx ? SecureSocket::CreateTCP(server_ctx) : Socket::CreateTCP();
+    ZY_ASSERT(listener->bind(IPv4Address::Create("127.0.0.1", 0)));
+    ZY_ASSERT(listener->listen());
+    // 服务端的握手在第一次收发时进行，要和客户端的 connect 并发，握手完成前不能有别的协程使用 server
+    bool ready = false;
+    Reactor::GetThis()->addTask([listener, &server, &ready]() {
+        Socket::ptr accepted = listener->accept();
+        ZY_ASSERT(accepted);
+        char byte;
+        ZY_ASSERT(accepted->recv(&byte, 1) == 1);
+        server = accepted;
+        ready = true;
+    });
+    if (client_ctx) {
+        SecureSocket::ptr secure = SecureSocket::CreateTCP(client_ctx);
+        secure->setHostName(host_name);
+        client = secure;
+    } else {
+        client = Socket::CreateTCP();
+    }
+    ZY_ASSERT(client->connect(listener->getLocalAddress()));
+    ZY_ASSERT(client->send("x", 1) == 1);
+    while (!ready) {
+        usleep(100);
+    }
+}
+
+/**
+ * @brief 握手速率，resume 为 true 时客户端上下文复用会话
+ */
+static void bench_handshake(bool resume) {
+    TlsContext::ptr server_ctx = TlsContext::CreateSelfSigned();
+    TlsContext::ptr client_ctx = TlsContext::CreateClient(false);
+    uint64_t elapsed = 0;
+    int reused = 0;
+    {
+        Reactor r("bench", 1);
+        r.addTask([&]() {
+            uint64_t begin = Clock::NowUs();
+            for (int i = 0; i < HANDSHAKES; ++i) {
+                TlsContext::ptr ctx = resume ? client_ctx : TlsContext::CreateClient(false);
+                Socket::ptr client, server;
+                // 每次的监听端口不同，会话按主机名保存
+                make_pair(server_ctx, ctx, "localhost", client, server);
+                // 读一次回显，TLS 1.3 的会话票据在握手之后才到达
+                ZY_ASSERT(server->send("y", 1) == 1);
+                char byte;
+                ZY_ASSERT(client->recv(&byte, 1) == 1);
+                reused += std::static_pointer_cast<SecureSocket>(client)->isSessionReused();
+            }
+            elapsed = Clock::NowUs() - begin;
+        });
+    }
+    std::cout << std::setw(12) << (resume ? "resumed" : "full") << std::setw(12)
+              << HANDSHAKES * 1000000ull / elapsed << " handshakes/s"
+              << std::setw(8) << reused << " reused" << std::endl;
+}
+
+/**
+ * @brief 单向吞吐
+ * @param tls 是否加密
+ * @param ktls 是否开启 kTLS
+ * @param file 是否用 sendFile 发送
+ */
+static void bench_throughput(bool tls, bool ktls, bool file) {
+    TlsContext::ptr server_ctx, client_ctx;
+    if (tls) {
+        server_ctx = TlsContext::CreateSelfSigned();
+        client_ctx = TlsContext::CreateClient(false);
+        server_ctx->setKTLS(ktls);
+        client_ctx->setKTLS(ktls);
+    }
+
+    std::string path = "/tmp/zy_bench_tls_" + std::to_string(getpid());
+    std::string data(CHUNK, 'z');
+    if (file) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ZY_ASSERT(write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+        close(fd);
+    }
+
+    uint64_t elapsed = 0;
+    bool kernel = false;
+    {
+        Reactor r("bench", 1);
+        r.addTask([&]() {
+            Socket::ptr client, server;
+            make_pair(server_ctx, client_ctx, "localhost", client, server);
+            auto secure = std::dynamic_pointer_cast<SecureSocket>(server);
+            kernel = secure && secure->isKTLSSend();
+
+            Reactor::GetThis()->addTask([client]() {
+                std::string buffer(1024 * 1024, '\0');
+                while (static_cast<ssize_t>(client->recv(&buffer[0], buffer.size())) > 0) {
+                }
+            });
+
+            int fd = file ? open(path.c_str(), O_RDONLY) : -1;
+            uint64_t begin = Clock::NowUs();
+            for (size_t sent = 0; sent < TOTAL_BYTES; sent += CHUNK) {
+                size_t total = 0;
+                while (total < CHUNK) {
+                    size_t n = file ? server->sendFile(fd, total, CHUNK - total)
+                                    : server->send(data.data() + total, CHUNK - total);
+                    ZY_ASSERT(static_cast<ssize_t>(n) > 0);
+                    total += n;
+                }
+            }
+            elapsed = Clock::NowUs() - begin;
+            if (fd != -1) {
+                close(fd);
+            }
+            server->close();
+        });
+    }
+    unlink(path.c_str());
+    std::cout << std::setw(12) << (tls ? (ktls ? "tls+ktls" : "tls") : "plain")
+              << std::setw(10) << (file ? "sendfile" : "send")
+              << std::setw(10) << TOTAL_BYTES / elapsed << " MB/s"
+              << std::setw(10) << (tls ? (kernel ? "kernel" : "user") : "-") << std::endl;
+}
+
+/**
+ * @brief 本机自签名证书上的握手速率和吞吐
+ * @note kTLS 需要内核加载 tls 模块（/proc/sys/net/ipv4/tcp_available_ulp 中有 tls），
+ * 没有时 OpenSSL 静默退回用户态加密，最后一列显示实际的加密位置
+ */
+int main() {
+    bench_handshake(false);
+    bench_handshake(true);
+    for (bool file : {false, true}) {
+        bench_throughput(false, false, file);
+        bench_throughput(true, false, file);
+        bench_throughput(true, true, file);
+    }
+    return 0;
+}
@@ -5,10 +5,19 @@
 
 ChatServer::ptr server;
 uint16_t port;//6000 6002
+// 与 nginx 等同机组件之间走 Unix 域套接字，"/path" 为文件系统路径，"@name" 为抽象地址
+std::string unix_path;
 
 void run() {
     ChatServer::ptr server(new ChatServer("chatserver"));
-    Address::ptr addr = IPv4Address::Create("127.0.0.1", port);
+    Address::ptr addr;
+    if (unix_path.empty()) {
+        addr = IPv4Address::Create("127.0.0.1", port);
+    } else if (unix_path[0] == '@') {
+        addr = UnixAddress::Create(unix_path.substr(1), true);
+    } else {
+        addr = UnixAddress::Create(unix_path);
+    }
     if (!addr) {
         ZY_LOG_DEBUG(ZY_LOG_ROOT()) << "create addr failed!";
     }
@@ -19,7 +28,11 @@ void run() {
 }
 
 int main(int argc, char*argv[]) {
-    port = atoi(argv[1]);
+    if (argv[1][0] == '/' || argv[1][0] == '@') {
+        unix_path = argv[1];
+    } else {
+        port = atoi(argv[1]);
+    }
 
     Reactor r("reactor", 1);
     r.addTask(run);
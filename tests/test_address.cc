@@ -11,7 +11,34 @@ void test_ipv4() {
     std::cout << addr->toString() << std::endl;
 }
 
+void test_ipv6() {
+    auto addr = IPv6Address::Create("fe80::1:2", 8080);
+    if (!addr) {
+        std::cout << "ipv6 address create failed!" << std::endl;
+        return;
+    }
+    std::cout << addr->toString() << " port = " << addr->getPort() << std::endl;
+    if (IPv6Address::Create("fe80::1::2")) {
+        std::cout << "invalid ipv6 address accepted!" << std::endl;
+    }
+}
+
+void test_unix() {
+    auto path = UnixAddress::Create("/tmp/zy.sock");
+    auto abstract = UnixAddress::Create("zy", true);
+    std::cout << path->toString() << " " << abstract->toString() << std::endl;
+
+    // 经过 sockaddr 往返之后路径和长度不变
+    auto copy = Address::Create(abstract->getAddr(), abstract->getAddrLen());
+    std::cout << copy->toString() << " len = " << copy->getAddrLen() << std::endl;
+    if (UnixAddress::Create(std::string(200, 'x'))) {
+        std::cout << "too long unix path accepted!" << std::endl;
+    }
+}
+
 int main(int argc, char *argv[]) {
     test_ipv4();
+    test_ipv6();
+    test_unix();
     return 0;
 }
\ No newline at end of file
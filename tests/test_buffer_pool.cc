@@ -0,0 +1,111 @@
+#include <cstring>
+#include <vector>
+#include "buffer_pool.h"
+#include "byte_array.h"
+#include "thread.h"
+#include "log.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+void test_size_class() {
+    ZY_ASSERT(BufferPool::SizeClass(1) == 0);
+    ZY_ASSERT(BufferPool::SizeClass(256) == 0);
+    ZY_ASSERT(BufferPool::SizeClass(257) == 1);
+    ZY_ASSERT(BufferPool::SizeClass(4096) == 4);
+    ZY_ASSERT(BufferPool::SizeClass(BufferPool::MAX_SIZE) == BufferPool::CLASS_NUM - 1);
+    ZY_ASSERT(BufferPool::SizeClass(BufferPool::MAX_SIZE + 1) == -1);
+    ZY_ASSERT(BufferPool::ClassSize(4) == 4096);
+}
+
+void test_reuse() {
+    BufferPool &pool = BufferPoolMgr::GetInstance();
+    BufferPool::Stats before = pool.getStats();
+
+    // 第一次借出切出新 slab，之后的借还都在线程缓存中
+    void *first = pool.allocate(4000);
+    memset(first, 1, 4000);
+    pool.deallocate(first, 4000);
+    for (int i = 0; i < 10000; ++i) {
+        void *buffer = pool.allocate(4096);
+        ZY_ASSERT(buffer == first);
+        pool.deallocate(buffer, 4096);
+    }
+    BufferPool::Stats after = pool.getStats();
+    ZY_ASSERT(after.allocs - before.allocs == 10001);
+    ZY_ASSERT(after.thread_hits - before.thread_hits == 10000);
+    ZY_ASSERT(after.outstanding == before.outstanding);
+
+    // 超过 MAX_SIZE 的请求直接走 malloc
+    void *huge = pool.allocate(BufferPool::MAX_SIZE + 1);
+    ZY_ASSERT(pool.getStats().outstanding == before.outstanding + BufferPool::MAX_SIZE + 1);
+    pool.deallocate(huge, BufferPool::MAX_SIZE + 1);
+
+    // ByteArray 的块从池中借出，析构时归还
+    {
+        ByteArray ba;
+        std::string data(10 * ByteArray::BLOCK_SIZE, 'x');
+        ba.write(data.data(), data.size());
+        ZY_ASSERT(pool.getStats().outstanding == before.outstanding + ba.getBlockCount() * ByteArray::BLOCK_SIZE);
+    }
+    ZY_ASSERT(pool.getStats().outstanding == before.outstanding);
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "hit rate = " << pool.getStats().hitRate();
+}
+
+void test_threads() {
+    BufferPool &pool = BufferPoolMgr::GetInstance();
+    uint64_t outstanding = pool.getStats().outstanding;
+
+    // 一个线程借出，另一个线程归还，超过缓存上限的块回到中心空闲链表
+    std::vector<void *> buffers;
+    Thread producer("producer", [&buffers, &pool]() {
+        for (int i = 0; i < 1000; ++i) {
+            buffers.push_back(pool.allocate(1024));
+        }
+    });
+    producer.join();
+    ZY_ASSERT(pool.getStats().outstanding == outstanding + 1000 * 1024);
+
+    Thread consumer("consumer", [&buffers, &pool]() {
+        for (void *buffer : buffers) {
+            pool.deallocate(buffer, 1024);
+        }
+    });
+    consumer.join();
+    ZY_ASSERT(pool.getStats().outstanding == outstanding);
+
+    // 退出线程的块已经交还，这里借出时命中中心空闲链表，不切新的 slab
+    uint64_t system = pool.getStats().system;
+    void *buffer = pool.allocate(1024);
+    ZY_ASSERT(pool.getStats().system == system);
+    pool.deallocate(buffer, 1024);
+}
+
+/**
+ * @brief 线程退出时才析构的 ByteArray，析构顺序在线程缓存之后
+ */
+struct ExitHolder {
+    ByteArray::ptr byte_array;
+};
+
+void test_exit_order() {
+    BufferPool &pool = BufferPoolMgr::GetInstance();
+    uint64_t outstanding = pool.getStats().outstanding;
+    Thread thread("exit", []() {
+        // 先构造的 thread_local 后析构，线程缓存已经析构之后才归还块
+        static thread_local ExitHolder holder;
+        holder.byte_array = std::make_shared<ByteArray>();
+        holder.byte_array->writeInt<uint64_t>(1);
+    });
+    thread.join();
+    ZY_ASSERT(pool.getStats().outstanding == outstanding);
+}
+
+int main(int argc, char **argv) {
+    test_size_class();
+    test_reuse();
+    test_threads();
+    test_exit_order();
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_buffer_pool ok";
+    return 0;
+}
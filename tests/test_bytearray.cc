@@ -1,5 +1,10 @@
 #include "byte_array.h"
+#include "utils/macro.h"
+#include <sys/socket.h>
+#include <unistd.h>
 #include <random>
+#include <stdexcept>
+#include <climits>
 #include <vector>
 #include <algorithm>
 #include <iostream>
@@ -69,9 +74,248 @@ void test_string()
     }
 }
 
+void test_segments()
+{
+    // 小块，让数据跨越很多个块
+    ByteArray::ptr ba(new ByteArray(16));
+    std::string data;
+    for (int i = 0; i < 1000; ++i)
+    {
+        data.push_back(static_cast<char>(i));
+    }
+    ba->write(data.data(), data.size());
+    ZY_ASSERT(ba->getReadableSize() == data.size());
+    ZY_ASSERT(ba->getBlockCount() == (data.size() + 15) / 16);
+
+    // 已有的数据不移动，追加写入后块地址不变
+    std::vector<iovec> before;
+    ba->getReadBuffers(before);
+    ba->write(data.data(), data.size());
+    std::vector<iovec> after;
+    ba->getReadBuffers(after, data.size());
+    ZY_ASSERT(before.size() == after.size() && before[0].iov_base == after[0].iov_base);
+
+    std::string out(data.size(), '\0');
+    ba->read(&out[0], 10, true);
+    ZY_ASSERT(out.compare(0, 10, data, 0, 10) == 0 && ba->getReadableSize() == 2 * data.size());
+    ba->read(&out[0], out.size());
+    ZY_ASSERT(out == data);
+    ba->read(&out[0], out.size());
+    ZY_ASSERT(out == data);
+    ZY_ASSERT(ba->getReadableSize() == 0 && ba->getBlockCount() <= 2);
+
+    // 通过 iovec 直接在块和套接字之间收发
+    int fds[2];
+    ZY_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    ba->write(data.data(), data.size());
+    std::vector<iovec> iovs;
+    size_t length = ba->getReadBuffers(iovs);
+    ZY_ASSERT(length == data.size());
+    ZY_ASSERT(writev(fds[0], iovs.data(), iovs.size()) == static_cast<ssize_t>(length));
+    ba->hasRead(length);
+
+    ByteArray::ptr in(new ByteArray(64));
+    in->writeInt<uint32_t>(0x12345678);
+    iovs.clear();
+    in->getWriteBuffers(iovs, data.size());
+    size_t total = 0;
+    while (total < data.size())
+    {
+        ssize_t n = readv(fds[1], iovs.data(), iovs.size());
+        ZY_ASSERT(n > 0);
+        in->hasWritten(n);
+        total += n;
+        iovs.clear();
+        in->getWriteBuffers(iovs, data.size() - total);
+    }
+    ZY_ASSERT(in->readInt<uint32_t>() == 0x12345678);
+    in->read(&out[0], out.size());
+    ZY_ASSERT(out == data);
+    close(fds[0]);
+    close(fds[1]);
+    std::cout << "test_segments ok" << std::endl;
+}
+
+void test_varint()
+{
+    ByteArray::ptr ba(new ByteArray(16));
+    ba->writeVarint<uint32_t>(0);
+    ba->writeVarint<uint32_t>(127);
+    ZY_ASSERT(ba->getReadableSize() == 2);
+    ba->writeVarint<uint32_t>(128);
+    ZY_ASSERT(ba->getReadableSize() == 4);
+    // zigzag 编码后 -1 只占 1 字节
+    ba->writeVarint<int32_t>(-1);
+    ZY_ASSERT(ba->getReadableSize() == 5);
+    ba->writeVarint<int64_t>(INT64_MIN);
+    ba->writeVarint<uint64_t>(UINT64_MAX);
+    ZY_ASSERT(ba->getReadableSize() == 25);
+    ba->writeStringVarint("short");
+    ZY_ASSERT(ba->getReadableSize() == 31);
+
+    ZY_ASSERT(ba->readVarint<uint32_t>() == 0);
+    ZY_ASSERT(ba->readVarint<uint32_t>() == 127);
+    ZY_ASSERT(ba->readVarint<uint32_t>() == 128);
+    ZY_ASSERT(ba->readVarint<int32_t>() == -1);
+    ZY_ASSERT(ba->readVarint<int64_t>() == INT64_MIN);
+    ZY_ASSERT(ba->readVarint<uint64_t>() == UINT64_MAX);
+    ZY_ASSERT(ba->readStringVarint() == "short");
+
+    // 不完整和过长的编码
+    ba->writeInt<uint8_t>(0x80);
+    bool thrown = false;
+    try { ba->readVarint<uint32_t>(); } catch (const std::out_of_range &) { thrown = true; }
+    ZY_ASSERT(thrown && ba->getReadableSize() == 1);
+    for (int i = 0; i < 10; ++i)
+    {
+        ba->writeInt<uint8_t>(0xff);
+    }
+    thrown = false;
+    try { ba->readVarint<uint64_t>(); } catch (const std::overflow_error &) { thrown = true; }
+    ZY_ASSERT(thrown);
+    std::cout << "test_varint ok" << std::endl;
+}
+
+void test_array()
+{
+    std::mt19937_64 rng(42);
+#define XX(type)                                                            \
+    {                                                                       \
+        std::vector<type> vec(1001);                                        \
+        for (auto &v : vec)                                                 \
+        {                                                                   \
+            v = static_cast<type>(rng());                                   \
+        }                                                                   \
+        /* 块大小不是数值宽度的整数倍，数值会跨越块的边界 */                  \
+        ByteArray::ptr bulk(new ByteArray(100)), single(new ByteArray(100)); \
+        bulk->writeInt<uint8_t>(1);                                         \
+        single->writeInt<uint8_t>(1);                                       \
+        bulk->writeArray(vec.data(), vec.size());                           \
+        for (auto v : vec)                                                  \
+        {                                                                   \
+            single->writeInt<type>(v);                                      \
+        }                                                                   \
+        std::string a(bulk->getReadableSize(), '\0');                       \
+        std::string b(single->getReadableSize(), '\0');                     \
+        bulk->read(&a[0], a.size(), true);                                  \
+        single->read(&b[0], b.size(), true);                                \
+        ZY_ASSERT(a == b);                                                  \
+        std::vector<type> out(vec.size());                                  \
+        ZY_ASSERT(single->readInt<uint8_t>() == 1);                         \
+        single->readArray(out.data(), out.size());                          \
+        ZY_ASSERT(out == vec);                                              \
+    }
+
+    XX(uint8_t)
+    XX(int16_t)
+    XX(uint32_t)
+    XX(int64_t)
+#undef XX
+
+    std::vector<double> doubles = {0.5, -1.25, 3.14159, 1e300};
+    ByteArray::ptr ba(new ByteArray(20));
+    ba->writeArray(doubles.data(), doubles.size());
+    ZY_ASSERT(ba->readDouble() == 0.5);
+    std::vector<double> rest(3);
+    ba->readArray(rest.data(), rest.size());
+    ZY_ASSERT(rest[0] == -1.25 && rest[2] == 1e300);
+    std::cout << "test_array ok" << std::endl;
+}
+
+void test_view()
+{
+    ByteArray::ptr ba(new ByteArray(16));
+    std::string text = "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\nbody";
+    ba->write(text.data(), text.size());
+
+    // 不跨块的视图直接指向块内存，不使用 scratch
+    std::string scratch;
+    StringView method = ba->peek(0, 3, scratch);
+    ZY_ASSERT(method == "GET" && scratch.empty());
+    // 跨块时拷贝到 scratch
+    StringView line = ba->peek(4, 20, scratch);
+    ZY_ASSERT(line == "/index.html HTTP/1.1" && line.data() == scratch.data());
+    ZY_ASSERT(ba->peekByte(16) == 'H');
+    ZY_ASSERT(ba->getReadableSize() == text.size());
+
+    std::vector<StringView> views;
+    ZY_ASSERT(ba->getReadViews(views) == text.size());
+    std::string joined;
+    for (auto &v : views)
+    {
+        joined += v.toString();
+    }
+    ZY_ASSERT(joined == text && views.size() == (text.size() + 15) / 16);
+
+    // 查找的结果和 std::string 一致，包括跨块的分隔符
+    ZY_ASSERT(ba->find(' ') == text.find(' '));
+    ZY_ASSERT(ba->find('b') == text.find('b'));
+    ZY_ASSERT(ba->find('z') == StringView::npos);
+    ZY_ASSERT(ba->find("\r\n") == text.find("\r\n"));
+    ZY_ASSERT(ba->find("\r\n", 26) == text.find("\r\n", 26));
+    ZY_ASSERT(ba->find("\r\n\r\n") == text.find("\r\n\r\n"));
+    ZY_ASSERT(ba->find("example.com") == text.find("example.com"));
+    ZY_ASSERT(ba->find("bodyx") == StringView::npos);
+
+    // 消耗数据后偏移从新的可读区域开头算起
+    size_t header_end = ba->find("\r\n\r\n") + 4;
+    ba->hasRead(header_end);
+    ZY_ASSERT(ba->peek(0, 4, scratch) == "body");
+    ZY_ASSERT(ba->find('y') == 3);
+    std::cout << "test_view ok" << std::endl;
+}
+
+void test_spill() {
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_spill start";
+    // 内存中最多 4 块，之后的块映射到临时文件上
+    ByteArray::ptr ba(new ByteArray(4096));
+    ZY_ASSERT(ba->setSpill(4 * 4096));
+    std::string data(3 * ByteArray::SPILL_CHUNK_SIZE, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i * 31);
+    }
+    ba->write(data.data(), data.size());
+    ZY_ASSERT(ba->getReadableSize() == data.size());
+    ZY_ASSERT(ba->getSpilledSize() >= data.size() - 4 * 4096);
+
+    // 开头的 4 块在内存中
+    int fd;
+    off_t offset;
+    size_t length;
+    ZY_ASSERT(!ba->getFileSegment(fd, offset, length));
+    std::string got(4 * 4096, '\0');
+    ba->read(&got[0], got.size());
+    ZY_ASSERT(got == data.substr(0, got.size()));
+
+    // 之后的数据在文件中连续，从文件读出的内容和写入的相同
+    ZY_ASSERT(ba->getFileSegment(fd, offset, length));
+    ZY_ASSERT(offset == 0 && length == data.size() - got.size());
+    std::string file(1000, '\0');
+    ZY_ASSERT(pread(fd, &file[0], file.size(), offset + 100) == 1000);
+    ZY_ASSERT(file == data.substr(got.size() + 100, 1000));
+
+    // 读完的映射被释放
+    got.resize(data.size() - got.size());
+    ba->read(&got[0], got.size());
+    ZY_ASSERT(got == data.substr(4 * 4096));
+    ZY_ASSERT(ba->getSpilledSize() < ByteArray::SPILL_CHUNK_SIZE);
+
+    // 清空后重新从内存开始
+    ba->clear();
+    ba->writeInt<uint32_t>(42);
+    ZY_ASSERT(!ba->getFileSegment(fd, offset, length));
+    ZY_ASSERT(ba->readInt<uint32_t>() == 42);
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_spill end";
+}
+
 int main()
 {
     test_num();
+    test_segments();
+    test_varint();
+    test_array();
+    test_view();
+    test_spill();
     //test_string();
     return 0;
 }
\ No newline at end of file
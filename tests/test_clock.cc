@@ -0,0 +1,46 @@
+#include <iostream>
+#include <unistd.h>
+#include "clock.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+/**
+ * @brief 测试各个时钟源的单调性和读取开销
+ */
+void test_source(Clock::Source source, const char *name) {
+    if (!Clock::SetSource(source)) {
+        std::cout << name << " not available" << std::endl;
+        return;
+    }
+    static const int N = 1000000;
+    uint64_t last = Clock::NowNs();
+    uint64_t begin = last;
+    for (int i = 0; i < N; ++i) {
+        uint64_t now = Clock::NowNs();
+        ZY_ASSERT(now >= last);
+        last = now;
+    }
+    std::cout << name << ": " << (last - begin) / N << " ns/call" << std::endl;
+}
+
+void test_loop_time() {
+    // 没有刷新过循环时间时返回实时时间
+    uint64_t now = Clock::LoopNowMs();
+    ZY_ASSERT(now + 10 >= Clock::NowMs());
+
+    uint64_t cached = Clock::UpdateLoopTime();
+    usleep(20 * 1000);
+    ZY_ASSERT(Clock::LoopNowMs() == cached);
+    ZY_ASSERT(Clock::UpdateLoopTime() >= cached + 20);
+    std::cout << "loop time ok, wall seconds = " << Clock::WallSeconds() << std::endl;
+}
+
+int main() {
+    test_source(Clock::MONOTONIC, "monotonic");
+    test_source(Clock::MONOTONIC_COARSE, "monotonic_coarse");
+    test_source(Clock::TSC, "tsc");
+    Clock::SetSource(Clock::MONOTONIC);
+    test_loop_time();
+    return 0;
+}
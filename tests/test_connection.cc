@@ -0,0 +1,160 @@
+#include <unistd.h>
+#include <string>
+#include "reactor.h"
+#include "socket.h"
+#include "connection.h"
+#include "utils/macro.h"
+#include "test_util.h"
+
+using namespace zy;
+
+static std::string recv_exact(const Socket::ptr &sock, size_t length) {
+    std::string data(length, '\0');
+    ZY_ASSERT(sock->recv(&data[0], length, MSG_WAITALL) == length);
+    return data;
+}
+
+void test_bytearray_io() {
+    Socket::ptr client, server;
+    make_pair(client, server);
+    Connection::ptr reader = std::make_shared<Connection>(client);
+    Connection::ptr writer = std::make_shared<Connection>(server);
+
+    // 跨越多个块的数据直接在块和套接字之间收发
+    ByteArray::ptr out(new ByteArray(100));
+    std::string data(1000, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i);
+    }
+    out->write(data.data(), data.size());
+    ZY_ASSERT(writer->writeFixSize(out, data.size()) == data.size());
+    ZY_ASSERT(out->getReadableSize() == 0);
+
+    ByteArray::ptr in(new ByteArray(64));
+    ZY_ASSERT(reader->readFixSize(in, data.size()) == data.size());
+    std::string got(data.size(), '\0');
+    in->read(&got[0], got.size());
+    ZY_ASSERT(got == data);
+}
+
+void test_bytearray_partial() {
+    Socket::ptr client, server;
+    make_pair(client, server);
+    Connection::ptr reader = std::make_shared<Connection>(client);
+    Connection::ptr writer = std::make_shared<Connection>(server);
+    // 发送缓冲区很小，对端没有读取时一次只能发出一部分
+    ZY_ASSERT(server->setOption(SOL_SOCKET, SO_SNDBUF, 16 * 1024));
+
+    ByteArray::ptr out(new ByteArray(4096));
+    std::string data(1024 * 1024, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i % 253);
+    }
+    out->write(data.data(), data.size());
+
+    // 限制长度时只发送前面的部分
+    ZY_ASSERT(writer->write(out, 300) == 300);
+    ZY_ASSERT(out->getReadableSize() == data.size() - 300);
+    ZY_ASSERT(recv_exact(client, 300) == data.substr(0, 300));
+
+    // 部分发送只消耗发送成功的字节，剩下的留在字节数组中，下一次从断点继续
+    size_t sent = writer->write(out, out->getReadableSize());
+    ZY_ASSERT(sent > 0 && sent < data.size() - 300);
+    ZY_ASSERT(out->getReadableSize() == data.size() - 300 - sent);
+
+    Reactor::GetThis()->addTask([writer, out]() {
+        ZY_ASSERT(writer->writeFixSize(out, out->getReadableSize()) != static_cast<size_t>(-1));
+        ZY_ASSERT(out->getReadableSize() == 0);
+    });
+    ByteArray::ptr in(new ByteArray(4096));
+    size_t rest = data.size() - 300;
+    ZY_ASSERT(reader->readFixSize(in, rest) == rest);
+    std::string got(rest, '\0');
+    in->read(&got[0], got.size());
+    ZY_ASSERT(got == data.substr(300));
+}
+
+void test_spill_sendfile() {
+    Socket::ptr client, server;
+    make_pair(client, server);
+    Connection::ptr reader = std::make_shared<Connection>(client);
+    Connection::ptr writer = std::make_shared<Connection>(server);
+
+    // 内存中的部分用 writev 发送，溢出到文件中的部分用 sendfile 发送
+    ByteArray::ptr out(new ByteArray());
+    ZY_ASSERT(out->setSpill(64 * 1024));
+    std::string data(2 * 1024 * 1024, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i % 251);
+    }
+    out->write(data.data(), data.size());
+    Reactor::GetThis()->addTask([writer, out]() {
+        ZY_ASSERT(writer->writeFixSize(out, out->getReadableSize()) == 2 * 1024 * 1024);
+    });
+    ByteArray::ptr in(new ByteArray());
+    ZY_ASSERT(reader->readFixSize(in, data.size()) == data.size());
+    std::string got(data.size(), '\0');
+    in->read(&got[0], got.size());
+    ZY_ASSERT(got == data);
+    ZY_ASSERT(out->getReadableSize() == 0 && out->getSpilledSize() < ByteArray::SPILL_CHUNK_SIZE);
+}
+
+void test_coalesce() {
+    Socket::ptr client, server;
+    make_pair(client, server);
+    Connection::ptr conn = std::make_shared<Connection>(server);
+    conn->setOutputBuffer();
+
+    // 同一轮中的 20 条消息在当前协程让出后一次发送
+    std::string expect;
+    for (int i = 0; i < 20; ++i) {
+        std::string msg = "message " + std::to_string(i) + "\n";
+        ZY_ASSERT(conn->writeBuffered(msg.data(), msg.size()) == msg.size());
+        expect += msg;
+    }
+    ZY_ASSERT(conn->getBufferedSize() == expect.size());
+    ZY_ASSERT(conn->getFlushSyscalls() == 0);
+    ZY_ASSERT(recv_exact(client, expect.size()) == expect);
+    ZY_ASSERT(conn->getBufferedWrites() == 20);
+    ZY_ASSERT(conn->getFlushSyscalls() == 1);
+
+    // 达到阈值时立即发送
+    conn->setOutputBuffer(1024);
+    std::string big(1500, 'b');
+    ZY_ASSERT(conn->writeBuffered(big.data(), big.size()) == big.size());
+    ZY_ASSERT(conn->getBufferedSize() == 0 && conn->getFlushSyscalls() == 2);
+    ZY_ASSERT(recv_exact(client, big.size()) == big);
+
+    // 延迟刷新跨越多轮合并
+    conn->setOutputBuffer(Connection::FLUSH_THRESHOLD, 20 * 1000);
+    conn->setCork(true);
+    for (int i = 0; i < 5; ++i) {
+        ZY_ASSERT(conn->writeBuffered("x", 1) == 1);
+        usleep(1000);
+    }
+    ZY_ASSERT(conn->getFlushSyscalls() == 2);
+    ZY_ASSERT(recv_exact(client, 5) == "xxxxx");
+    ZY_ASSERT(conn->getFlushSyscalls() == 3);
+
+    // 对端关闭后发送失败，缓冲的数据被丢弃，不会触发 SIGPIPE
+    conn->setOutputBuffer();
+    client->close();
+    usleep(10 * 1000);
+    std::string tail(1024 * 1024, 't');
+    for (int i = 0; i < 4; ++i) {
+        conn->writeBuffered(tail.data(), tail.size());
+    }
+    ZY_ASSERT(conn->getBufferedSize() == 0);
+}
+
+int main(int argc, char **argv) {
+    Reactor r("connection");
+    r.addTask([]() {
+        test_bytearray_io();
+        test_bytearray_partial();
+        test_spill_sendfile();
+        test_coalesce();
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_connection ok";
+    });
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <unistd.h>
+#include <string>
+#include "reactor.h"
+#include "socket.h"
+#include "frame_codec.h"
+#include "buffer_pool.h"
+#include "utils/macro.h"
+#include "test_util.h"
+
+using namespace zy;
+
+void test_length_prefixed() {
+    Socket::ptr client, server;
+    make_pair(client, server);
+    Connection::ptr out = std::make_shared<Connection>(client);
+    out->setOutputBuffer();
+    FrameCodec::ptr writer = FrameCodec::LengthPrefixed(out);
+    FrameCodec::ptr reader = FrameCodec::LengthPrefixed(std::make_shared<Connection>(server));
+
+    // 100 帧在一轮中写入，合并成一次发送，接收端一次读取后依次返回
+    for (int i = 0; i < 100; ++i) {
+        std::string msg = "frame " + std::to_string(i);
+        ZY_ASSERT(writer->writeFrame(msg) == msg.size() + FrameCodec::HEADER_SIZE);
+    }
+    ZY_ASSERT(writer->writeFrame("", 0) == FrameCodec::HEADER_SIZE);
+    StringView frame;
+    for (int i = 0; i < 100; ++i) {
+        ZY_ASSERT(reader->readFrame(frame) == FrameCodec::FRAME);
+        ZY_ASSERT(frame == "frame " + std::to_string(i));
+    }
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::FRAME && frame.empty());
+    ZY_ASSERT(reader->getFrames() == 101 && reader->getReads() < 10);
+
+    // 一帧分成多次到达，跨越字节数组的块
+    std::string big(10000, 'b');
+    std::string packet = std::string("\x00\x00\x27\x10", 4) + big;
+    Reactor::GetThis()->addTask([client, packet]() {
+        for (size_t i = 0; i < packet.size(); i += 3000) {
+            client->send(packet.data() + i, std::min<size_t>(3000, packet.size() - i));
+            usleep(1000);
+        }
+    });
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::FRAME && frame == big);
+
+    // 对端在一帧的中间关闭
+    client->send("\x00\x00\x00\x05" "abc", 7);
+    client->close();
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::ERROR);
+}
+
+void test_delimited() {
+    Socket::ptr client, server;
+    make_pair(client, server);
+    FrameCodec::ptr reader = FrameCodec::Delimited(std::make_shared<Connection>(server), '\0', 64);
+
+    // 和聊天客户端的格式相同：JSON 后面跟 '\0'，多条一起到达，最后一条被拆开
+    std::string data = std::string("{\"msgid\":1}") + '\0' + "{\"msgid\":2}" + '\0' + "{\"msg";
+    client->send(data.data(), data.size());
+    StringView frame;
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::FRAME && frame == "{\"msgid\":1}");
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::FRAME && frame == "{\"msgid\":2}");
+    ZY_ASSERT(reader->getBufferedSize() == 5);
+    client->send("id\":3}\0", 7);
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::FRAME && frame == "{\"msgid\":3}");
+
+    FrameCodec::ptr writer = FrameCodec::Delimited(std::make_shared<Connection>(client), '\0');
+    ZY_ASSERT(writer->writeFrame("ping") == 5);
+    FrameCodec::ptr echo = FrameCodec::Delimited(std::make_shared<Connection>(server), '\0');
+    ZY_ASSERT(echo->readFrame(frame) == FrameCodec::FRAME && frame == "ping");
+
+    // 短消息只读入已有的块，接收缓冲区不会扩成 READ_SIZE
+    uint64_t outstanding = BufferPoolMgr::GetInstance().getStats().outstanding;
+    FrameCodec::ptr idle = FrameCodec::Delimited(std::make_shared<Connection>(server), '\0');
+    for (int i = 0; i < 10; ++i) {
+        client->send("hi\0", 3);
+        ZY_ASSERT(idle->readFrame(frame) == FrameCodec::FRAME && frame == "hi");
+    }
+    ZY_ASSERT(BufferPoolMgr::GetInstance().getStats().outstanding - outstanding <= 2 * ByteArray::BLOCK_SIZE);
+
+    // 超过最大长度还没有分隔符
+    std::string junk(100, 'x');
+    client->send(junk.data(), junk.size());
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::TOO_LARGE);
+    ZY_ASSERT(reader->readFrame(frame) == FrameCodec::TOO_LARGE);
+
+    client->close();
+    ZY_ASSERT(echo->readFrame(frame) == FrameCodec::CLOSED);
+}
+
+int main(int argc, char **argv) {
+    Reactor r("frame");
+    r.addTask([]() {
+        test_length_prefixed();
+        test_delimited();
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_frame_codec ok";
+    });
+    return 0;
+}
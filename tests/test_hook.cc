@@ -1,12 +1,40 @@
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <fcntl.h>
+#include <fstream>
 #include "reactor.h"
+#include "clock.h"
+#include "file_descriptor.h"
+#include "file_io.h"
+#include "utils/macro.h"
 
 using namespace zy;
 
+// 统计堆分配次数，用来确认阻塞 IO 的超时路径不分配内存
+static std::atomic<uint64_t> s_alloc_count{0};
+
+void *operator new(size_t size) {
+    ++s_alloc_count;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
 void test_sleep() {
     ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_sleep begin";
 
@@ -22,6 +50,152 @@ void test_sleep() {
     ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_sleep end";
 }
 
+/**
+ * @brief 100 次 200us 的 usleep：按毫秒取整至少要 100ms，微秒级定时器应当远小于这个值
+ */
+void test_usleep() {
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_usleep begin";
+    uint64_t elapsed = 0;
+    {
+        Reactor r("usleep");
+        r.addTask([&elapsed](){
+            uint64_t begin = Clock::NowUs();
+            for (int i = 0; i < 100; ++i) {
+                usleep(200);
+            }
+            struct timespec ts{0, 200 * 1000};
+            nanosleep(&ts, nullptr);
+            elapsed = Clock::NowUs() - begin;
+        });
+    }
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_usleep elapsed " << elapsed << "us";
+    ZY_ASSERT(elapsed >= 101 * 200 && elapsed < 100 * 1000);
+}
+
+/**
+ * @brief 先忙 30ms 不让出，再睡 10ms：循环时间停在任务开始之前，以它为基准的截止时间已经过去，睡眠会立刻返回
+ */
+void test_sleep_after_busy() {
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_sleep_after_busy begin";
+    uint64_t usleep_elapsed = 0;
+    uint64_t nanosleep_elapsed = 0;
+    {
+        Reactor r("busy");
+        r.addTask([&usleep_elapsed, &nanosleep_elapsed](){
+            uint64_t busy = Clock::NowUs();
+            while (Clock::NowUs() - busy < 30 * 1000) {
+            }
+            uint64_t begin = Clock::NowUs();
+            usleep(10 * 1000);
+            usleep_elapsed = Clock::NowUs() - begin;
+
+            busy = Clock::NowUs();
+            while (Clock::NowUs() - busy < 30 * 1000) {
+            }
+            struct timespec ts{0, 10 * 1000 * 1000};
+            begin = Clock::NowUs();
+            nanosleep(&ts, nullptr);
+            nanosleep_elapsed = Clock::NowUs() - begin;
+        });
+    }
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_sleep_after_busy usleep " << usleep_elapsed
+                               << "us nanosleep " << nanosleep_elapsed << "us";
+    ZY_ASSERT(usleep_elapsed >= 10 * 1000);
+    ZY_ASSERT(nanosleep_elapsed >= 10 * 1000);
+}
+
+/**
+ * @brief 单线程反应堆里，一个协程阻塞在 poll/select/epoll_wait 上，另一个协程稍后写管道：
+ * 如果等待没有让出线程，写协程无法执行，等待只能超时
+ */
+void test_poll() {
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_poll begin";
+    std::atomic<int> done{0};
+    {
+        Reactor r("poll");
+        r.addTask([&done]() {
+            int fds[2];
+            ZY_ASSERT(pipe(fds) == 0);
+            ZY_ASSERT(FdMgr::GetInstance().get(fds[0])->isPollable());
+            // dup 出来的 fd 继承上下文
+            int dup_fd = dup(fds[0]);
+            ZY_ASSERT(FdMgr::GetInstance().get(dup_fd));
+            close(dup_fd);
+
+            auto writer = [&fds]() {
+                usleep(50 * 1000);
+                ZY_ASSERT(write(fds[1], "x", 1) == 1);
+            };
+            char c;
+
+            // poll
+            Reactor::GetThis()->addTask(writer);
+            uint64_t begin = Clock::NowMs();
+            struct pollfd pfd = {fds[0], POLLIN, 0};
+            ZY_ASSERT(poll(&pfd, 1, 1000) == 1 && (pfd.revents & POLLIN));
+            ZY_ASSERT(Clock::NowMs() - begin < 500);
+            ZY_ASSERT(read(fds[0], &c, 1) == 1);
+
+            // select，先超时一次
+            fd_set read_set;
+            FD_ZERO(&read_set);
+            FD_SET(fds[0], &read_set);
+            struct timeval tv{0, 100 * 1000};
+            begin = Clock::NowMs();
+            ZY_ASSERT(select(fds[0] + 1, &read_set, nullptr, nullptr, &tv) == 0);
+            ZY_ASSERT(Clock::NowMs() - begin >= 100);
+            Reactor::GetThis()->addTask(writer);
+            FD_SET(fds[0], &read_set);
+            tv = {1, 0};
+            ZY_ASSERT(select(fds[0] + 1, &read_set, nullptr, nullptr, &tv) == 1 && FD_ISSET(fds[0], &read_set));
+            ZY_ASSERT(read(fds[0], &c, 1) == 1);
+
+            // 嵌套的 epoll
+            int epfd = epoll_create1(EPOLL_CLOEXEC);
+            struct epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fds[0];
+            ZY_ASSERT(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev) == 0);
+            Reactor::GetThis()->addTask(writer);
+            begin = Clock::NowMs();
+            ZY_ASSERT(epoll_wait(epfd, &ev, 1, 1000) == 1 && ev.data.fd == fds[0]);
+            ZY_ASSERT(Clock::NowMs() - begin < 500);
+            ZY_ASSERT(read(fds[0], &c, 1) == 1);
+            close(epfd);
+
+            // 另一个协程阻塞在同一个 fd 的读上，poll 和它共享事件而不是阻塞线程；重复的 fd 合并
+            std::atomic<bool> read_done{false};
+            Reactor::GetThis()->addTask([&fds, &read_done]() {
+                char x;
+                ZY_ASSERT(read(fds[0], &x, 1) == 1);
+                read_done = true;
+            });
+            Reactor::GetThis()->addTask([&fds]() {
+                usleep(50 * 1000);
+                ZY_ASSERT(write(fds[1], "xy", 2) == 2);
+            });
+            usleep(10 * 1000);
+            begin = Clock::NowMs();
+            struct pollfd pfds[2] = {{fds[0], POLLIN, 0}, {fds[0], POLLIN, 0}};
+            ZY_ASSERT(poll(pfds, 2, 1000) == 2 && (pfds[1].revents & POLLIN));
+            ZY_ASSERT(Clock::NowMs() - begin < 500);
+            ZY_ASSERT(read(fds[0], &c, 1) == 1);
+            usleep(10 * 1000);
+            ZY_ASSERT(read_done);
+
+            // dup2 失败时目标 fd 的上下文保持不变
+            ZY_ASSERT(dup2(-1, fds[0]) == -1 && errno == EBADF);
+            ZY_ASSERT(FdMgr::GetInstance().get(fds[0]));
+
+            close(fds[0]);
+            close(fds[1]);
+            ++done;
+        });
+    }
+    ZY_ASSERT(done == 1);
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_poll ok";
+}
+
 void test_sock() {
     int fd = socket(AF_INET, SOCK_STREAM, 0);
 
@@ -58,8 +232,188 @@ void test_sock() {
     ZY_LOG_INFO(ZY_LOG_ROOT()) << "recv buffer = " << buffer;
 }
 
+/**
+ * @brief fd 关闭后代数改变，同一个编号被复用时持有旧代数的调用者能发现；上下文表跨块按需增长，已有的块不移动
+ */
+void test_fd_context() {
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_fd_context begin";
+
+    Reactor r("fd_context");
+    r.addTask([](){
+        FdManager &mgr = FdMgr::GetInstance();
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        FdContext *ctx = mgr.get(fd, true);
+        ZY_ASSERT(ctx);
+        uint32_t generation = ctx->getGeneration();
+        ZY_ASSERT((generation & 1) && ctx->isSame(generation));
+
+        close(fd);
+        ZY_ASSERT(!ctx->isSame(generation) && !(ctx->getGeneration() & 1));
+        ZY_ASSERT(!mgr.get(fd));
+
+        // 内核分配最小的空闲编号，新的 socket 复用同一个 fd 和同一个上下文，但代数不同
+        int reused = socket(AF_INET, SOCK_STREAM, 0);
+        ZY_ASSERT(reused == fd);
+        ZY_ASSERT(mgr.get(reused, true) == ctx);
+        ZY_ASSERT((ctx->getGeneration() & 1) && !ctx->isSame(generation));
+
+        // 块边界两侧的 fd 落在不同的块
+        int last = FdManager::CHUNK_SIZE - 1;
+        int first = FdManager::CHUNK_SIZE;
+        ZY_ASSERT(dup2(reused, last) == last);
+        ZY_ASSERT(dup2(reused, first) == first);
+        FdContext *last_ctx = mgr.get(last);
+        FdContext *first_ctx = mgr.get(first);
+        ZY_ASSERT(last_ctx && first_ctx && last_ctx != first_ctx);
+        ZY_ASSERT(last_ctx->isPollable() && first_ctx->isPollable());
+
+        // 还没有分配的块在第一次创建上下文时分配，已有的上下文地址不变
+        int far = FdManager::CHUNK_SIZE * 5 + 3;
+        ZY_ASSERT(!mgr.get(far));
+        ZY_ASSERT(dup2(reused, far) == far);
+        ZY_ASSERT(mgr.get(far) && mgr.get(far)->isPollable());
+        ZY_ASSERT(mgr.get(first) == first_ctx && mgr.get(reused) == ctx);
+
+        // 超出范围的 fd 没有上下文
+        ZY_ASSERT(!mgr.get(-1, true));
+        ZY_ASSERT(!mgr.get(FdManager::CHUNK_SIZE * FdManager::MAX_CHUNKS, true));
+
+        close(far);
+        close(first);
+        close(last);
+        close(reused);
+        ZY_ASSERT(!mgr.get(far) && !mgr.get(first) && !mgr.get(last));
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_fd_context ok";
+    });
+}
+
+void test_recv_timeout() {
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_recv_timeout begin";
+
+    Reactor r("recv_timeout");
+    r.addTask([](){
+        int fds[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        FdMgr::GetInstance().get(fds[0], true);
+        FdMgr::GetInstance().get(fds[1], true);
+        timeval tv{0, 100 * 1000};
+        setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+
+        char buffer[16];
+        // 第一次等待会创建 Channel、调度队列的缓冲区等，之后的等待不应该再分配内存
+        ssize_t rt = recv(fds[0], buffer, sizeof buffer, 0);
+        ZY_ASSERT(rt == -1 && errno == ETIMEDOUT);
+
+        for (int i = 0; i < 3; ++i) {
+            uint64_t allocs = s_alloc_count;
+            uint64_t begin = Clock::NowMs();
+            rt = recv(fds[0], buffer, sizeof buffer, 0);
+            uint64_t elapse = Clock::NowMs() - begin;
+            uint64_t delta = s_alloc_count - allocs;
+            ZY_ASSERT(rt == -1 && errno == ETIMEDOUT);
+            ZY_ASSERT(elapse >= 90 && elapse < 300);
+            ZY_ASSERT(delta == 0);
+        }
+
+        // 忙 150ms 不让出，循环时间停在任务开始之前，超时仍然要从调用 recv 时算起
+        uint64_t busy = Clock::NowMs();
+        while (Clock::NowMs() - busy < 150) {
+        }
+        uint64_t begin = Clock::NowMs();
+        rt = recv(fds[0], buffer, sizeof buffer, 0);
+        uint64_t elapse = Clock::NowMs() - begin;
+        ZY_ASSERT(rt == -1 && errno == ETIMEDOUT);
+        ZY_ASSERT(elapse >= 90 && elapse < 300);
+
+        // 数据在超时之前到来
+        send(fds[1], "hi", 2, 0);
+        rt = recv(fds[0], buffer, sizeof buffer, 0);
+        ZY_ASSERT(rt == 2);
+
+        close(fds[0]);
+        close(fds[1]);
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_recv_timeout ok";
+    });
+}
+
+/**
+ * @brief 单线程反应堆里，读写普通文件时协程让出线程，另一个协程可以执行；关闭 offload 后直接读写不让出
+ */
+void test_file_io() {
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_file_io begin";
+    const char *path = "/tmp/zy_test_file_io";
+    std::atomic<int> done{0};
+    // 任务协程结束之后插入的任务才会执行，标志不能放在任务协程的栈上
+    std::atomic<bool> ran{false};
+    {
+        Reactor r("file_io");
+        r.addTask([&r, &done, &ran, path]() {
+            // open 没有被 hook，文件描述符没有上下文
+            int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            ZY_ASSERT(fd >= 0);
+            std::string data(64 * 1024, 'x');
+
+            r.addTask([&ran]() { ran = true; });
+            ZY_ASSERT(write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+            ZY_ASSERT(ran);
+
+            // 读到的内容和写入的一致，出错时 errno 和原始系统调用一致
+            std::string buf(data.size(), '\0');
+            ZY_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+            ZY_ASSERT(read(fd, &buf[0], buf.size()) == static_cast<ssize_t>(buf.size()));
+            ZY_ASSERT(buf == data);
+            ZY_ASSERT(read(-1, &buf[0], 1) == -1 && errno == EBADF);
+
+            // 关闭 offload 后不再让出线程
+            auto ctx = FdMgr::GetInstance().get(fd, true);
+            ZY_ASSERT(ctx->isFile());
+            ctx->setOffload(false);
+            ran = false;
+            r.addTask([&ran]() { ran = true; });
+            ZY_ASSERT(write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+            ZY_ASSERT(!ran);
+            close(fd);
+            ++done;
+        });
+    }
+    ZY_ASSERT(done == 1);
+
+    // 任务协程中打印的文件日志由 IO 线程写出，顺序不变
+    const char *log_path = "/tmp/zy_test_file_log";
+    unlink(log_path);
+    auto logger = ZY_LOG_NAME("file_io");
+    logger->addAppender(LogAppender::ptr(new FileLogAppender(log_path)));
+    {
+        Reactor r("file_log");
+        r.addTask([logger]() {
+            for (int i = 0; i < 100; ++i) {
+                ZY_LOG_INFO(logger) << "line " << i;
+            }
+        });
+    }
+    int lines = 0;
+    for (int retry = 0; retry < 100 && lines < 100; ++retry) {
+        usleep(10 * 1000);
+        std::ifstream in(log_path);
+        std::string line;
+        for (lines = 0; std::getline(in, line); ++lines) {
+            ZY_ASSERT(line.find("line " + std::to_string(lines)) != std::string::npos);
+        }
+    }
+    ZY_ASSERT(lines == 100);
+    logger->clearAppender();
+    unlink(path);
+    unlink(log_path);
+}
+
 int main() {
      test_sleep();
+     test_fd_context();
+     test_recv_timeout();
+     test_usleep();
+     test_sleep_after_busy();
+     test_poll();
+     test_file_io();
 
     //Reactor r("socket");
     //r.addTask(test_sock);
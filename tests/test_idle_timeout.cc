@@ -0,0 +1,99 @@
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include "reactor.h"
+#include "tcp_server.h"
+#include "clock.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+/**
+ * @brief 回显服务器，连接结束时计数
+ */
+class EchoServer : public TCPServer {
+public:
+    using TCPServer::TCPServer;
+
+    std::atomic<int> closed{0};
+
+protected:
+    void handleClient(const Socket::ptr &client) override {
+        char buffer[256];
+        while (true) {
+            size_t n = client->recv(buffer, sizeof buffer);
+            if (n == 0 || n == static_cast<size_t>(-1)) {
+                break;
+            }
+            if (buffer[0] == 's') {
+                // 不让出地忙一段比空闲超时更长的时间再回复
+                uint64_t busy = Clock::NowMs();
+                while (Clock::NowMs() - busy < 300) {
+                }
+            }
+            ZY_ASSERT(client->send(buffer, n) == n);
+        }
+        client->close();
+        ++closed;
+    }
+};
+
+void test_idle_timeout() {
+    std::shared_ptr<EchoServer> server(new EchoServer("idle"));
+    server->setIdleTimeout(200);
+    ZY_ASSERT(server->bind(IPv4Address::Create("127.0.0.1", 0)));
+    server->start();
+    Address::ptr addr = server->getListenSock()->getLocalAddress();
+
+    Socket::ptr idle = Socket::CreateTCP();
+    ZY_ASSERT(idle->connect(addr));
+    Socket::ptr active = Socket::CreateTCP();
+    ZY_ASSERT(active->connect(addr));
+
+    // 活跃的连接每 50 毫秒收发一次，持续超过空闲超时的两倍
+    std::atomic<bool> active_done{false};
+    Reactor::GetThis()->addTask([active, &active_done]() {
+        char c;
+        for (int i = 0; i < 12; ++i) {
+            ZY_ASSERT(active->send("a", 1) == 1);
+            ZY_ASSERT(active->recv(&c, 1) == 1 && c == 'a');
+            usleep(50 * 1000);
+        }
+        active_done = true;
+    });
+
+    // 空闲的连接在超时之后被服务器关闭，recv 返回 0
+    uint64_t begin = Clock::NowMs();
+    char c;
+    ZY_ASSERT(idle->recv(&c, 1) == 0);
+    uint64_t elapsed = Clock::NowMs() - begin;
+    ZY_ASSERT(elapsed >= 200 && elapsed < 1000);
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "idle client closed after " << elapsed << "ms";
+
+    while (!active_done) {
+        usleep(10 * 1000);
+    }
+    ZY_ASSERT(server->closed == 1);
+    // 活跃的连接一直没有被关闭
+    ZY_ASSERT(active->send("b", 1) == 1);
+    ZY_ASSERT(active->recv(&c, 1) == 1 && c == 'b');
+
+    // 在长任务里刚回复过的连接是活跃的，不能按任务开始时的循环时间判为空闲
+    ZY_ASSERT(active->send("s", 1) == 1);
+    ZY_ASSERT(active->recv(&c, 1) == 1 && c == 's');
+    usleep(50 * 1000);
+    ZY_ASSERT(active->send("c", 1) == 1);
+    ZY_ASSERT(active->recv(&c, 1) == 1 && c == 'c');
+    ZY_ASSERT(server->closed == 1);
+
+    active->close();
+    idle->close();
+    server->stop();
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_idle_timeout ok";
+}
+
+int main(int argc, char **argv) {
+    Reactor r("idle");
+    r.addTask(test_idle_timeout);
+    return 0;
+}
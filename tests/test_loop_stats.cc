@@ -0,0 +1,28 @@
+#include <unistd.h>
+#include <iostream>
+#include "reactor.h"
+#include "loop_stats.h"
+
+using namespace zy;
+
+void busy_task() {
+    // 模拟一个长时间不 yield 的任务
+    uint64_t begin = LoopStats::NowUs();
+    while (LoopStats::NowUs() - begin < 20 * 1000);
+}
+
+int main() {
+    LoopStats::SetEnabled(true);
+    {
+        Reactor r("stats", 1);
+        for (int i = 0; i < 10; ++i) {
+            r.addTimer(10 * i, [](){});
+        }
+        r.addTask(busy_task);
+        r.addTask([](){
+            sleep(1);
+        });
+    }
+    std::cout << LoopStatsMgr::GetInstance().toString();
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <atomic>
+#include "reactor.h"
+#include "socket.h"
+#include "resolver.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+/**
+ * @brief 本机的假 DNS 服务器，按名字返回固定的应答
+ */
+static Socket::ptr s_udp;
+static Socket::ptr s_tcp;
+static std::atomic<int> s_udp_queries{0};
+static std::atomic<int> s_tcp_queries{0};
+
+static void put16(std::string &s, uint16_t value) {
+    s.push_back(static_cast<char>(value >> 8));
+    s.push_back(static_cast<char>(value & 0xff));
+}
+
+static void put32(std::string &s, uint32_t value) {
+    put16(s, value >> 16);
+    put16(s, value & 0xffff);
+}
+
+/**
+ * @brief 根据查询构造应答
+ * @param tcp 是否是 TCP 查询，big.test 在 UDP 上返回截断的应答
+ */
+static std::string answer(const char *query, size_t length, bool tcp) {
+    // 问题从第 12 字节开始，到第一个 0 长度的标签为止
+    size_t offset = 12;
+    std::string name;
+    while (query[offset]) {
+        if (!name.empty()) {
+            name += ".";
+        }
+        name.append(query + offset + 1, query[offset]);
+        offset += 1 + query[offset];
+    }
+    uint16_t qtype = static_cast<uint16_t>(static_cast<uint8_t>(query[offset + 1]) << 8
+                                           | static_cast<uint8_t>(query[offset + 2]));
+    std::string question(query + 12, offset + 5 - 12);
+
+    uint16_t flags = 0x8180;
+    std::string records;
+    uint16_t ancount = 0, nscount = 0;
+    // 应答中的名字都用指向问题的压缩指针
+    auto record = [&](uint16_t type, uint32_t ttl, const std::string &rdata) {
+        put16(records, 0xc00c);
+        put16(records, type);
+        put16(records, 1);
+        put32(records, ttl);
+        put16(records, static_cast<uint16_t>(rdata.size()));
+        records += rdata;
+    };
+    if (name == "cached.test" && qtype == 1) {
+        record(1, 60, std::string("\x0a\x00\x00\x01", 4));
+        ++ancount;
+    } else if (name == "cached.test" && qtype == 28) {
+        std::string v6(16, '\0');
+        v6[15] = 1;
+        record(28, 60, v6);
+        ++ancount;
+    } else if (name == "short.test" && qtype == 1) {
+        record(1, 1, std::string("\x0a\x00\x00\x02", 4));
+        ++ancount;
+    } else if (name == "svc.corp.test" && qtype == 1) {
+        record(1, 60, std::string("\x0a\x00\x00\x09", 4));
+        ++ancount;
+    } else if (name == "big.test" && qtype == 1) {
+        if (!tcp) {
+            flags |= 0x0200;
+        } else {
+            for (int i = 0; i < 40; ++i) {
+                record(1, 60, std::string("\x0a\x01\x00", 3) + static_cast<char>(i));
+                ++ancount;
+            }
+        }
+    } else {
+        // NXDOMAIN，SOA 的 MINIMUM 为 1 秒
+        flags |= 3;
+        std::string soa("\x00\x00", 2);
+        put32(soa, 1);
+        put32(soa, 3600);
+        put32(soa, 600);
+        put32(soa, 86400);
+        put32(soa, 1);
+        record(6, 300, soa);
+        ++nscount;
+    }
+
+    std::string response(query, 2);
+    put16(response, flags);
+    put16(response, 1);
+    put16(response, ancount);
+    put16(response, nscount);
+    put16(response, 0);
+    return response + question + records;
+}
+
+static void serve_udp() {
+    char buffer[512];
+    Address::ptr from = std::make_shared<IPv4Address>();
+    while (true) {
+        size_t n = s_udp->recvFrom(buffer, sizeof buffer, from);
+        if (n == static_cast<size_t>(-1) || std::string(buffer, n) == "quit") {
+            break;
+        }
+        ++s_udp_queries;
+        std::string response = answer(buffer, n, false);
+        s_udp->sendTo(response.data(), response.size(), from);
+    }
+}
+
+static void serve_tcp() {
+    Socket::ptr client = s_tcp->accept();
+    if (!client) {
+        return;
+    }
+    char prefix[2];
+    while (client->recv(prefix, 2, MSG_WAITALL) == 2) {
+        size_t length = static_cast<uint8_t>(prefix[0]) << 8 | static_cast<uint8_t>(prefix[1]);
+        std::string query(length, '\0');
+        ZY_ASSERT(client->recv(&query[0], length, MSG_WAITALL) == length);
+        ++s_tcp_queries;
+        std::string response = answer(query.data(), length, true);
+        std::string packet;
+        put16(packet, static_cast<uint16_t>(response.size()));
+        packet += response;
+        client->send(packet.data(), packet.size());
+    }
+}
+
+void test_resolver() {
+    std::string hosts = "/tmp/zy_test_resolver_hosts_" + std::to_string(getpid());
+    std::string resolv_conf = "/tmp/zy_test_resolver_conf_" + std::to_string(getpid());
+    std::ofstream(hosts) << "# comment\n10.1.2.3 MyHost alias # trailing\nfe80::1 myhost\n";
+    std::ofstream(resolv_conf) << "nameserver 127.0.0.1\nsearch corp.test\noptions ndots:1 timeout:1 attempts:1\n";
+
+    Resolver resolver(resolv_conf, hosts);
+    resolver.setNameservers({std::dynamic_pointer_cast<IPAddress>(s_udp->getLocalAddress())});
+
+    // 数字地址和 hosts 文件不查询 DNS
+    ZY_ASSERT(resolver.lookupAny("192.168.0.1", 80)->toString() == "192.168.0.1:80");
+    ZY_ASSERT(resolver.lookupAny("::1", 80)->toString() == "[::1]:80");
+    auto addresses = resolver.lookup("myhost", 8080);
+    ZY_ASSERT(addresses.size() == 2 && addresses[0]->toString() == "10.1.2.3:8080");
+    ZY_ASSERT(resolver.lookupAny("ALIAS", 0, AF_INET)->toString() == "10.1.2.3:0");
+    ZY_ASSERT(resolver.lookupAny("localhost", 0, AF_INET)->toString() == "127.0.0.1:0");
+    ZY_ASSERT(resolver.getQueryCount() == 0);
+
+    // A 和 AAAA 一起查询，之后命中缓存
+    addresses = resolver.lookup("cached.test.", 443);
+    ZY_ASSERT(addresses.size() == 2);
+    ZY_ASSERT(addresses[0]->toString() == "10.0.0.1:443");
+    ZY_ASSERT(addresses[1]->toString() == "[::1]:443");
+    ZY_ASSERT(resolver.getQueryCount() == 2);
+    ZY_ASSERT(resolver.lookup("Cached.Test.", 443).size() == 2);
+    ZY_ASSERT(resolver.getQueryCount() == 2);
+
+    // TTL 到期后重新查询
+    ZY_ASSERT(resolver.lookupAny("short.test.", 0, AF_INET)->toString() == "10.0.0.2:0");
+    ZY_ASSERT(resolver.lookupAny("short.test.", 0, AF_INET));
+    ZY_ASSERT(resolver.getQueryCount() == 3);
+    usleep(1100 * 1000);
+    ZY_ASSERT(resolver.lookupAny("short.test.", 0, AF_INET));
+    ZY_ASSERT(resolver.getQueryCount() == 4);
+
+    // 否定缓存，按 SOA 的 MINIMUM 过期
+    ZY_ASSERT(resolver.lookup("missing.test.", 0, AF_INET).empty());
+    ZY_ASSERT(resolver.lookup("missing.test.", 0, AF_INET).empty());
+    ZY_ASSERT(resolver.getQueryCount() == 5);
+    usleep(1100 * 1000);
+    ZY_ASSERT(resolver.lookup("missing.test.", 0, AF_INET).empty());
+    ZY_ASSERT(resolver.getQueryCount() == 6);
+
+    // 点少于 ndots 的名字先尝试搜索域
+    ZY_ASSERT(resolver.lookupAny("svc", 0, AF_INET)->toString() == "10.0.0.9:0");
+
+    // 应答被截断时改用 TCP
+    addresses = resolver.lookup("big.test.", 0, AF_INET);
+    ZY_ASSERT(addresses.size() == 40);
+    ZY_ASSERT(s_tcp_queries == 1);
+
+    // 不合法的名字和没有应答的服务器
+    ZY_ASSERT(resolver.lookup("bad..name").empty());
+    resolver.setNameservers({IPv4Address::Create("127.0.0.1", 1)});
+    resolver.setTimeout(200, 1);
+    ZY_ASSERT(resolver.lookup("cached.test.").empty());
+
+    unlink(hosts.c_str());
+    unlink(resolv_conf.c_str());
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_resolver ok, udp queries = " << s_udp_queries;
+
+    Socket::ptr quit = Socket::CreateUDP();
+    quit->sendTo("quit", 4, s_udp->getLocalAddress());
+}
+
+int main(int argc, char **argv) {
+    Reactor r("resolver");
+    // 套接字要在协程中创建，hook 才会把它设置为非阻塞
+    r.addTask([&r]() {
+        s_udp = Socket::CreateUDP();
+        ZY_ASSERT(s_udp->bind(IPv4Address::Create("127.0.0.1", 0)));
+        // TCP 监听与 UDP 使用同一个端口
+        s_tcp = Socket::CreateTCP();
+        ZY_ASSERT(s_tcp->bind(s_udp->getLocalAddress()));
+        ZY_ASSERT(s_tcp->listen());
+        r.addTask(serve_udp);
+        r.addTask(serve_tcp);
+        r.addTask(test_resolver);
+    });
+    return 0;
+}
@@ -3,8 +3,14 @@
 #include <arpa/inet.h>
 #include <iostream>
 #include <cstring>
+#include <string>
+#include <atomic>
+#include <vector>
+#include <fcntl.h>
 #include "reactor.h"
 #include "socket.h"
+#include "utils/macro.h"
+#include "test_util.h"
 
 using namespace zy;
 
@@ -36,7 +42,301 @@ void test_sock() {
     ZY_LOG_INFO(ZY_LOG_ROOT()) << "recv buffer = " << buffer;
 }
 
+/**
+ * @brief 接收 length 字节，对端提前关闭时返回已收到的数据
+ */
+static std::string recv_all(const Socket::ptr &sock, size_t length) {
+    std::string data(length, '\0');
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = sock->recv(&data[total], length - total);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    data.resize(total);
+    return data;
+}
+
+void test_send_file() {
+    const char *path = "/tmp/zy_test_send_file";
+    std::string content;
+    for (int i = 0; content.size() < 1024 * 1024; ++i) {
+        content += std::to_string(i) + "\n";
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ZY_ASSERT(fd >= 0);
+    ZY_ASSERT(write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+
+    Socket::ptr client, server;
+    make_pair(client, server);
+    Reactor::GetThis()->addTask([server, fd, &content]() {
+        // 从偏移 100 开始发送，长度超过文件末尾时发送到文件末尾
+        ZY_ASSERT(server->sendFile(fd, 100, content.size()) == content.size() - 100);
+        server->close();
+    });
+    ZY_ASSERT(recv_all(client, content.size()) == content.substr(100));
+    // 文件读写位置不变
+    ZY_ASSERT(lseek(fd, 0, SEEK_CUR) == static_cast<off_t>(content.size()));
+    close(fd);
+    unlink(path);
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_send_file ok";
+}
+
+/**
+ * @brief /proc 下的文件不支持 sendfile（EINVAL），退化为读出来再发送
+ */
+void test_send_file_fallback() {
+    int fd = open("/proc/self/cmdline", O_RDONLY);
+    ZY_ASSERT(fd >= 0);
+    char expect[4096];
+    ssize_t length = pread(fd, expect, sizeof expect, 0);
+    ZY_ASSERT(length > 0);
+
+    Socket::ptr client, server;
+    make_pair(client, server);
+    Reactor::GetThis()->addTask([server, fd, length]() {
+        ZY_ASSERT(server->sendFile(fd, 0, length) == static_cast<size_t>(length));
+        server->close();
+    });
+    ZY_ASSERT(recv_all(client, length) == std::string(expect, length));
+    close(fd);
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_send_file_fallback ok";
+}
+
+void test_splice() {
+    // c1 -> s1 ==splice==> s2 -> c2
+    Socket::ptr c1, s1, c2, s2;
+    make_pair(c1, s1);
+    make_pair(c2, s2);
+    std::string content(4 * 1024 * 1024, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i * 131);
+    }
+
+    Reactor::GetThis()->addTask([c1, &content]() {
+        // send 在套接字缓冲区满时只发送一部分
+        size_t total = 0;
+        while (total < content.size()) {
+            ssize_t n = c1->send(content.data() + total, content.size() - total);
+            ZY_ASSERT(n > 0);
+            total += n;
+        }
+        c1->close();
+    });
+    Reactor::GetThis()->addTask([s1, s2, &content]() {
+        // 对端关闭，转发的字节数小于 length
+        ZY_ASSERT(Socket::Splice(s1, s2, content.size() * 2) == content.size());
+        s2->close();
+    });
+    ZY_ASSERT(recv_all(c2, content.size() + 1) == content);
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_splice ok";
+}
+
+void test_zero_copy() {
+    Socket::ptr client, server;
+    make_pair(client, server);
+    if (!server->setZeroCopy(1024)) {
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_zero_copy skipped, SO_ZEROCOPY not supported";
+        return;
+    }
+
+    std::weak_ptr<std::string> weak;
+    std::string expected;
+    {
+        auto data = std::make_shared<std::string>(256 * 1024, 'z');
+        weak = data;
+        expected = *data + *data;
+        Reactor::GetThis()->addTask([server, data]() {
+            // 两次发送引用同一块内存，小于阈值的一次走普通发送
+            for (int i = 0; i < 2; ++i) {
+                size_t total = 0;
+                while (total < data->size()) {
+                    size_t n = server->sendZeroCopy(data->data() + total, data->size() - total, data);
+                    ZY_ASSERT(static_cast<ssize_t>(n) > 0);
+                    total += n;
+                }
+            }
+            ZY_ASSERT(server->sendZeroCopy("end", 3, nullptr) == 3);
+        });
+    }
+    ZY_ASSERT(recv_all(client, expected.size() + 3) == expected + "end");
+
+    // 完成通知由反应堆回收，之后缓冲区被释放
+    for (int i = 0; i < 100 && server->getZeroCopyPending(); ++i) {
+        usleep(10 * 1000);
+    }
+    ZY_ASSERT(server->getZeroCopyPending() == 0);
+    ZY_ASSERT(weak.expired());
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_zero_copy ok, copied " << server->getZeroCopyCopied();
+}
+
+void test_batch() {
+    Socket::ptr receiver = Socket::CreateUDP();
+    ZY_ASSERT(receiver->bind(IPv4Address::Create("127.0.0.1", 0)));
+    Socket::ptr sender = Socket::CreateUDP();
+    ZY_ASSERT(sender->bind(IPv4Address::Create("127.0.0.1", 0)));
+    Address::ptr to = receiver->getLocalAddress();
+
+    // 发送端后启动，接收端先挂起在 recvmmsg 上
+    Reactor::GetThis()->addTask([sender, to]() {
+        DatagramBatch batch(32);
+        for (int i = 0; i < 32; ++i) {
+            std::string msg = "msg " + std::to_string(i);
+            ZY_ASSERT(batch.push(msg.data(), msg.size(), to));
+        }
+        ZY_ASSERT(!batch.push("x", 1, to));
+        ZY_ASSERT(sender->sendBatch(batch) == 32);
+
+        // 一个 GSO 数据报被切成 4 个 1000 字节的数据报
+        DatagramBatch gso(1, 65535);
+        std::string big(4000, 'g');
+        ZY_ASSERT(gso.push(big.data(), big.size(), to, 1000));
+        ZY_ASSERT(sender->sendBatch(gso) == 1);
+    });
+
+    DatagramBatch batch(16);
+    int received = 0;
+    while (received < 32) {
+        size_t n = receiver->recvBatch(batch);
+        ZY_ASSERT(n > 0 && n <= 16 && n == batch.size());
+        for (size_t i = 0; i < n; ++i, ++received) {
+            ZY_ASSERT(std::string(batch.data(i), batch.length(i)) == "msg " + std::to_string(received));
+            ZY_ASSERT(batch.getAddress(i)->toString() == sender->getLocalAddress()->toString());
+        }
+    }
+    size_t total = 0;
+    while (total < 4000) {
+        size_t n = receiver->recvBatch(batch);
+        for (size_t i = 0; i < n; ++i) {
+            ZY_ASSERT(batch.length(i) == 1000 && batch.segment(i) == 0);
+            total += batch.length(i);
+        }
+    }
+
+    // 开启 GRO 后连续到达的分段可能被合并成一个数据报，按 segment 切开
+    Socket::ptr gro = Socket::CreateUDP();
+    ZY_ASSERT(gro->bind(IPv4Address::Create("127.0.0.1", 0)));
+    if (gro->setGRO(true)) {
+        DatagramBatch gso(1, 65535);
+        std::string big(4000, 'g');
+        ZY_ASSERT(gso.push(big.data(), big.size(), gro->getLocalAddress(), 1000));
+        ZY_ASSERT(sender->sendBatch(gso) == 1);
+        DatagramBatch merged(4, 65535);
+        size_t segments = 0;
+        while (segments < 4) {
+            size_t n = gro->recvBatch(merged);
+            for (size_t i = 0; i < n; ++i) {
+                size_t segment = merged.segment(i) ? merged.segment(i) : merged.length(i);
+                ZY_ASSERT(segment == 1000 && merged.length(i) % segment == 0);
+                segments += merged.length(i) / segment;
+            }
+        }
+    }
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_batch ok";
+}
+
+/**
+ * @brief 在 addr 上建立一对已连接的流式套接字并互相收发
+ */
+static void check_stream(const Address::ptr &addr) {
+    Socket::ptr listener = Socket::CreateTCP(addr->getFamily());
+    ZY_ASSERT(listener->bind(addr));
+    ZY_ASSERT(listener->listen());
+    Socket::ptr client = Socket::CreateTCP(addr->getFamily());
+    ZY_ASSERT(client->connect(listener->getLocalAddress()));
+    Socket::ptr server = listener->accept();
+    ZY_ASSERT(server);
+
+    std::string ping = "ping " + addr->toString();
+    ZY_ASSERT(client->send(ping.data(), ping.size()) == ping.size());
+    ZY_ASSERT(recv_all(server, ping.size()) == ping);
+    ZY_ASSERT(server->send("pong", 4) == 4);
+    ZY_ASSERT(recv_all(client, 4) == "pong");
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "stream ok, local = " << server->getLocalAddress()->toString()
+                               << ", peer = " << server->getPeerAddress()->toString();
+}
+
+void test_unix() {
+    // 抽象地址
+    check_stream(UnixAddress::Create("zy_test_socket", true));
+
+    // 文件系统路径，套接字文件由调用者删除
+    std::string path = "/tmp/zy_test_socket_" + std::to_string(getpid()) + ".sock";
+    check_stream(UnixAddress::Create(path));
+    unlink(path.c_str());
+
+    // 数据报，recvFrom 拿到发送方的路径
+    UnixAddress::ptr from_addr = UnixAddress::Create("zy_test_dgram_from", true);
+    UnixAddress::ptr to_addr = UnixAddress::Create("zy_test_dgram_to", true);
+    Socket::ptr from = Socket::CreateUnix(SOCK_DGRAM);
+    Socket::ptr to = Socket::CreateUnix(SOCK_DGRAM);
+    ZY_ASSERT(from->bind(from_addr));
+    ZY_ASSERT(to->bind(to_addr));
+    ZY_ASSERT(from->sendTo("hello", 5, to_addr) == 5);
+    char buffer[16] = {0};
+    Address::ptr sender = std::make_shared<UnixAddress>();
+    ZY_ASSERT(to->recvFrom(buffer, sizeof buffer, sender) == 5);
+    ZY_ASSERT(std::string(buffer, 5) == "hello");
+    ZY_ASSERT(sender->toString() == from_addr->toString());
+
+    // socketpair 也走 hook
+    int sv[2];
+    ZY_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ZY_ASSERT(write(sv[0], "pair", 4) == 4);
+    ZY_ASSERT(read(sv[1], buffer, sizeof buffer) == 4);
+    close(sv[0]);
+    close(sv[1]);
+
+    // 监听队列满时 connect 挂起重试，直到对端 accept
+    UnixAddress::ptr busy_addr = UnixAddress::Create("zy_test_backlog", true);
+    Socket::ptr busy = Socket::CreateUnix();
+    ZY_ASSERT(busy->bind(busy_addr));
+    ZY_ASSERT(busy->listen(0));
+    static std::atomic<int> connected{0};
+    for (int i = 0; i < 4; ++i) {
+        Reactor::GetThis()->addTask([busy_addr]() {
+            Socket::ptr client = Socket::CreateUnix();
+            ZY_ASSERT(client->connect(busy_addr));
+            ++connected;
+        });
+    }
+    usleep(10 * 1000);
+    ZY_ASSERT(connected < 4);
+    std::vector<Socket::ptr> accepted;
+    while (accepted.size() < 4) {
+        accepted.push_back(busy->accept());
+    }
+    while (connected < 4) {
+        usleep(1000);
+    }
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_unix ok";
+}
+
+void test_ipv6() {
+    Socket::ptr probe = Socket::CreateTCP(AF_INET6);
+    if (!probe->bind(IPv6Address::Create("::1", 0))) {
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_ipv6 skipped, ::1 is not available";
+        return;
+    }
+    probe->close();
+    check_stream(IPv6Address::Create("::1", 0));
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_ipv6 ok";
+}
+
 int main(int argc, char **argv) {
+    {
+        Reactor r("transfer");
+        r.addTask(test_send_file);
+        r.addTask(test_send_file_fallback);
+        r.addTask(test_splice);
+        r.addTask(test_zero_copy);
+        r.addTask(test_batch);
+        r.addTask(test_unix);
+        r.addTask(test_ipv6);
+    }
+
     Reactor r("socket");
     r.addTask(test_sock);
     return 0;
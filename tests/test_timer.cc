@@ -4,7 +4,12 @@
 
 #include "timer.h"
 #include <iostream>
+#include <random>
+#include <atomic>
+#include <unistd.h>
 #include "reactor.h"
+#include "thread.h"
+#include "utils/macro.h"
 
 using namespace zy;
 
@@ -21,7 +26,103 @@ void timer_callback() {
     }
 }
 
+/**
+ * @brief 使用模拟时间检查时间轮：每个节点都在到期之后、且不晚于一次推进步长内被摘下
+ */
+void test_wheel() {
+    std::mt19937_64 rng(0);
+    uint64_t now = 1000000;
+    TimerWheel wheel(1, now);
+    std::vector<TimerNode> nodes(100000);
+    for (auto &node : nodes) {
+        node.time_ = now + rng() % (1ull << 24);
+        wheel.add(&node);
+    }
+    // 随机取消一部分
+    for (size_t i = 0; i < nodes.size(); i += 7) {
+        wheel.remove(&nodes[i]);
+    }
+
+    size_t fired = 0;
+    std::vector<TimerNode *> expired;
+    while (!wheel.empty()) {
+        uint64_t next = wheel.nextExpireTime();
+        ZY_ASSERT(next >= now);
+        uint64_t step = 1 + rng() % 5000;
+        now = std::min(now + step, std::max(next, now + 1));
+        expired.clear();
+        wheel.advance(now, expired);
+        for (auto node : expired) {
+            ZY_ASSERT(node->time_ <= now);
+            ZY_ASSERT(node->time_ + 5000 >= now);
+        }
+        fired += expired.size();
+    }
+    ZY_ASSERT(fired == nodes.size() - (nodes.size() + 6) / 7);
+    std::cout << "test_wheel fired " << fired << " timers" << std::endl;
+}
+
+/**
+ * @brief 在非反应堆线程和反应堆线程之间交叉新增、取消、重置定时器：取消成功的不执行，其余的恰好执行一次
+ */
+void test_cross_thread() {
+    static const size_t N = 2000;
+    std::vector<std::atomic<int>> fired(N);
+    std::vector<Timer::ptr> timers(N);
+    std::vector<bool> cancelled(N, false);
+    std::atomic<size_t> added{0};
+    std::atomic<int> ticks{0};
+    {
+        Reactor r("cross", 3);
+        // 一半在反应堆线程上新增，一半在普通线程上新增
+        for (size_t i = 0; i < N; i += 2) {
+            r.addTask([&, i]() {
+                timers[i] = r.addTimer(50 + i % 150, [&, i]() { ++fired[i]; });
+                ++added;
+            });
+        }
+        Thread adder("adder", [&]() {
+            for (size_t i = 1; i < N; i += 2) {
+                timers[i] = r.addTimer(50 + i % 150, [&, i]() { ++fired[i]; });
+                ++added;
+            }
+        });
+        adder.join();
+        while (added < N) {
+            usleep(1000);
+        }
+        Timer::ptr recurring = r.addTimer(10, [&]() { ++ticks; }, true);
+        // 在另一个线程上取消、重置
+        Thread canceller("canceller", [&]() {
+            for (size_t i = 0; i < N; ++i) {
+                if (i % 4 == 0) {
+                    cancelled[i] = timers[i]->cancel();
+                } else if (i % 4 == 1) {
+                    timers[i]->reset(10, true);
+                }
+            }
+        });
+        canceller.join();
+        usleep(300 * 1000);
+        ZY_ASSERT(recurring->cancel());
+        // 取消之前已经取出的回调可能还没执行完
+        usleep(50 * 1000);
+        int stopped = ticks;
+        usleep(50 * 1000);
+        ZY_ASSERT(ticks == stopped && stopped > 0);
+    }
+    size_t fired_num = 0;
+    for (size_t i = 0; i < N; ++i) {
+        ZY_ASSERT(fired[i] == (cancelled[i] ? 0 : 1));
+        fired_num += fired[i];
+    }
+    std::cout << "test_cross_thread fired " << fired_num << " timers" << std::endl;
+}
+
 int main() {
+    test_wheel();
+    test_cross_thread();
+
     Reactor r("reactor");
     // 循环定时器
     s_timer = r.addTimer(1000, timer_callback, true);
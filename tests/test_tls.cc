@@ -0,0 +1,150 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#include "reactor.h"
+#include "tcp_server.h"
+#include "secure_socket.h"
+#include "utils/macro.h"
+
+using namespace zy;
+
+static std::string s_file_path;
+static std::string s_file_data;
+
+/**
+ * @brief 回显服务器，收到 "file" 时用 sendFile 发送测试文件，收到 "bye" 时关闭连接
+ */
+class EchoServer : public TCPServer {
+public:
+    using TCPServer::TCPServer;
+
+protected:
+    void handleClient(const Socket::ptr &client) override {
+        char buffer[4096];
+        while (true) {
+            size_t n = client->recv(buffer, sizeof buffer);
+            if (n == 0 || n == static_cast<size_t>(-1)) {
+                break;
+            }
+            if (std::string(buffer, n) == "bye") {
+                break;
+            }
+            if (std::string(buffer, n) == "file") {
+                int fd = open(s_file_path.c_str(), O_RDONLY);
+                ZY_ASSERT(client->sendFile(fd, 0, s_file_data.size()) == s_file_data.size());
+                close(fd);
+                continue;
+            }
+            ZY_ASSERT(client->send(buffer, n) == n);
+        }
+        auto secure = std::dynamic_pointer_cast<SecureSocket>(client);
+        ZY_ASSERT(secure);
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "server " << secure->getVersion() << " " << secure->getCipher()
+                                   << " ktls send = " << secure->isKTLSSend()
+                                   << " recv = " << secure->isKTLSRecv();
+        client->close();
+    }
+};
+
+static std::string recv_all(const Socket::ptr &sock, size_t length) {
+    std::string data(length, '\0');
+    size_t total = 0;
+    while (total < length) {
+        size_t n = sock->recv(&data[total], length - total);
+        if (n == 0 || n == static_cast<size_t>(-1)) {
+            break;
+        }
+        total += n;
+    }
+    data.resize(total);
+    return data;
+}
+
+void test_tls() {
+    s_file_path = "/tmp/zy_test_tls_" + std::to_string(getpid());
+    s_file_data.resize(300 * 1024);
+    for (size_t i = 0; i < s_file_data.size(); ++i) {
+        s_file_data[i] = static_cast<char>(i * 7);
+    }
+    int fd = open(s_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ZY_ASSERT(write(fd, s_file_data.data(), s_file_data.size()) == static_cast<ssize_t>(s_file_data.size()));
+    close(fd);
+
+    TlsContext::ptr server_ctx = TlsContext::CreateSelfSigned();
+    ZY_ASSERT(server_ctx);
+    std::shared_ptr<EchoServer> server(new EchoServer("tls"));
+    server->setTlsContext(server_ctx);
+    ZY_ASSERT(server->bind(IPv4Address::Create("127.0.0.1", 0)));
+    server->start();
+    Address::ptr addr = server->getListenSock()->getLocalAddress();
+
+    // 自签名证书通不过系统 CA 的校验
+    SecureSocket::ptr strict = SecureSocket::CreateTCP(TlsContext::CreateClient(true));
+    strict->setHostName("localhost");
+    ZY_ASSERT(!strict->connect(addr));
+
+    TlsContext::ptr client_ctx = TlsContext::CreateClient(false);
+    {
+        SecureSocket::ptr client = SecureSocket::CreateTCP(client_ctx);
+        client->setHostName("localhost");
+        ZY_ASSERT(client->connect(addr));
+        ZY_ASSERT(!client->isSessionReused());
+
+        // 多个 iovec 合并发送，回显后分散接收
+        std::string head = "hello ", body = "tls";
+        iovec out[2] = {{&head[0], head.size()}, {&body[0], body.size()}};
+        ZY_ASSERT(client->send(out, 2) == head.size() + body.size());
+        std::string echo(head.size() + body.size(), '\0');
+        iovec in[2] = {{&echo[0], 2}, {&echo[2], echo.size() - 2}};
+        size_t got = client->recv(in, 2);
+        if (got < echo.size()) {
+            echo = echo.substr(0, got) + recv_all(client, echo.size() - got);
+        }
+        ZY_ASSERT(echo == "hello tls");
+
+        std::string big(256 * 1024, 'x');
+        ZY_ASSERT(client->send(big.data(), big.size()) == big.size());
+        ZY_ASSERT(recv_all(client, big.size()) == big);
+
+        ZY_ASSERT(client->send("file", 4) == 4);
+        ZY_ASSERT(recv_all(client, s_file_data.size()) == s_file_data);
+        ZY_LOG_INFO(ZY_LOG_ROOT()) << "client " << client->getVersion() << " " << client->getCipher()
+                                   << " ktls send = " << client->isKTLSSend()
+                                   << " recv = " << client->isKTLSRecv();
+    }
+
+    // 同一个客户端上下文连接同一个主机名时恢复会话
+    {
+        SecureSocket::ptr client = SecureSocket::CreateTCP(client_ctx);
+        client->setHostName("localhost");
+        ZY_ASSERT(client->connect(addr));
+        ZY_ASSERT(client->isSessionReused());
+        ZY_ASSERT(client->send("again", 5) == 5);
+        ZY_ASSERT(recv_all(client, 5) == "again");
+    }
+
+    // 对端关闭后继续发送，返回错误而不是被 SIGPIPE 杀死，进程没有忽略 SIGPIPE
+    {
+        SecureSocket::ptr client = SecureSocket::CreateTCP(client_ctx);
+        client->setHostName("localhost");
+        ZY_ASSERT(client->connect(addr));
+        ZY_ASSERT(client->send("bye", 3) == 3);
+        usleep(50 * 1000);
+        std::string big(256 * 1024, 'x');
+        size_t rt = 0;
+        for (int i = 0; i < 10 && rt != static_cast<size_t>(-1); ++i) {
+            rt = client->send(big.data(), big.size());
+        }
+        ZY_ASSERT(rt == static_cast<size_t>(-1));
+    }
+
+    unlink(s_file_path.c_str());
+    server->stop();
+    ZY_LOG_INFO(ZY_LOG_ROOT()) << "test_tls ok";
+}
+
+int main(int argc, char **argv) {
+    Reactor r("tls");
+    r.addTask(test_tls);
+    return 0;
+}
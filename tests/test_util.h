@@ -0,0 +1,24 @@
+#ifndef __ZY_TEST_UTIL_H__
+#define __ZY_TEST_UTIL_H__
+
+#include "socket.h"
+#include "utils/macro.h"
+
+namespace zy {
+
+/**
+ * @brief 在回环地址上建立一对已连接的套接字
+ */
+inline void make_pair(Socket::ptr &client, Socket::ptr &server) {
+    Socket::ptr listener = Socket::CreateTCP();
+    ZY_ASSERT(listener->bind(IPv4Address::Create("127.0.0.1", 0)));
+    ZY_ASSERT(listener->listen());
+    client = Socket::CreateTCP();
+    ZY_ASSERT(client->connect(listener->getLocalAddress()));
+    server = listener->accept();
+    ZY_ASSERT(server);
+}
+
+}
+
+#endif
@@ -2,12 +2,14 @@
 
 #include <sstream>
 #include <cstring>
+#include <cstddef>
+#include <algorithm>
 #include "utils/macro.h"
 #include "utils/endian.h"
 
 namespace zy {
 
-Address::ptr Address::Create(const sockaddr *addr) {
+Address::ptr Address::Create(const sockaddr *addr, socklen_t addrlen) {
     if (!addr) {
         return nullptr;
     }
@@ -17,6 +19,20 @@ Address::ptr Address::Create(const sockaddr *addr) {
         case AF_INET:
             address.reset(new IPv4Address(*(sockaddr_in *)(addr)));
             break;
+        case AF_INET6:
+            address.reset(new IPv6Address(*(sockaddr_in6 *)(addr)));
+            break;
+        case AF_UNIX: {
+            auto unix_address = std::make_shared<UnixAddress>();
+            if (!addrlen) {
+                addrlen = offsetof(sockaddr_un, sun_path) + strlen(((sockaddr_un *) addr)->sun_path) + 1;
+            }
+            addrlen = std::min<socklen_t>(addrlen, sizeof(sockaddr_un));
+            memcpy(unix_address->getAddr(), addr, addrlen);
+            unix_address->setAddrLen(addrlen);
+            address = unix_address;
+            break;
+        }
         default:
             address.reset();
             break;
@@ -37,8 +53,9 @@ std::string Address::toString() const {
 IPv4Address::ptr IPv4Address::Create(const char *address, uint16_t port) {
     IPv4Address::ptr addr(new IPv4Address);
     addr->addr_.sin_port = onBigEndian(port);
-    int rt = inet_pton(AF_INET, address, &addr->addr_.sin_addr);
-    ZY_ASSERT(rt > 0);
+    if (inet_pton(AF_INET, address, &addr->addr_.sin_addr) <= 0) {
+        return nullptr;
+    }
     return addr;
 }
 
@@ -74,6 +91,117 @@ std::ostream &IPv4Address::dump(std::ostream &os) const {
 }
 
 uint16_t IPv4Address::getPort() const {
-    return addr_.sin_port;
+    return onBigEndian(addr_.sin_port);
+}
+
+IPv6Address::ptr IPv6Address::Create(const char *address, uint16_t port) {
+    IPv6Address::ptr addr(new IPv6Address(port));
+    if (inet_pton(AF_INET6, address, &addr->addr_.sin6_addr) <= 0) {
+        return nullptr;
+    }
+    return addr;
+}
+
+IPv6Address::IPv6Address(uint16_t port) {
+    memset(&addr_, 0, sizeof addr_);
+    addr_.sin6_family = AF_INET6;
+    addr_.sin6_addr = in6addr_any;
+    addr_.sin6_port = onBigEndian(port);
+}
+
+IPv6Address::IPv6Address(const sockaddr_in6 &address) : addr_(address) { }
+
+IPv6Address::IPv6Address(const uint8_t address[16], uint16_t port) {
+    memset(&addr_, 0, sizeof addr_);
+    addr_.sin6_family = AF_INET6;
+    memcpy(&addr_.sin6_addr, address, sizeof addr_.sin6_addr);
+    addr_.sin6_port = onBigEndian(port);
+}
+
+const sockaddr *IPv6Address::getAddr() const {
+    return (sockaddr *) &addr_;
+}
+
+sockaddr *IPv6Address::getAddr() {
+    return (sockaddr *) &addr_;
+}
+
+socklen_t IPv6Address::getAddrLen() const {
+    return sizeof addr_;
+}
+
+std::ostream &IPv6Address::dump(std::ostream &os) const {
+    char buffer[INET6_ADDRSTRLEN] = {0};
+    inet_ntop(AF_INET6, &addr_.sin6_addr, buffer, sizeof buffer);
+    os << "[" << buffer << "]:" << onBigEndian(addr_.sin6_port);
+    return os;
+}
+
+uint16_t IPv6Address::getPort() const {
+    return onBigEndian(addr_.sin6_port);
+}
+
+// sun_path 之前的部分，即 sun_family 的长度
+static const socklen_t UNIX_PATH_OFFSET = offsetof(sockaddr_un, sun_path);
+
+UnixAddress::ptr UnixAddress::Create(const std::string &path, bool abstract) {
+    // 文件系统路径需要留出结尾的 '\0'，抽象地址需要留出开头的 '\0'
+    if (path.empty() || path.size() + 1 > sizeof(sockaddr_un::sun_path)) {
+        return nullptr;
+    }
+    UnixAddress::ptr addr(new UnixAddress);
+    char *sun_path = addr->addr_.sun_path;
+    if (abstract) {
+        sun_path[0] = '\0';
+        memcpy(sun_path + 1, path.data(), path.size());
+        addr->length_ = UNIX_PATH_OFFSET + 1 + path.size();
+    } else {
+        memcpy(sun_path, path.data(), path.size());
+        sun_path[path.size()] = '\0';
+        addr->length_ = UNIX_PATH_OFFSET + path.size() + 1;
+    }
+    return addr;
+}
+
+UnixAddress::UnixAddress() : length_(sizeof addr_) {
+    memset(&addr_, 0, sizeof addr_);
+    addr_.sun_family = AF_UNIX;
+}
+
+const sockaddr *UnixAddress::getAddr() const {
+    return (sockaddr *) &addr_;
+}
+
+sockaddr *UnixAddress::getAddr() {
+    return (sockaddr *) &addr_;
+}
+
+socklen_t UnixAddress::getAddrLen() const {
+    return length_;
+}
+
+void UnixAddress::setAddrLen(socklen_t addrlen) {
+    length_ = std::min<socklen_t>(addrlen, sizeof addr_);
+}
+
+std::ostream &UnixAddress::dump(std::ostream &os) const {
+    if (isAbstract()) {
+        os << "@";
+    }
+    return os << getPath();
+}
+
+std::string UnixAddress::getPath() const {
+    if (length_ <= UNIX_PATH_OFFSET) {
+        return "";
+    }
+    if (isAbstract()) {
+        return std::string(addr_.sun_path + 1, length_ - UNIX_PATH_OFFSET - 1);
+    }
+    return std::string(addr_.sun_path, strnlen(addr_.sun_path, length_ - UNIX_PATH_OFFSET));
+}
+
+bool UnixAddress::isAbstract() const {
+    return length_ > UNIX_PATH_OFFSET && addr_.sun_path[0] == '\0';
 }
 }
\ No newline at end of file
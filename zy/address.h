@@ -2,7 +2,9 @@
 #define __ZY_ADDRESS_H__
 
 #include <memory>
+#include <string>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 
 namespace zy {
@@ -17,9 +19,10 @@ public:
     /**
      * @brief 通过 sockaddr * 创建对应的 Address
      * @param addr sockaddr 地址
-     * @return Address::ptr
+     * @param addrlen 地址长度，Unix 域地址靠它区分路径长度，0 表示 sun_path 是以 '\0' 结尾的路径
+     * @return Address::ptr，不支持的协议簇返回 nullptr
      */
-    static Address::ptr Create(const sockaddr *addr);
+    static Address::ptr Create(const sockaddr *addr, socklen_t addrlen = 0);
 
     /**
      * @brief 默认构造函数
@@ -49,6 +52,12 @@ public:
      */
     virtual socklen_t getAddrLen() const = 0;
 
+    /**
+     * @brief 设置原始地址的长度，getsockname、recvfrom 等写入地址后调用，只有变长的 Unix 域地址需要
+     * @param addrlen 地址长度
+     */
+    virtual void setAddrLen(socklen_t addrlen) { }
+
     /**
      * @brief 获取地址的协议簇
      * @return 地址的协议簇
@@ -90,12 +99,12 @@ class IPv4Address : public IPAddress {
 public:
     using ptr = std::shared_ptr<IPv4Address>;
 
-        /**
-         * @brief 通过地址和端口号创建对应的 IPv4Address
-         * @param address 点分十进制地址字符串
-         * @param port 端口号
-         * @return IPv4Address
-         */
+    /**
+     * @brief 通过地址和端口号创建对应的 IPv4Address
+     * @param address 点分十进制地址字符串
+     * @param port 端口号
+     * @return IPv4Address，地址格式错误时返回 nullptr
+     */
     static IPv4Address::ptr Create(const char *address, uint16_t port = 0);
 
     /**
@@ -152,7 +161,124 @@ private:
     sockaddr_in addr_{};
 };
 
-    // TODO 系列网络操作
+/**
+ * @brief IPv6 地址
+ */
+class IPv6Address : public IPAddress {
+public:
+    using ptr = std::shared_ptr<IPv6Address>;
+
+    /**
+     * @brief 通过地址和端口号创建对应的 IPv6Address
+     * @param address 冒号十六进制地址字符串，例如 "::1"
+     * @param port 端口号
+     * @return IPv6Address，地址格式错误时返回 nullptr
+     */
+    static IPv6Address::ptr Create(const char *address, uint16_t port = 0);
+
+    /**
+     * @brief 构造函数，地址为 in6addr_any
+     * @param port 端口号
+     */
+    explicit IPv6Address(uint16_t port = 0);
+
+    /**
+     * @brief 构造函数
+     * @param address sockaddr_in6 地址
+     */
+    explicit IPv6Address(const sockaddr_in6 &address);
+
+    /**
+     * @brief 构造函数
+     * @param address 128 位地址，网络字节序
+     * @param port 端口号
+     */
+    IPv6Address(const uint8_t address[16], uint16_t port);
+
+    /**
+     * @brief 默认析构函数
+     */
+    ~IPv6Address() override = default;
+
+    const sockaddr *getAddr() const override;
+
+    sockaddr *getAddr() override;
+
+    socklen_t getAddrLen() const override;
+
+    /**
+     * @brief 格式化为 [地址]:端口
+     * @param os 输出流
+     * @return 输出流
+     */
+    std::ostream &dump(std::ostream &os) const override;
+
+    uint16_t getPort() const override;
+
+private:
+    /// IPv6 原始地址
+    sockaddr_in6 addr_{};
+};
+
+/**
+ * @brief Unix 域套接字地址
+ * @details 同一台机器上的进程之间通信不经过 TCP/IP 协议栈，没有校验和、拥塞控制和回环网卡的开销。
+ * 地址可以是文件系统中的路径，也可以是抽象命名空间中的名字（sun_path 以 '\0' 开头），
+ * 抽象地址不在文件系统中留下文件，最后一个套接字关闭时自动消失，打印时以 '@' 开头。
+ */
+class UnixAddress : public Address {
+public:
+    using ptr = std::shared_ptr<UnixAddress>;
+
+    /**
+     * @brief 通过路径创建对应的 UnixAddress
+     * @param path 路径，抽象地址不包含开头的 '\0'
+     * @param abstract 是否是抽象命名空间中的地址
+     * @return UnixAddress，路径为空或超过 sun_path 的长度时返回 nullptr
+     */
+    static UnixAddress::ptr Create(const std::string &path, bool abstract = false);
+
+    /**
+     * @brief 构造函数，长度为 sockaddr_un 的最大长度，用于接收地址
+     */
+    UnixAddress();
+
+    /**
+     * @brief 默认析构函数
+     */
+    ~UnixAddress() override = default;
+
+    const sockaddr *getAddr() const override;
+
+    sockaddr *getAddr() override;
+
+    socklen_t getAddrLen() const override;
+
+    void setAddrLen(socklen_t addrlen) override;
+
+    /**
+     * @brief 格式化为路径，抽象地址以 '@' 开头，未命名的地址为空
+     * @param os 输出流
+     * @return 输出流
+     */
+    std::ostream &dump(std::ostream &os) const override;
+
+    /**
+     * @brief 获取路径，抽象地址不包含开头的 '\0'
+     */
+    std::string getPath() const;
+
+    /**
+     * @brief 是否是抽象命名空间中的地址
+     */
+    bool isAbstract() const;
+
+private:
+    /// Unix 域原始地址
+    sockaddr_un addr_{};
+    /// 地址长度，sun_family 加上 sun_path 中使用的部分
+    socklen_t length_;
+};
 }
 
 #endif //ZY_ADDRESS_H
@@ -0,0 +1,212 @@
+#include "buffer_pool.h"
+
+#include <cstdlib>
+#include <algorithm>
+
+namespace zy {
+
+struct BufferPool::ThreadCache {
+    /// 所属的池，第一次使用时绑定
+    BufferPool *pool = nullptr;
+    /// 已经析构，线程正在退出
+    bool dead = false;
+    /// 每个大小类缓存的块
+    std::vector<void *> blocks[CLASS_NUM];
+    std::atomic<uint64_t> allocs{0};
+    std::atomic<uint64_t> thread_hits{0};
+    std::atomic<uint64_t> central_hits{0};
+    std::atomic<uint64_t> alloc_bytes{0};
+    std::atomic<uint64_t> free_bytes{0};
+
+    ~ThreadCache() {
+        if (pool) {
+            pool->unregister(this);
+            pool = nullptr;
+        }
+        dead = true;
+    }
+};
+
+// 当前线程的缓存，线程退出时析构，把块交还给池
+static thread_local BufferPool::ThreadCache t_cache;
+
+/**
+ * @brief 单写者计数，不需要 fetch_add
+ */
+static inline void bump(std::atomic<uint64_t> &counter, uint64_t value = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+BufferPool::~BufferPool() {
+    for (char *slab : slabs_) {
+        delete[] slab;
+    }
+}
+
+int BufferPool::SizeClass(size_t size) {
+    if (size > MAX_SIZE) {
+        return -1;
+    }
+    if (size <= MIN_SIZE) {
+        return 0;
+    }
+    // MIN_SIZE 为 2^8，向上取整到 2 的幂
+    return 64 - __builtin_clzll(size - 1) - 8;
+}
+
+void *BufferPool::allocate(size_t size) {
+    int index = SizeClass(size);
+    ThreadCache *cache = getThreadCache();
+    if (index < 0) {
+        allocs_.fetch_add(1, std::memory_order_relaxed);
+        alloc_bytes_.fetch_add(size, std::memory_order_relaxed);
+        system_.fetch_add(size, std::memory_order_relaxed);
+        return malloc(size);
+    }
+
+    size_t bytes = ClassSize(index);
+    if (!cache) {
+        allocs_.fetch_add(1, std::memory_order_relaxed);
+        alloc_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        std::vector<void *> out;
+        if (fetch(index, 1, out)) {
+            central_hits_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return out.back();
+    }
+
+    bump(cache->allocs);
+    bump(cache->alloc_bytes, bytes);
+    std::vector<void *> &blocks = cache->blocks[index];
+    if (blocks.empty()) {
+        // 一次取回缓存上限的一半，之后的借出都走线程缓存
+        size_t count = std::max<size_t>(1, CACHE_BYTES / bytes / 2);
+        if (fetch(index, count, blocks)) {
+            bump(cache->central_hits);
+        }
+    } else {
+        bump(cache->thread_hits);
+    }
+    void *buffer = blocks.back();
+    blocks.pop_back();
+    return buffer;
+}
+
+void BufferPool::deallocate(void *buffer, size_t size) {
+    if (!buffer) {
+        return;
+    }
+    int index = SizeClass(size);
+    if (index < 0) {
+        free_bytes_.fetch_add(size, std::memory_order_relaxed);
+        free(buffer);
+        return;
+    }
+
+    size_t bytes = ClassSize(index);
+    ThreadCache *cache = getThreadCache();
+    if (!cache) {
+        free_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        Central &central = centrals_[index];
+        Mutex::Lock lock(central.mutex);
+        central.blocks.push_back(buffer);
+        return;
+    }
+
+    bump(cache->free_bytes, bytes);
+    std::vector<void *> &blocks = cache->blocks[index];
+    blocks.push_back(buffer);
+    if (blocks.size() * bytes > CACHE_BYTES) {
+        release(index, blocks, blocks.size() / 2);
+    }
+}
+
+BufferPool::Stats BufferPool::getStats() {
+    Stats stats;
+    stats.allocs = allocs_.load(std::memory_order_relaxed);
+    stats.thread_hits = thread_hits_.load(std::memory_order_relaxed);
+    stats.central_hits = central_hits_.load(std::memory_order_relaxed);
+    stats.system = system_.load(std::memory_order_relaxed);
+    uint64_t alloc_bytes = alloc_bytes_.load(std::memory_order_relaxed);
+    uint64_t free_bytes = free_bytes_.load(std::memory_order_relaxed);
+
+    Mutex::Lock lock(mutex_);
+    for (ThreadCache *cache : caches_) {
+        stats.allocs += cache->allocs.load(std::memory_order_relaxed);
+        stats.thread_hits += cache->thread_hits.load(std::memory_order_relaxed);
+        stats.central_hits += cache->central_hits.load(std::memory_order_relaxed);
+        alloc_bytes += cache->alloc_bytes.load(std::memory_order_relaxed);
+        free_bytes += cache->free_bytes.load(std::memory_order_relaxed);
+    }
+    // 各线程的计数是分别读取的，块在线程之间转手时可能短暂出现归还多于借出
+    stats.outstanding = alloc_bytes > free_bytes ? alloc_bytes - free_bytes : 0;
+    return stats;
+}
+
+BufferPool::ThreadCache *BufferPool::getThreadCache() {
+    if (this != &BufferPoolMgr::GetInstance() || t_cache.dead) {
+        return nullptr;
+    }
+    if (!t_cache.pool) {
+        t_cache.pool = this;
+        Mutex::Lock lock(mutex_);
+        caches_.push_back(&t_cache);
+    }
+    return &t_cache;
+}
+
+bool BufferPool::fetch(int index, size_t count, std::vector<void *> &out) {
+    Central &central = centrals_[index];
+    {
+        Mutex::Lock lock(central.mutex);
+        size_t n = std::min(count, central.blocks.size());
+        if (n > 0) {
+            out.insert(out.end(), central.blocks.end() - n, central.blocks.end());
+            central.blocks.resize(central.blocks.size() - n);
+            return true;
+        }
+    }
+
+    // 空闲链表为空，切一个新的 slab，多出来的块放进空闲链表
+    char *slab = new char[SLAB_SIZE];
+    {
+        Mutex::Lock lock(mutex_);
+        slabs_.push_back(slab);
+    }
+    system_.fetch_add(SLAB_SIZE, std::memory_order_relaxed);
+    size_t bytes = ClassSize(index);
+    size_t total = SLAB_SIZE / bytes;
+    size_t n = std::min(count, total);
+    for (size_t i = 0; i < n; ++i) {
+        out.push_back(slab + i * bytes);
+    }
+    if (n < total) {
+        Mutex::Lock lock(central.mutex);
+        for (size_t i = n; i < total; ++i) {
+            central.blocks.push_back(slab + i * bytes);
+        }
+    }
+    return false;
+}
+
+void BufferPool::release(int index, std::vector<void *> &blocks, size_t count) {
+    Central &central = centrals_[index];
+    Mutex::Lock lock(central.mutex);
+    central.blocks.insert(central.blocks.end(), blocks.end() - count, blocks.end());
+    blocks.resize(blocks.size() - count);
+}
+
+void BufferPool::unregister(ThreadCache *cache) {
+    for (int i = 0; i < CLASS_NUM; ++i) {
+        release(i, cache->blocks[i], cache->blocks[i].size());
+    }
+    Mutex::Lock lock(mutex_);
+    allocs_.fetch_add(cache->allocs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    thread_hits_.fetch_add(cache->thread_hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    central_hits_.fetch_add(cache->central_hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    alloc_bytes_.fetch_add(cache->alloc_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    free_bytes_.fetch_add(cache->free_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    caches_.erase(std::find(caches_.begin(), caches_.end(), cache));
+}
+
+}
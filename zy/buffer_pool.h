@@ -0,0 +1,173 @@
+#ifndef __ZY_BUFFER_POOL_H__
+#define __ZY_BUFFER_POOL_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "utils/mutex.h"
+#include "utils/noncopyable.h"
+#include "utils/singleton.h"
+
+namespace zy {
+
+/**
+ * @brief 缓冲区块池
+ * @details 按 2 的幂分成若干大小类，每个大小类的块从 SLAB_SIZE 大小的 slab 中切出，归还后不交还给系统。
+ * 每个线程有一层缓存，借还都先走线程缓存，不加锁；线程缓存空了或者满了时，和中心空闲链表成批交换一半。
+ * 超过 MAX_SIZE 的请求直接使用 malloc/free。线程退出时缓存中的块交还中心空闲链表，
+ * 之后这个线程（例如其它 thread_local 对象的析构函数）的借还直接走中心空闲链表。
+ * 只有 BufferPoolMgr 这个实例使用线程缓存，其它实例每次都走中心空闲链表。
+ */
+class BufferPool : NonCopyable {
+public:
+    /// 最小的大小类
+    static const size_t MIN_SIZE = 256;
+    /// 最大的大小类
+    static const size_t MAX_SIZE = 64 * 1024;
+    /// 大小类的数量
+    static const int CLASS_NUM = 9;
+    /// 每次向系统申请的 slab 大小
+    static const size_t SLAB_SIZE = 256 * 1024;
+    /// 每个线程每个大小类最多缓存的字节数
+    static const size_t CACHE_BYTES = 256 * 1024;
+
+    /**
+     * @brief 统计
+     */
+    struct Stats {
+        /// 借出的次数
+        uint64_t allocs = 0;
+        /// 从线程缓存借出的次数
+        uint64_t thread_hits = 0;
+        /// 从中心空闲链表借出的次数
+        uint64_t central_hits = 0;
+        /// 借出但还没有归还的字节数，按大小类向上取整
+        uint64_t outstanding = 0;
+        /// 向系统申请的字节数，包括 slab 和超过 MAX_SIZE 的请求
+        uint64_t system = 0;
+
+        /**
+         * @brief 不需要向系统申请内存的借出比例
+         */
+        double hitRate() const { return allocs ? static_cast<double>(thread_hits + central_hits) / allocs : 0; }
+    };
+
+    /**
+     * @brief 线程缓存，只由所属线程读写，统计值供其它线程近似读取
+     */
+    struct ThreadCache;
+
+    BufferPool() = default;
+
+    /**
+     * @brief 析构函数，释放所有 slab，此时借出的块全部失效
+     */
+    ~BufferPool();
+
+    /**
+     * @brief 借出一个块
+     * @param size 需要的大小
+     * @return 至少 size 字节的块
+     */
+    void *allocate(size_t size);
+
+    /**
+     * @brief 归还一个块，可以在任意线程归还
+     * @param buffer allocate 返回的块
+     * @param size 借出时的 size
+     */
+    void deallocate(void *buffer, size_t size);
+
+    /**
+     * @brief 汇总所有线程的统计
+     */
+    Stats getStats();
+
+    /**
+     * @brief 大小类的下标，超过 MAX_SIZE 时返回 -1
+     */
+    static int SizeClass(size_t size);
+
+    /**
+     * @brief 大小类的块大小
+     */
+    static size_t ClassSize(int index) { return MIN_SIZE << index; }
+
+private:
+    /**
+     * @brief 当前线程的缓存，不属于这个实例时返回 nullptr
+     */
+    ThreadCache *getThreadCache();
+
+    /**
+     * @brief 从中心空闲链表取出最多 count 个块，不够时切一个新的 slab
+     * @return 是否从空闲链表取到了块，false 表示块来自新切的 slab
+     */
+    bool fetch(int index, size_t count, std::vector<void *> &out);
+
+    /**
+     * @brief 把 blocks 中最后 count 个块交还中心空闲链表
+     */
+    void release(int index, std::vector<void *> &blocks, size_t count);
+
+    /**
+     * @brief 线程退出时注销缓存，把块和统计交还给池
+     */
+    void unregister(ThreadCache *cache);
+
+    friend struct ThreadCache;
+
+private:
+    /// 每个大小类的中心空闲链表
+    struct Central {
+        Mutex mutex;
+        std::vector<void *> blocks;
+    };
+
+    Central centrals_[CLASS_NUM];
+    /// 保护 slabs_ 和 caches_
+    Mutex mutex_;
+    /// 向系统申请的 slab
+    std::vector<char *> slabs_;
+    /// 注册的线程缓存
+    std::vector<ThreadCache *> caches_;
+    /// 不经过线程缓存的借还和已退出线程的统计
+    std::atomic<uint64_t> allocs_{0};
+    std::atomic<uint64_t> thread_hits_{0};
+    std::atomic<uint64_t> central_hits_{0};
+    std::atomic<uint64_t> alloc_bytes_{0};
+    std::atomic<uint64_t> free_bytes_{0};
+    std::atomic<uint64_t> system_{0};
+};
+
+/// 缓冲区块池的单例，ByteArray 和连接层共用；不析构，持有 ByteArray 的静态对象在退出时仍可以归还块
+using BufferPoolMgr = ImmortalSingleton<BufferPool>;
+
+/**
+ * @brief 从 BufferPoolMgr 借出的一块连续缓冲区，析构时归还
+ */
+class PooledBuffer : NonCopyable {
+public:
+    /**
+     * @brief 构造函数
+     * @param size 缓冲区大小
+     */
+    explicit PooledBuffer(size_t size)
+        : data_(static_cast<char *>(BufferPoolMgr::GetInstance().allocate(size))), size_(size) {
+    }
+
+    ~PooledBuffer() { BufferPoolMgr::GetInstance().deallocate(data_, size_); }
+
+    char *data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+private:
+    char *data_;
+    size_t size_;
+};
+
+}
+
+#endif //__ZY_BUFFER_POOL_H__
@@ -1,12 +1,104 @@
 #include <stdexcept>
+#include <byteswap.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "byte_array.h"
+#include "buffer_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define ZY_HAVE_SSSE3_SWAP 1
+#endif
 
 namespace zy {
 
-    ByteArray::ByteArray(size_t size)
-        : data_(size)
-        , reader_index_(0), writer_index_(0)
-        , endian_(BIG_ENDIAN) {
+#ifdef ZY_HAVE_SSSE3_SWAP
+    /**
+     * @brief 用 pshufb 每次反转 16 字节中每个数值的字节序
+     * @return 处理的字节数，是 16 的倍数
+     */
+    __attribute__((target("ssse3")))
+    static size_t SwapBytesSSSE3(char *dst, const char *src, size_t bytes, size_t width) {
+        __m128i mask;
+        if (width == 2) {
+            mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        } else if (width == 4) {
+            mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        } else {
+            mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        }
+        size_t done = 0;
+        for (; done + 16 <= bytes; done += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done), _mm_shuffle_epi8(v, mask));
+        }
+        return done;
+    }
+
+    static bool HasSSSE3() {
+        static const bool has = []() {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3") != 0;
+        }();
+        return has;
+    }
+#endif
+
+    /**
+     * @brief 反转 count 个宽度为 width 的数值的字节序，dst 和 src 都可以不对齐
+     */
+    static void SwapBytes(char *dst, const char *src, size_t count, size_t width) {
+        size_t bytes = count * width;
+        size_t done = 0;
+        if (width == 1) {
+            memcpy(dst, src, bytes);
+            return;
+        }
+#ifdef ZY_HAVE_SSSE3_SWAP
+        if (HasSSSE3()) {
+            done = SwapBytesSSSE3(dst, src, bytes, width);
+        }
+#endif
+        for (; done < bytes; done += width) {
+            if (width == 2) {
+                uint16_t v;
+                memcpy(&v, src + done, 2);
+                v = bswap_16(v);
+                memcpy(dst + done, &v, 2);
+            } else if (width == 4) {
+                uint32_t v;
+                memcpy(&v, src + done, 4);
+                v = bswap_32(v);
+                memcpy(dst + done, &v, 4);
+            } else {
+                uint64_t v;
+                memcpy(&v, src + done, 8);
+                v = bswap_64(v);
+                memcpy(dst + done, &v, 8);
+            }
+        }
+    }
+
+    ByteArray::ByteArray(size_t block_size)
+        : block_size_(block_size)
+        , reader_index_(0), size_(0)
+        , endian_(BIG_ENDIAN)
+        , spill_threshold_(0), spill_fd_(-1), spill_end_(0)
+        , chunk_offset_(-1), chunk_used_(0), chunk_blocks_(0), spilled_blocks_(0) {
+        blocks_.push_back(allocateBlock());
+    }
+
+    ByteArray::~ByteArray() {
+        for (const Block &block : blocks_) {
+            freeBlock(block);
+        }
+        for (auto &it : chunks_) {
+            munmap(it.second.base, it.second.length);
+        }
+        if (spill_fd_ != -1) {
+            close(spill_fd_);
+        }
     }
 
     void ByteArray::writeDouble(double val) {
@@ -23,10 +115,12 @@ namespace zy {
 
     void ByteArray::write(const void *buf, size_t size) {
         ensureCapacity(size);
-        std::copy(static_cast<const char *>(buf),
-                  static_cast<const char *>(buf) + size,
-                  &*data_.begin() + writer_index_);
-        writer_index_ += size;
+        const char *src = static_cast<const char *>(buf);
+        forEachSegment(reader_index_ + size_, size, [&src](char *segment, size_t n) {
+            memcpy(segment, src, n);
+            src += n;
+        });
+        size_ += size;
     }
 
     double ByteArray::readDouble() {
@@ -44,35 +138,360 @@ namespace zy {
         return val;
     }
 
+    void ByteArray::writeUvarint(uint64_t val) {
+        uint8_t buf[10];
+        size_t n = 0;
+        while (val >= 0x80) {
+            buf[n++] = static_cast<uint8_t>(val | 0x80);
+            val >>= 7;
+        }
+        buf[n++] = static_cast<uint8_t>(val);
+        write(buf, n);
+    }
+
+    uint64_t ByteArray::readUvarint() {
+        uint64_t val = 0;
+        for (size_t i = 0; i < 10; ++i) {
+            if (i >= size_) {
+                throw std::out_of_range("not enough readable data");
+            }
+            size_t pos = reader_index_ + i;
+            uint8_t byte = static_cast<uint8_t>(pos < block_size_ ? blocks_.front().data[pos]
+                                                                  : blocks_[pos / block_size_].data[pos % block_size_]);
+            val |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+            if (!(byte & 0x80)) {
+                hasRead(i + 1);
+                return val;
+            }
+        }
+        throw std::overflow_error("varint is longer than 10 bytes");
+    }
+
+    void ByteArray::writeStringVarint(const std::string &val) {
+        writeUvarint(val.size());
+        write(val.data(), val.size());
+    }
+
+    std::string ByteArray::readStringVarint() {
+        uint64_t size = readUvarint();
+        if (size > getReadableSize()) {
+            throw std::out_of_range("not enough readable data");
+        }
+        std::string val;
+        val.resize(size);
+        read(&val[0], size);
+        return val;
+    }
+
+    void ByteArray::writeSwapped(const void *vals, size_t count, size_t width) {
+        if (endian_ == BYTE_ORDER || width == 1) {
+            write(vals, count * width);
+            return;
+        }
+        ensureCapacity(count * width);
+        const char *src = static_cast<const char *>(vals);
+        while (count > 0) {
+            size_t pos = reader_index_ + size_;
+            size_t offset = pos % block_size_;
+            size_t whole = (block_size_ - offset) / width;
+            if (whole == 0) {
+                // 数值跨越块的边界，先在栈上转换
+                char tmp[8];
+                SwapBytes(tmp, src, 1, width);
+                write(tmp, width);
+                src += width;
+                --count;
+                continue;
+            }
+            size_t n = std::min(whole, count);
+            SwapBytes(blocks_[pos / block_size_].data + offset, src, n, width);
+            size_ += n * width;
+            src += n * width;
+            count -= n;
+        }
+    }
+
+    void ByteArray::readSwapped(void *vals, size_t count, size_t width) {
+        if (count * width > getReadableSize()) {
+            throw std::out_of_range("not enough readable data");
+        }
+        if (endian_ == BYTE_ORDER || width == 1) {
+            read(vals, count * width);
+            return;
+        }
+        char *dst = static_cast<char *>(vals);
+        while (count > 0) {
+            size_t whole = (block_size_ - reader_index_) / width;
+            if (whole == 0) {
+                char tmp[8];
+                read(tmp, width);
+                SwapBytes(dst, tmp, 1, width);
+                dst += width;
+                --count;
+                continue;
+            }
+            size_t n = std::min(whole, count);
+            SwapBytes(dst, blocks_.front().data + reader_index_, n, width);
+            hasRead(n * width);
+            dst += n * width;
+            count -= n;
+        }
+    }
+
     void ByteArray::read(void *buf, size_t size, bool peeks) {
         if (size > getReadableSize()) {
             throw std::out_of_range("not enough readable data");
         }
-        std::copy(&*data_.begin() + reader_index_,
-                  &*data_.begin() + reader_index_ + size,
-                  static_cast<char *>(buf));
+        char *dst = static_cast<char *>(buf);
+        forEachSegment(reader_index_, size, [&dst](char *segment, size_t n) {
+            memcpy(dst, segment, n);
+            dst += n;
+        });
         if (!peeks) {
-            reader_index_ += size;
+            hasRead(size);
         }
     }
 
-    void ByteArray::ensureCapacity(size_t size) {
-        if (getWriteableSize() >= size) {
-            return;
+    StringView ByteArray::peek(size_t offset, size_t length, std::string &scratch) const {
+        if (offset > size_ || length > size_ - offset) {
+            throw std::out_of_range("not enough readable data");
+        }
+        if (length == 0) {
+            return StringView();
+        }
+        size_t pos = reader_index_ + offset;
+        if (pos % block_size_ + length <= block_size_) {
+            return StringView(blocks_[pos / block_size_].data + pos % block_size_, length);
         }
+        scratch.resize(length);
+        char *dst = &scratch[0];
+        forEachSegment(pos, length, [&dst](char *segment, size_t n) {
+            memcpy(dst, segment, n);
+            dst += n;
+        });
+        return StringView(scratch);
+    }
 
-        if (getWriteableSize() + getPrependSize() < size) {
-            // 可写区域加上已经读过失效的区域都不够，需要新开辟空间
-            // 开辟新空间时就不再考虑已经读过失效的区域
-            data_.resize(writer_index_ + size);
-        } else {
-            // 可写区域加上已经读过失效的区域够用，只需要将可读区域移动到最前面即可
-            size_t readable = getReadableSize();
-            std::copy(&*data_.begin() + reader_index_,
-                      &*data_.begin() + writer_index_,
-                      &*data_.begin());
+    size_t ByteArray::getReadViews(std::vector<StringView> &views, size_t length) const {
+        length = std::min(length, size_);
+        forEachSegment(reader_index_, length, [&views](char *segment, size_t n) {
+            views.emplace_back(segment, n);
+        });
+        return length;
+    }
+
+    char ByteArray::peekByte(size_t offset) const {
+        if (offset >= size_) {
+            throw std::out_of_range("not enough readable data");
+        }
+        size_t pos = reader_index_ + offset;
+        return blocks_[pos / block_size_].data[pos % block_size_];
+    }
+
+    size_t ByteArray::find(char c, size_t offset) const {
+        if (offset >= size_) {
+            return StringView::npos;
+        }
+        size_t found = StringView::npos;
+        size_t base = offset;
+        // 逐块 memchr，找到后剩下的块直接跳过
+        forEachSegment(reader_index_ + offset, size_ - offset, [&](char *segment, size_t n) {
+            if (found != StringView::npos) {
+                return;
+            }
+            const void *p = memchr(segment, c, n);
+            if (p) {
+                found = base + (static_cast<const char *>(p) - segment);
+            }
+            base += n;
+        });
+        return found;
+    }
+
+    size_t ByteArray::find(StringView str, size_t offset) const {
+        if (str.empty()) {
+            return offset <= size_ ? offset : StringView::npos;
+        }
+        while (offset < size_ && str.size() <= size_ - offset) {
+            offset = find(str[0], offset);
+            if (offset == StringView::npos || str.size() > size_ - offset) {
+                return StringView::npos;
+            }
+            // 首字节匹配后逐段比较剩下的字节
+            bool match = true;
+            const char *expect = str.data();
+            forEachSegment(reader_index_ + offset, str.size(), [&](char *segment, size_t n) {
+                if (match && memcmp(segment, expect, n) != 0) {
+                    match = false;
+                }
+                expect += n;
+            });
+            if (match) {
+                return offset;
+            }
+            ++offset;
+        }
+        return StringView::npos;
+    }
+
+    size_t ByteArray::getReadBuffers(std::vector<iovec> &buffers, size_t length) const {
+        length = std::min(length, size_);
+        forEachSegment(reader_index_, length, [&buffers](char *segment, size_t n) {
+            buffers.push_back({segment, n});
+        });
+        return length;
+    }
+
+    size_t ByteArray::getWriteBuffers(std::vector<iovec> &buffers, size_t length) {
+        ensureCapacity(length);
+        forEachSegment(reader_index_ + size_, length, [&buffers](char *segment, size_t n) {
+            buffers.push_back({segment, n});
+        });
+        return length;
+    }
+
+    void ByteArray::hasRead(size_t size) {
+        if (size > size_) {
+            throw std::out_of_range("not enough readable data");
+        }
+        size_ -= size;
+        reader_index_ += size;
+        // 读完的块摘下来，末尾没有空闲块时把内存块留作之后写入，否则释放
+        while (reader_index_ >= block_size_) {
+            Block block = blocks_.front();
+            blocks_.pop_front();
+            reader_index_ -= block_size_;
+            if (block.offset < 0 && getWriteableSize() < block_size_) {
+                blocks_.push_back(block);
+            } else {
+                freeBlock(block);
+            }
+        }
+        if (size_ == 0) {
             reader_index_ = 0;
-            writer_index_ = readable;
         }
     }
-}
\ No newline at end of file
+
+    void ByteArray::hasWritten(size_t size) {
+        if (size > getWriteableSize()) {
+            throw std::out_of_range("not enough writeable space");
+        }
+        size_ += size;
+    }
+
+    void ByteArray::clear() {
+        for (const Block &block : blocks_) {
+            freeBlock(block);
+        }
+        blocks_.clear();
+        reader_index_ = 0;
+        size_ = 0;
+        blocks_.push_back(allocateBlock());
+    }
+
+    bool ByteArray::setSpill(size_t threshold, const std::string &dir) {
+        spill_threshold_ = threshold;
+        if (spill_fd_ != -1) {
+            return true;
+        }
+        int fd = open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (fd == -1) {
+            // 文件系统不支持 O_TMPFILE 时退回 mkstemp，创建后立即删除
+            std::string path = dir + "/zy_spill_XXXXXX";
+            fd = mkostemp(&path[0], O_CLOEXEC);
+            if (fd == -1) {
+                return false;
+            }
+            unlink(path.c_str());
+        }
+        spill_fd_ = fd;
+        chunk_blocks_ = std::max<size_t>(1, SPILL_CHUNK_SIZE / block_size_);
+        return true;
+    }
+
+    bool ByteArray::getFileSegment(int &fd, off_t &offset, size_t &length) const {
+        if (size_ == 0 || blocks_.front().offset < 0) {
+            return false;
+        }
+        fd = spill_fd_;
+        offset = blocks_.front().offset + reader_index_;
+        length = std::min(size_, block_size_ - reader_index_);
+        // 同一段映射中的块在文件中是连续的，跨映射时也可能连续
+        for (size_t i = 1; i < blocks_.size() && length < size_; ++i) {
+            if (blocks_[i].offset != blocks_[i - 1].offset + static_cast<off_t>(block_size_)) {
+                break;
+            }
+            length += std::min(block_size_, size_ - length);
+        }
+        return true;
+    }
+
+    ByteArray::Block ByteArray::allocateBlock() {
+        if (spill_fd_ != -1 && blocks_.size() * block_size_ >= spill_threshold_) {
+            Block block = allocateSpillBlock();
+            if (block.data) {
+                return block;
+            }
+        }
+        return {static_cast<char *>(BufferPoolMgr::GetInstance().allocate(block_size_)), -1};
+    }
+
+    ByteArray::Block ByteArray::allocateSpillBlock() {
+        auto current = chunks_.find(chunk_offset_);
+        if (current == chunks_.end() || chunk_used_ == chunk_blocks_) {
+            // 映射的偏移必须按页对齐
+            static const size_t page_size = sysconf(_SC_PAGESIZE);
+            size_t length = chunk_blocks_ * block_size_;
+            off_t offset = spill_end_;
+            if (ftruncate(spill_fd_, offset + length) == -1) {
+                return {nullptr, -1};
+            }
+            void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, spill_fd_, offset);
+            if (base == MAP_FAILED) {
+                return {nullptr, -1};
+            }
+            if (current != chunks_.end()) {
+                // 上一段已经切完，数据写入后由内核回写，不再占用本进程的常驻内存
+                madvise(current->second.base, current->second.length, MADV_DONTNEED);
+                if (current->second.live == 0) {
+                    munmap(current->second.base, current->second.length);
+                    chunks_.erase(current);
+                }
+            }
+            spill_end_ += (length + page_size - 1) / page_size * page_size;
+            chunk_offset_ = offset;
+            chunk_used_ = 0;
+            current = chunks_.insert({offset, {static_cast<char *>(base), length, 0}}).first;
+        }
+        size_t index = chunk_used_++;
+        ++current->second.live;
+        ++spilled_blocks_;
+        return {current->second.base + index * block_size_, chunk_offset_ + static_cast<off_t>(index * block_size_)};
+    }
+
+    void ByteArray::freeBlock(const Block &block) {
+        if (block.offset < 0) {
+            BufferPoolMgr::GetInstance().deallocate(block.data, block_size_);
+            return;
+        }
+        --spilled_blocks_;
+        auto it = --chunks_.upper_bound(block.offset);
+        if (--it->second.live > 0 || (it->first == chunk_offset_ && chunk_used_ < chunk_blocks_)) {
+            return;
+        }
+        // 整段都读完了，解除映射并在文件中打洞，磁盘空间随读取归还
+        munmap(it->second.base, it->second.length);
+        fallocate(spill_fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, it->first, it->second.length);
+        if (it->first == chunk_offset_) {
+            chunk_offset_ = -1;
+        }
+        chunks_.erase(it);
+    }
+
+    void ByteArray::ensureCapacity(size_t size) {
+        // 只追加新块，已有的数据不移动
+        while (getWriteableSize() < size) {
+            blocks_.push_back(allocateBlock());
+        }
+    }
+}
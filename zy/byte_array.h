@@ -1,25 +1,50 @@
 #ifndef __ZY_BYTE_ARRAY_H__
 #define __ZY_BYTE_ARRAY_H__
 
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
+#include <deque>
+#include <map>
 #include <cstring>
 #include <endian.h>
+#include <sys/uio.h>
 #include "utils/endian.h"
+#include "utils/noncopyable.h"
+#include "utils/string_view.h"
 
 namespace zy {
     /**
      * @brief 字节数组
+     * @details 数据存放在若干固定大小的块中，块首尾相接组成一条链：
+     * 写入时在末尾追加新块，已有的数据从不移动；读完的块从头部摘下，最多留一个空闲块给之后的写入复用。
+     * 块从 BufferPoolMgr 借出，释放时归还，不经过 malloc/free。
+     * 调用 setSpill 后，超过阈值的块改为映射到一个临时文件上，数据量再大常驻内存也不增长，
+     * 文件中的数据可以用 sendfile 直接发送，不经过用户态。
+     * getReadBuffers/getWriteBuffers 直接给出指向块内存的 iovec，配合 Socket::send(iovec*)/recv(iovec*)
+     * 或 readv/writev 收发，不经过中间缓冲区。
      */
-    class ByteArray {
+    class ByteArray : NonCopyable {
     public:
         using ptr = std::shared_ptr<ByteArray>;
 
+        /// 默认的块大小
+        static const size_t BLOCK_SIZE = 4096;
+        /// 溢出文件每次扩展和映射的大小
+        static const size_t SPILL_CHUNK_SIZE = 1024 * 1024;
+
         /**
          * @brief 构造函数
-         * @param size 初始字节数组大小
+         * @param block_size 每个块的大小
+         */
+        explicit ByteArray(size_t block_size = BLOCK_SIZE);
+
+        /**
+         * @brief 析构函数，释放所有块
          */
-        explicit ByteArray(size_t size = 4096);
+        ~ByteArray();
 
         /**
          * @brief 向数组中写入整数
@@ -74,6 +99,90 @@ namespace zy {
          */
         double readDouble();
 
+        // region # Varint
+        /**
+         * @brief 以变长编码写入整数，每字节 7 位，低位在前，最高位表示后面还有字节
+         * @details 有符号整数先做 zigzag 编码，绝对值小的负数也只占很少的字节
+         * @tparam T 整数类型
+         * @param val 整数值
+         */
+        template<typename T>
+        void writeVarint(T val) {
+            static_assert(std::is_integral<T>::value, "writeVarint requires an integer type");
+            writeUvarint(std::is_signed<T>::value ? EncodeZigzag(static_cast<int64_t>(val))
+                                                  : static_cast<uint64_t>(val));
+        }
+
+        /**
+         * @brief 读取变长编码的整数
+         * @tparam T 整数类型，需要和写入时的符号性一致
+         * @return 整数值
+         */
+        template<typename T>
+        T readVarint() {
+            static_assert(std::is_integral<T>::value, "readVarint requires an integer type");
+            uint64_t val = readUvarint();
+            return std::is_signed<T>::value ? static_cast<T>(DecodeZigzag(val)) : static_cast<T>(val);
+        }
+
+        /**
+         * @brief 写入无符号的变长编码整数，最多 10 字节
+         */
+        void writeUvarint(uint64_t val);
+
+        /**
+         * @brief 读取无符号的变长编码整数
+         * @throw std::out_of_range 数据不完整
+         * @throw std::overflow_error 编码超过 10 字节
+         */
+        uint64_t readUvarint();
+
+        /**
+         * @brief 写入字符串，长度前缀使用变长编码
+         */
+        void writeStringVarint(const std::string &val);
+
+        /**
+         * @brief 读取 writeStringVarint 写入的字符串
+         */
+        std::string readStringVarint();
+
+        static uint64_t EncodeZigzag(int64_t val) {
+            return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+        }
+
+        static int64_t DecodeZigzag(uint64_t val) {
+            return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+        }
+        // endregion
+
+        // region # Array
+        /**
+         * @brief 批量写入定长的数值，按数组的字节序整体转换，支持 SSSE3 时每次转换 16 字节
+         * @tparam T 整数或浮点数类型
+         * @param vals 数值
+         * @param count 数值个数
+         */
+        template<typename T>
+        void writeArray(const T *vals, size_t count) {
+            static_assert(std::is_arithmetic<T>::value && sizeof(T) <= 8, "writeArray requires an arithmetic type");
+            writeSwapped(vals, count, sizeof(T));
+        }
+
+        /**
+         * @brief 批量读取定长的数值
+         * @tparam T 整数或浮点数类型
+         * @param vals 输出的数值
+         * @param count 数值个数
+         * @throw std::out_of_range 可读数据不足
+         */
+        template<typename T>
+        void readArray(T *vals, size_t count) {
+            static_assert(std::is_arithmetic<T>::value && sizeof(T) <= 8, "readArray requires an arithmetic type");
+            readSwapped(vals, count, sizeof(T));
+        }
+        // endregion
+
         /**
          * @brief 从数组中读取字符串
          * @return 字符串
@@ -88,40 +197,229 @@ namespace zy {
          */
         void read(void *buf, size_t size, bool peeks = false);
 
+        // region # View
+        /**
+         * @brief 可读区域中 [offset, offset + length) 的只读视图，不消耗数据
+         * @param offset 相对可读区域开头的偏移
+         * @param length 长度
+         * @param scratch 数据跨越块时拷贝到这里，视图指向 scratch；不跨越时视图直接指向块内存
+         * @throw std::out_of_range 可读数据不足
+         * @note 指向块内存的视图在下一次 read/hasRead/clear 之前有效，写入只追加块，不影响已有的视图
+         */
+        StringView peek(size_t offset, size_t length, std::string &scratch) const;
+
+        /**
+         * @brief 获取可读区域的只读视图，每个块一段，不消耗数据，有效期同 peek
+         * @param views 追加到末尾的视图
+         * @param length 最多覆盖的字节数
+         * @return 覆盖的字节数
+         */
+        size_t getReadViews(std::vector<StringView> &views, size_t length = static_cast<size_t>(-1)) const;
+
+        /**
+         * @brief 可读区域中偏移为 offset 的字节
+         * @throw std::out_of_range 超出可读区域
+         */
+        char peekByte(size_t offset) const;
+
+        /**
+         * @brief 在可读区域中查找字符
+         * @param c 字符
+         * @param offset 开始查找的偏移
+         * @return 相对可读区域开头的偏移，找不到时返回 StringView::npos
+         */
+        size_t find(char c, size_t offset = 0) const;
+
+        /**
+         * @brief 在可读区域中查找字节串，可以跨越块的边界
+         * @param str 字节串
+         * @param offset 开始查找的偏移
+         * @return 相对可读区域开头的偏移，找不到时返回 StringView::npos
+         */
+        size_t find(StringView str, size_t offset = 0) const;
+        // endregion
+
+        // region # Scatter/Gather
+        /**
+         * @brief 获取可读区域的 iovec，用于发送
+         * @param buffers 追加到末尾的 iovec，每个块一个
+         * @param length 最多覆盖的字节数
+         * @return 覆盖的字节数
+         * @note iovec 指向块内存，在 hasRead 或下一次写入之前有效
+         */
+        size_t getReadBuffers(std::vector<iovec> &buffers, size_t length = static_cast<size_t>(-1)) const;
+
+        /**
+         * @brief 获取可写区域的 iovec，用于接收，可写区域不足 length 时先追加新块
+         * @param buffers 追加到末尾的 iovec，每个块一个
+         * @param length 覆盖的字节数
+         * @return 覆盖的字节数，等于 length
+         * @note 接收完成后调用 hasWritten 提交实际写入的字节数
+         */
+        size_t getWriteBuffers(std::vector<iovec> &buffers, size_t length);
+
+        /**
+         * @brief 丢弃可读区域开头的 size 字节，读完的块被释放
+         */
+        void hasRead(size_t size);
+
+        /**
+         * @brief 提交通过 getWriteBuffers 写入的 size 字节
+         */
+        void hasWritten(size_t size);
+        // endregion
+
         /**
-         * @brief 已经读取过，失效的区域大小
+         * @brief 清空数据，保留一个块
+         */
+        void clear();
+
+        // region # Spill
+        /**
+         * @brief 开启溢出到文件，块的总大小达到 threshold 之后新增的块映射到临时文件上
+         * @details 临时文件创建后立即从目录中删除（O_TMPFILE 或 mkstemp + unlink），随数组一起释放。
+         * 写满的文件区域会解除常驻（MADV_DONTNEED），数据留在页缓存中由内核回写；读完的区域解除映射并打洞归还磁盘空间。
+         * @param threshold 内存中最多保留的字节数
+         * @param dir 临时文件所在的目录
+         * @return 临时文件是否创建成功，失败时继续只使用内存
+         */
+        bool setSpill(size_t threshold, const std::string &dir = "/tmp");
+
+        /**
+         * @brief 可读区域开头连续位于溢出文件中的部分，用于 sendfile
+         * @param fd 输出溢出文件的 fd
+         * @param offset 输出在文件中的偏移
+         * @param length 输出长度
+         * @return 可读区域的开头是否在文件中
+         */
+        bool getFileSegment(int &fd, off_t &offset, size_t &length) const;
+
+        /**
+         * @brief 映射到溢出文件上的块的总大小
+         */
+        size_t getSpilledSize() const { return spilled_blocks_ * block_size_; }
+        // endregion
+
+        /**
+         * @brief 可读区域大小
          * @return 区域大小
          */
-        size_t getReadableSize() const { return writer_index_ - reader_index_; }
+        size_t getReadableSize() const { return size_; }
 
         /**
-         * @brief 可写区域大小
+         * @brief 已经分配但还没有写入的区域大小
          * @return 区域大小
          */
-        size_t getWriteableSize() const { return data_.size() - writer_index_; }
+        size_t getWriteableSize() const { return blocks_.size() * block_size_ - reader_index_ - size_; }
 
         /**
-         * @brief 可读区域大小
+         * @brief 第一个块中已经读取过，失效的区域大小
          * @return 区域大小
          */
         size_t getPrependSize() const { return reader_index_; }
 
+        size_t getBlockSize() const { return block_size_; }
+
+        size_t getBlockCount() const { return blocks_.size(); }
+
     private:
         /**
-         * @brief 确保可写区域足够
+         * @brief 数据块
+         */
+        struct Block {
+            /// 块内存
+            char *data;
+            /// 在溢出文件中的偏移，-1 表示块来自缓冲区块池
+            off_t offset;
+        };
+
+        /**
+         * @brief 溢出文件中一段映射
+         */
+        struct SpillChunk {
+            /// 映射的地址
+            char *base;
+            /// 映射的长度
+            size_t length;
+            /// 还没有释放的块数
+            size_t live;
+        };
+
+        /**
+         * @brief 确保可写区域足够，不够时在末尾追加块
          * @param size 需要的可写区域大小
          */
         void ensureCapacity(size_t size);
 
+        /**
+         * @brief 写入 count 个宽度为 width 的数值，字节序和数组不同时逐个反转字节
+         */
+        void writeSwapped(const void *vals, size_t count, size_t width);
+
+        /**
+         * @brief 读出 count 个宽度为 width 的数值，字节序和数组不同时逐个反转字节
+         */
+        void readSwapped(void *vals, size_t count, size_t width);
+
+        /**
+         * @brief 分配一个块，超过溢出阈值时从溢出文件中分配，否则从缓冲区块池借出
+         */
+        Block allocateBlock();
+
+        /**
+         * @brief 从溢出文件中切出一个块，当前映射用完时扩展文件并映射下一段
+         * @return 块，失败时 data 为 nullptr
+         */
+        Block allocateSpillBlock();
+
+        /**
+         * @brief 释放块，归还给缓冲区块池，或者在所在映射的块全部释放后解除映射
+         */
+        void freeBlock(const Block &block);
+
+        /**
+         * @brief 对 [offset, offset + size) 覆盖的每一段块内存调用 func，offset 从第一个块的开头算起
+         */
+        template<typename Func>
+        void forEachSegment(size_t offset, size_t size, Func func) const {
+            size_t index = offset / block_size_;
+            size_t pos = offset % block_size_;
+            while (size > 0) {
+                size_t n = std::min(size, block_size_ - pos);
+                func(blocks_[index].data + pos, n);
+                size -= n;
+                pos = 0;
+                ++index;
+            }
+        }
+
     private:
-        /// 数据指针
-        std::vector<char> data_;
-        /// 读数据的位置
+        /// 块大小
+        size_t block_size_;
+        /// 数据块
+        std::deque<Block> blocks_;
+        /// 第一个块中读数据的位置
         size_t reader_index_;
-        /// 写数据的位置
-        size_t writer_index_;
+        /// 可读数据的长度
+        size_t size_;
         /// 字节序，默认大端
         uint16_t endian_;
+        /// 溢出阈值
+        size_t spill_threshold_;
+        /// 溢出文件，-1 表示没有开启
+        int spill_fd_;
+        /// 溢出文件下一段映射的偏移
+        off_t spill_end_;
+        /// 当前切分的映射的偏移
+        off_t chunk_offset_;
+        /// 当前映射中已经切出的块数
+        size_t chunk_used_;
+        /// 每段映射的块数
+        size_t chunk_blocks_;
+        /// 按文件偏移索引的映射
+        std::map<off_t, SpillChunk> chunks_;
+        /// 映射到溢出文件上的块数
+        size_t spilled_blocks_;
     };
 
     // TODO 数据压缩存储
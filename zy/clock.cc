@@ -0,0 +1,121 @@
+#include "clock.h"
+
+#include <ctime>
+#include <atomic>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace zy {
+
+// 当前使用的时钟源
+static std::atomic<int> s_source{Clock::MONOTONIC};
+// 当前线程缓存的循环时间，微秒，0 表示当前线程没有事件循环
+static thread_local uint64_t t_loop_now_us = 0;
+
+static uint64_t clockNs(clockid_t id) {
+    struct timespec ts{};
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief TSC 校准参数，ns = base_ns + (tsc - base_tsc) * mult >> 32
+ */
+struct TscCalibration {
+    uint64_t base_tsc = 0;
+    uint64_t base_ns = 0;
+    uint64_t mult = 0;
+};
+
+static TscCalibration s_tsc;
+
+/**
+ * @brief 校准 TSC，只需要做一次
+ * @return TSC 是否可用
+ */
+static bool calibrateTsc() {
+    static const bool s_available = []() {
+        // CPUID.80000007H:EDX[8]，TSC 频率恒定且在深度睡眠时不停止
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) {
+            return false;
+        }
+        // 忙等 10ms，用 CLOCK_MONOTONIC 的差值换算 TSC 频率
+        uint64_t ns0 = clockNs(CLOCK_MONOTONIC);
+        uint64_t tsc0 = __rdtsc();
+        uint64_t ns1 = ns0;
+        while (ns1 - ns0 < 10 * 1000 * 1000) {
+            ns1 = clockNs(CLOCK_MONOTONIC);
+        }
+        uint64_t tsc1 = __rdtsc();
+        if (tsc1 <= tsc0) {
+            return false;
+        }
+        s_tsc.mult = ((ns1 - ns0) << 32) / (tsc1 - tsc0);
+        s_tsc.base_tsc = tsc1;
+        s_tsc.base_ns = ns1;
+        return s_tsc.mult != 0;
+    }();
+    return s_available;
+}
+
+static uint64_t tscNs() {
+    uint64_t delta = __rdtsc() - s_tsc.base_tsc;
+    return s_tsc.base_ns + static_cast<uint64_t>((static_cast<unsigned __int128>(delta) * s_tsc.mult) >> 32);
+}
+#endif
+
+bool Clock::SetSource(Source source) {
+    if (source == TSC) {
+#if defined(__x86_64__)
+        if (!calibrateTsc()) {
+            return false;
+        }
+#else
+        return false;
+#endif
+    }
+    s_source.store(source, std::memory_order_release);
+    return true;
+}
+
+Clock::Source Clock::GetSource() {
+    return static_cast<Source>(s_source.load(std::memory_order_relaxed));
+}
+
+uint64_t Clock::NowNs() {
+    switch (s_source.load(std::memory_order_acquire)) {
+        case MONOTONIC_COARSE:
+            return clockNs(CLOCK_MONOTONIC_COARSE);
+#if defined(__x86_64__)
+        case TSC:
+            return tscNs();
+#endif
+        default:
+            return clockNs(CLOCK_MONOTONIC);
+    }
+}
+
+uint64_t Clock::CoarseMs() {
+    return clockNs(CLOCK_MONOTONIC_COARSE) / 1000000;
+}
+
+uint64_t Clock::WallSeconds() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+uint64_t Clock::LoopNowUs() {
+    return t_loop_now_us ? t_loop_now_us : NowUs();
+}
+
+uint64_t Clock::UpdateLoopTime() {
+    t_loop_now_us = NowUs();
+    return t_loop_now_us / 1000;
+}
+
+}
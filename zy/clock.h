@@ -0,0 +1,87 @@
+#ifndef __ZY_CLOCK_H__
+#define __ZY_CLOCK_H__
+
+#include <cstdint>
+
+namespace zy {
+
+/**
+ * @brief 时钟
+ * @details 定时器使用单调时钟，不受 NTP 调整墙上时间的影响；日志时间戳使用粗粒度的墙上时间。
+ * 每个事件循环线程维护一个缓存的“循环时间”，在 Reactor::idle 的每一轮开始和 epoll_wait 返回时刷新，
+ * 缓存时间可以落后于真实时间一轮循环中任务的执行时间，只能用在允许这点误差的地方，例如时间轮的推进和到期判断。
+ * 新的定时器执行时间（睡眠、I/O 超时等截止时间）必须以 NowUs() 为基准，否则会提前触发。
+ */
+class Clock {
+public:
+    /**
+     * @brief 时钟源
+     */
+    enum Source {
+        /// CLOCK_MONOTONIC，精确到纳秒
+        MONOTONIC,
+        /// CLOCK_MONOTONIC_COARSE，精度为一个内核 tick（通常 1~4ms），读取代价最低
+        MONOTONIC_COARSE,
+        /// rdtsc，启动时根据 CLOCK_MONOTONIC 校准，只在 x86 且 TSC 恒定时可用
+        TSC,
+    };
+
+    /**
+     * @brief 设置 NowNs/NowUs/NowMs 使用的时钟源
+     * @param source 时钟源
+     * @return 操作是否成功，TSC 不可用时返回 false 并保持原来的时钟源
+     */
+    static bool SetSource(Source source);
+
+    /**
+     * @brief 获取当前时钟源
+     */
+    static Source GetSource();
+
+    /**
+     * @brief 单调时间，纳秒
+     */
+    static uint64_t NowNs();
+
+    /**
+     * @brief 单调时间，微秒
+     */
+    static uint64_t NowUs() { return NowNs() / 1000; }
+
+    /**
+     * @brief 单调时间，毫秒
+     */
+    static uint64_t NowMs() { return NowNs() / 1000000; }
+
+    /**
+     * @brief 粗粒度的单调时间，毫秒，始终使用 CLOCK_MONOTONIC_COARSE
+     */
+    static uint64_t CoarseMs();
+
+    /**
+     * @brief 粗粒度的墙上时间，秒，用于日志时间戳
+     */
+    static uint64_t WallSeconds();
+
+    /**
+     * @brief 获取当前线程缓存的循环时间，毫秒
+     * @details 当前线程没有事件循环（从未调用过 UpdateLoopTime）时返回 NowMs()。
+     * 缓存时间最多落后于真实时间一轮循环中任务的执行时间，不能作为新定时器执行时间的基准。
+     */
+    static uint64_t LoopNowMs() { return LoopNowUs() / 1000; }
+
+    /**
+     * @brief 获取当前线程缓存的循环时间，微秒
+     */
+    static uint64_t LoopNowUs();
+
+    /**
+     * @brief 刷新当前线程缓存的循环时间
+     * @return 刷新后的循环时间，毫秒
+     */
+    static uint64_t UpdateLoopTime();
+};
+
+}
+
+#endif //__ZY_CLOCK_H__
@@ -1,7 +1,17 @@
 
+#include <climits>
+#include <netinet/tcp.h>
 #include "connection.h"
+#include "reactor.h"
 
 namespace zy {
+    /**
+     * @brief 一次收发最多的字节数，iovec 的个数不能超过 IOV_MAX，第一个块可能只用到一部分
+     */
+    static size_t MaxIOLength(const ByteArray::ptr &byte_array) {
+        return (IOV_MAX - 1) * byte_array->getBlockSize();
+    }
+
     size_t Connection::read(void *buffer, size_t length) {
         if (!isConnected()) {
             return -1;
@@ -13,11 +23,13 @@ namespace zy {
         if (!isConnected()) {
             return -1;
         }
-        std::string buffer;
-        buffer.resize(length);
-        size_t len = socket_->recv(&buffer[0], buffer.size());
-        buffer.resize(len);
-        byte_array->write(buffer.data(), len);
+        read_iovs_.clear();
+        length = std::min(length, MaxIOLength(byte_array));
+        byte_array->getWriteBuffers(read_iovs_, length);
+        size_t len = socket_->recv(read_iovs_.data(), read_iovs_.size());
+        if (len != static_cast<size_t>(-1)) {
+            byte_array->hasWritten(len);
+        }
         return len;
     }
 
@@ -25,7 +37,7 @@ namespace zy {
         size_t offset = 0;
         while (length > 0) {
             size_t len = read(static_cast<char *>(buffer) + offset, length);
-            if (len <= 0) {
+            if (len == 0 || len == static_cast<size_t>(-1)) {
                 break;
             }
             offset += len;
@@ -38,7 +50,7 @@ namespace zy {
         size_t offset = 0;
         while (length > 0) {
             size_t len = read(byte_array, length);
-            if (len <= 0) {
+            if (len == 0 || len == static_cast<size_t>(-1)) {
                 break;
             }
             offset += len;
@@ -58,10 +70,22 @@ namespace zy {
         if (!isConnected()) {
             return -1;
         }
-        std::string buffer;
-        buffer.resize(length);
-        byte_array->read(&buffer[0], length);
-        size_t len = socket_->send(buffer.data(), buffer.size());
+        size_t len;
+        int fd;
+        off_t offset;
+        size_t file_length;
+        if (byte_array->getFileSegment(fd, offset, file_length)) {
+            // 开头溢出到文件中的部分直接从页缓存发送，不映射到用户态
+            len = socket_->sendFile(fd, offset, std::min(length, file_length));
+        } else {
+            write_iovs_.clear();
+            length = std::min(length, MaxIOLength(byte_array));
+            byte_array->getReadBuffers(write_iovs_, length);
+            len = socket_->send(write_iovs_.data(), write_iovs_.size());
+        }
+        if (len != static_cast<size_t>(-1)) {
+            byte_array->hasRead(len);
+        }
         return len;
     }
 
@@ -69,7 +93,7 @@ namespace zy {
         size_t offset = 0;
         while (length > 0) {
             size_t len = write(static_cast<const char *>(buffer) + offset, length);
-            if (len <= 0) {
+            if (len == 0 || len == static_cast<size_t>(-1)) {
                 break;
             }
             offset +=len;
@@ -82,7 +106,7 @@ namespace zy {
         size_t offset = 0;
         while (length > 0) {
             size_t len = write(byte_array, length);
-            if (len <= 0) {
+            if (len == 0 || len == static_cast<size_t>(-1)) {
                 break;
             }
             offset +=len;
@@ -90,4 +114,131 @@ namespace zy {
         }
         return offset;
     }
+
+    void Connection::setOutputBuffer(size_t threshold, uint64_t delay_us) {
+        Mutex::Lock lock(output_mutex_);
+        threshold_ = threshold;
+        delay_us_ = delay_us;
+        if (!output_) {
+            output_ = std::make_shared<ByteArray>();
+            sending_ = std::make_shared<ByteArray>();
+        }
+    }
+
+    size_t Connection::writeBuffered(const void *buffer, size_t length) {
+        iovec iov = {const_cast<void *>(buffer), length};
+        return writeBuffered(&iov, 1);
+    }
+
+    size_t Connection::writeBuffered(const iovec *buffers, size_t count) {
+        if (!isConnected()) {
+            return -1;
+        }
+        size_t length = 0;
+        for (size_t i = 0; i < count; ++i) {
+            length += buffers[i].iov_len;
+        }
+        bool flush_now = false;
+        bool schedule = false;
+        {
+            Mutex::Lock lock(output_mutex_);
+            if (!output_) {
+                lock.unlock();
+                if (count == 1) {
+                    return writeFixSize(buffers[0].iov_base, length);
+                }
+                // 多段数据先拼到字节数组中，一次性发送
+                ByteArray::ptr byte_array = std::make_shared<ByteArray>();
+                for (size_t i = 0; i < count; ++i) {
+                    byte_array->write(buffers[i].iov_base, buffers[i].iov_len);
+                }
+                return writeFixSize(byte_array, length);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                output_->write(buffers[i].iov_base, buffers[i].iov_len);
+            }
+            buffered_writes_.fetch_add(1, std::memory_order_relaxed);
+            if (output_->getReadableSize() >= threshold_) {
+                flush_now = true;
+            } else if (!flush_scheduled_) {
+                flush_scheduled_ = true;
+                schedule = true;
+            }
+        }
+        if (flush_now) {
+            flush();
+        } else if (schedule) {
+            scheduleFlush();
+        }
+        return length;
+    }
+
+    void Connection::scheduleFlush() {
+        Reactor *reactor = Reactor::GetThis();
+        if (!reactor) {
+            flush();
+            return;
+        }
+        Connection::ptr self = shared_from_this();
+        if (delay_us_ == 0) {
+            reactor->addTask([self]() { self->flush(); });
+        } else {
+            reactor->addTimerUs(delay_us_, [self]() { self->flush(); });
+        }
+    }
+
+    bool Connection::flush() {
+        {
+            Mutex::Lock lock(output_mutex_);
+            flush_scheduled_ = false;
+            if (!output_ || flushing_ || output_->getReadableSize() == 0) {
+                return true;
+            }
+            flushing_ = true;
+        }
+
+        int on = 1;
+        if (cork_) {
+            socket_->setOption(IPPROTO_TCP, TCP_CORK, on);
+        }
+        bool ok = true;
+        while (true) {
+            {
+                Mutex::Lock lock(output_mutex_);
+                if (!ok) {
+                    output_->clear();
+                }
+                if (!ok || output_->getReadableSize() == 0) {
+                    flushing_ = false;
+                    break;
+                }
+                // 交换后写入方继续往新的 output_ 中写，发送不持有锁
+                std::swap(output_, sending_);
+            }
+            while (sending_->getReadableSize() > 0) {
+                flush_iovs_.clear();
+                size_t length = sending_->getReadBuffers(flush_iovs_, MaxIOLength(sending_));
+                // 这次刷新后面还有数据时，让内核等凑满一个包再发；对端关闭时返回 EPIPE 而不是触发 SIGPIPE
+                int flags = MSG_NOSIGNAL | (length < sending_->getReadableSize() ? MSG_MORE : 0);
+                size_t len = socket_->send(flush_iovs_.data(), flush_iovs_.size(), flags);
+                flush_syscalls_.fetch_add(1, std::memory_order_relaxed);
+                if (len == 0 || len == static_cast<size_t>(-1)) {
+                    sending_->clear();
+                    ok = false;
+                    break;
+                }
+                sending_->hasRead(len);
+            }
+        }
+        if (cork_) {
+            on = 0;
+            socket_->setOption(IPPROTO_TCP, TCP_CORK, on);
+        }
+        return ok;
+    }
+
+    size_t Connection::getBufferedSize() {
+        Mutex::Lock lock(output_mutex_);
+        return output_ ? output_->getReadableSize() : 0;
+    }
 }
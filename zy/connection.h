@@ -2,22 +2,29 @@
 #define __ZY_CONNECTION_H__
 
 
+#include <atomic>
 #include "socket.h"
 #include "byte_array.h"
+#include "utils/mutex.h"
 #include "utils/noncopyable.h"
 
 namespace zy {
 
 //封装二进制文件读写
-class Connection {
+class Connection : public std::enable_shared_from_this<Connection> {
 public:
     using ptr = std::shared_ptr<Connection>;
 
+    /// 默认的输出缓冲刷新阈值
+    static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
     /**
      * @brief 构造函数
      * @param socket socket 连接
      */
-    explicit Connection(Socket::ptr socket) : socket_(std::move(socket)) { }
+    explicit Connection(Socket::ptr socket)
+        : socket_(std::move(socket)), threshold_(FLUSH_THRESHOLD), delay_us_(0), cork_(false)
+        , flush_scheduled_(false), flushing_(false), buffered_writes_(0), flush_syscalls_(0) { }
 
     /**
      * @brief 析构函数
@@ -33,9 +40,9 @@ public:
     virtual size_t read(void *buffer, size_t length);
 
     /**
-     * @brief 从 socket 读取数据到字节数组
+     * @brief 从 socket 读取数据到字节数组，直接接收到字节数组的块中
      * @param byte_array 字节数组
-     * @param length 字节数组大小
+     * @param length 最多读取的字节数
      * @return 读取字节数
      */
     virtual size_t read(ByteArray::ptr byte_array, size_t length);
@@ -65,9 +72,10 @@ public:
     virtual size_t write(const void *buffer, size_t length);
 
     /**
-     * @brief 将字节数组数据写入到 socket
+     * @brief 将字节数组数据写入到 socket，直接从字节数组的块中发送，只消耗发送成功的部分；
+     * 开头的数据溢出到文件中时用 sendfile 发送
      * @param byte_array 字节数组
-     * @param length 字节数组大小
+     * @param length 最多发送的字节数
      * @return 发送字节数
      */
     virtual size_t write(ByteArray::ptr byte_array, size_t length);
@@ -88,6 +96,64 @@ public:
      */
     virtual size_t writeFixSize(ByteArray::ptr byte_array, size_t length);
 
+    // region # Output buffer
+    /**
+     * @brief 开启输出缓冲，之后 writeBuffered 写入的数据先进入缓冲区，合并成一次 writev 发送
+     * @details 刷新时机：缓冲的数据达到 threshold 时立即刷新；否则 delay_us 为 0 时，
+     * 刷新作为一个任务加入当前调度器，在当前协程让出后执行，同一轮中的多次写入合并发送；
+     * delay_us 不为 0 时最多延迟 delay_us 微秒，跨越多轮合并，用延迟换更少的包。
+     * 不在调度器中调用时立即刷新。Connection 必须由 shared_ptr 管理。
+     * @param threshold 立即刷新的阈值
+     * @param delay_us 最长延迟，微秒
+     */
+    void setOutputBuffer(size_t threshold = FLUSH_THRESHOLD, uint64_t delay_us = 0);
+
+    /**
+     * @brief 刷新时是否用 TCP_CORK 包住整次刷新，缓冲区超过一次 writev 能发送的长度时，中间不发出不满的包
+     * @details 不开启时，一次刷新中后面还有数据的 writev 带 MSG_MORE，效果相近，少两次 setsockopt
+     */
+    void setCork(bool on) { cork_ = on; }
+
+    /**
+     * @brief 写入输出缓冲区，没有开启输出缓冲时等同于 writeFixSize
+     * @details 可以在多个协程中同时调用，每次写入的数据在输出中保持连续；
+     * 和 write/writeFixSize 混用时，先调用 flush，否则顺序不确定
+     * @param buffer 缓冲区
+     * @param length 缓冲区大小
+     * @return 写入的字节数，连接已断开时返回 -1
+     */
+    size_t writeBuffered(const void *buffer, size_t length);
+
+    /**
+     * @brief 把多段数据作为一个整体写入输出缓冲区，各段之间不会插入其它协程写入的数据
+     * @param buffers 数据段
+     * @param count 数据段个数
+     * @return 写入的总字节数，连接已断开时返回 -1
+     */
+    size_t writeBuffered(const iovec *buffers, size_t count);
+
+    /**
+     * @brief 发送输出缓冲区中的全部数据，另一个协程正在刷新时直接返回，由它继续发送新写入的数据
+     * @return 是否发送成功，失败时丢弃缓冲的数据
+     */
+    bool flush();
+
+    /**
+     * @brief 输出缓冲区中还没有发送的字节数，不包括正在发送的部分
+     */
+    size_t getBufferedSize();
+
+    /**
+     * @brief writeBuffered 的调用次数
+     */
+    uint64_t getBufferedWrites() const { return buffered_writes_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 刷新输出缓冲区的发送系统调用次数
+     */
+    uint64_t getFlushSyscalls() const { return flush_syscalls_.load(std::memory_order_relaxed); }
+    // endregion
+
     /**
      * @brief 获取 http 连接所持有的 socket 对象
      * @return 所持有的 socket 对象
@@ -99,6 +165,38 @@ public:
 private:
     /// 所持有的 socket 对象
     Socket::ptr socket_;
+    /// 读字节数组时复用的 iovec，读写可能在不同协程中同时进行，各用一个
+    std::vector<iovec> read_iovs_;
+    /// 写字节数组时复用的 iovec
+    std::vector<iovec> write_iovs_;
+
+    /**
+     * @brief 安排一次刷新
+     */
+    void scheduleFlush();
+
+    /// 保护 output_、flush_scheduled_ 和 flushing_
+    Mutex output_mutex_;
+    /// 输出缓冲区，没有开启输出缓冲时为空
+    ByteArray::ptr output_;
+    /// 正在发送的缓冲区，刷新时和 output_ 交换，发送期间不持有锁
+    ByteArray::ptr sending_;
+    /// 刷新时复用的 iovec
+    std::vector<iovec> flush_iovs_;
+    /// 立即刷新的阈值
+    size_t threshold_;
+    /// 最长延迟，微秒
+    uint64_t delay_us_;
+    /// 刷新时是否使用 TCP_CORK
+    bool cork_;
+    /// 是否已经安排了刷新
+    bool flush_scheduled_;
+    /// 是否有协程正在刷新
+    bool flushing_;
+    /// writeBuffered 的调用次数
+    std::atomic<uint64_t> buffered_writes_;
+    /// 刷新的发送系统调用次数
+    std::atomic<uint64_t> flush_syscalls_;
 };
 
 }
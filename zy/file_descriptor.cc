@@ -1,87 +1,135 @@
 #include "file_descriptor.h"
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 #include "hook.h"
 
 namespace zy {
-FdContext::FdContext(int fd)
-    : fd_(fd), is_init_(false), is_socket_(false)
-    , is_sys_nonblock_(false), is_user_nonblock(false), is_close_(false) {
-    init();
+FdContext::FdContext()
+    : fd_(-1), generation_(0), is_init_(false), is_socket_(false), is_fifo_(false)
+    , is_file_(false), is_sys_nonblock_(false), is_user_nonblock(false), is_offload_(true), is_no_sigpipe_(false)
+    , recv_timeout_(0), send_timeout_(0) {
 }
 
-bool FdContext::init() {
-    if (isInit()) {
-        return true;
-    }
+bool FdContext::init(int fd) {
+    fd_ = fd;
+    // 复用的上下文要把上一个 fd 留下的状态全部清掉
+    is_user_nonblock.store(false, std::memory_order_relaxed);
+    is_offload_.store(true, std::memory_order_relaxed);
+    is_no_sigpipe_.store(false, std::memory_order_relaxed);
+    recv_timeout_.store(0, std::memory_order_relaxed);
+    send_timeout_.store(0, std::memory_order_relaxed);
 
     // 通过系统调用获得文件描述符的状态
     struct stat fd_stat{};
     if (fstat(fd_, &fd_stat) == -1) {        // fstat 调用出错
         is_init_ = false;
         is_socket_ = false;
+        is_fifo_ = false;
+        is_file_ = false;
     } else {
         is_init_ = true;
         is_socket_ = S_ISSOCK(fd_stat.st_mode);
+        is_fifo_ = S_ISFIFO(fd_stat.st_mode);
+        is_file_ = S_ISREG(fd_stat.st_mode);
     }
 
-    // TODO 用户使用类似 socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0) 时怎么办？
-    is_user_nonblock = false;
-    is_close_ = false;
-
-    if (is_socket_) {                                               // socket 描述符系统统一设置为非阻塞
+    if (isPollable()) {                                             // socket 和管道系统统一设置为非阻塞
         // 这两个必须直接指定使用原始系统调用，使用 fcntl 会被 hook，造成死锁
         int flags = fcntl_f(fd_, F_GETFL, 0);
+        // 创建时已经是非阻塞的（SOCK_NONBLOCK、O_NONBLOCK），说明是用户设置的
+        is_user_nonblock.store(flags & O_NONBLOCK, std::memory_order_relaxed);
         fcntl_f(fd_, F_SETFL, flags | O_NONBLOCK);
         is_sys_nonblock_ = true;
     } else {
         is_sys_nonblock_ = false;
     }
+
+    if (is_socket_) {
+        // accept 得到的 socket 会继承监听 socket 的超时设置，创建时读一次，之后由 setsockopt 维护
+        // getsockopt 被 hook 了，会查询上下文，这里要用原始的系统调用
+        timeval tv{};
+        socklen_t len = sizeof tv;
+        if (getsockopt_f(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, &len) == 0) {
+            recv_timeout_.store(tv.tv_sec * 1000 + tv.tv_usec / 1000, std::memory_order_relaxed);
+        }
+        len = sizeof tv;
+        if (getsockopt_f(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, &len) == 0) {
+            send_timeout_.store(tv.tv_sec * 1000 + tv.tv_usec / 1000, std::memory_order_relaxed);
+        }
+    }
     return is_init_;
 }
 
+uint64_t FdContext::getTimeout(int type) const {
+    return (type == SO_RCVTIMEO ? recv_timeout_ : send_timeout_).load(std::memory_order_relaxed);
+}
+
+void FdContext::setTimeout(int type, uint64_t timeout) {
+    (type == SO_RCVTIMEO ? recv_timeout_ : send_timeout_).store(timeout, std::memory_order_relaxed);
+}
+
 FdManager::FdManager() {
-    fds_.resize(64);
+    for (auto &chunk : chunks_) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
 }
 
-FdContext::ptr FdManager::get(int fd, bool auto_create) {
-    if (fd <= 0) {
+FdManager::~FdManager() {
+    for (auto &chunk : chunks_) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+FdContext *FdManager::slot(int fd, bool alloc) {
+    if (fd < 0 || fd >= CHUNK_SIZE * MAX_CHUNKS) {
         return nullptr;
     }
+    std::atomic<FdContext *> &chunk = chunks_[fd / CHUNK_SIZE];
+    FdContext *contexts = chunk.load(std::memory_order_acquire);
+    if (!contexts && alloc) {
+        // 调用者持有 mutex_，不会重复分配
+        contexts = new FdContext[CHUNK_SIZE];
+        chunk.store(contexts, std::memory_order_release);
+    }
+    return contexts ? &contexts[fd % CHUNK_SIZE] : nullptr;
+}
 
-    // 先处理不需要创建的情况
-    // 1. 超界，不自动创建
-    // 2. 不超界，有值，无需创建
-    // 3. 不超界，无值，不自动创建
-    RWMutex::ReadLock lock(mutex_);
-    if (fd >= static_cast<int>(fds_.size())) {
-        if (!auto_create) {
-            return nullptr;                 // 1、
-        }
-    } else {
-        if (fds_[fd] || !auto_create) {
-            return fds_[fd];                // 2、3
-        }
+FdContext *FdManager::get(int fd, bool auto_create) {
+    // 先处理不需要创建的情况，不加锁
+    FdContext *ctx = slot(fd, false);
+    if (ctx && (ctx->getGeneration() & 1)) {
+        return ctx;
+    }
+    if (!auto_create) {
+        return nullptr;
     }
-    lock.unlock();
 
-    // 然后处理需要创建的情况
-    // 4. 超界，需要创建
-    // 5. 不超界，无值，需要创建
-    RWMutex::WriteLock lock1(mutex_);
-    if (fd >= static_cast<int>(fds_.size())) {
-        fds_.resize(fd * 2);        // 4、
+    // 然后处理需要创建的情况，fd 刚由系统调用返回，同一时刻只会有一个线程创建它的上下文
+    Mutex::Lock lock(mutex_);
+    ctx = slot(fd, true);
+    if (!ctx) {
+        return nullptr;
     }
-    FdContext::ptr ctx(new FdContext(fd));
-    fds_[fd] = ctx;
+    uint32_t generation = ctx->generation_.load(std::memory_order_relaxed);
+    if (generation & 1) {
+        return ctx;
+    }
+    ctx->init(fd);
+    // 发布之后其他线程才能看到 init 写入的状态
+    ctx->generation_.store(generation + 1, std::memory_order_release);
     return ctx;
 }
 
 void FdManager::del(int fd) {
-    RWMutex::WriteLock lock(mutex_);
-    if (fd >= static_cast<int>(fds_.size())) {
+    Mutex::Lock lock(mutex_);
+    FdContext *ctx = slot(fd, false);
+    if (!ctx) {
         return;
     }
-    fds_[fd].reset();
+    uint32_t generation = ctx->generation_.load(std::memory_order_relaxed);
+    if (generation & 1) {
+        ctx->generation_.store(generation + 1, std::memory_order_release);
+    }
+}
 }
-}
\ No newline at end of file
@@ -2,31 +2,45 @@
 #define __ZY_FILE_DESCRIPTOR_H__
 
 #include <memory>
-#include <vector>
+#include <atomic>
+#include <cstdint>
 #include "utils/mutex.h"
 #include "utils/singleton.h"
+#include "utils/noncopyable.h"
 
 namespace zy {
 /**
  * @brief 文件描述符上下文
+ * @details 上下文内嵌在 FdManager 的数组里，地址在进程内一直有效，fd 关闭后同一个对象会被新的 fd 复用。
+ * 代数 generation_ 为奇数表示打开，每次创建和删除加一，持有指针跨越挂起的调用者用它判断 fd 是否已经被关闭或复用。
+ * 创建和删除在 FdManager 的锁内进行，读取不加锁：创建时写入的状态在代数发布之后不再改变，之后会修改的状态都是原子变量。
  */
-class FdContext {
+class FdContext : NonCopyable {
 public:
-    using ptr = std::shared_ptr<FdContext>;
+    /**
+     * @brief 构造函数，构造出的上下文处于关闭状态，由 FdManager 初始化
+     */
+    FdContext();
+
+    // region # Getter and Setter
+    int getFd() const {
+        return fd_;
+    }
 
     /**
-     * @brief 构造函数
-     * @param fd 文件描述符
+     * @brief 获取代数，奇数表示打开
      */
-    explicit FdContext(int fd);
+    uint32_t getGeneration() const {
+        return generation_.load(std::memory_order_acquire);
+    }
 
     /**
-     * @brief 初始化文件描述符上下文的所有状态
-     * @return 操作是否成功
+     * @brief 上下文是否还是 generation 那一代，即 fd 没有在此期间被关闭或复用
      */
-    bool init();
+    bool isSame(uint32_t generation) const {
+        return getGeneration() == generation;
+    }
 
-    // region # Getter and Setter
     bool isInit() const {
         return is_init_;
     }
@@ -35,67 +49,159 @@ public:
         return is_socket_;
     }
 
+    /**
+     * @brief 是否可以用 epoll 等待读写，socket 和管道
+     */
+    bool isPollable() const {
+        return is_socket_ || is_fifo_;
+    }
+
+    /**
+     * @brief 是否是普通文件，hook 后的读写交给 FileIOPool 执行
+     */
+    bool isFile() const {
+        return is_file_;
+    }
+
+    bool isOffload() const {
+        return is_offload_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 设置普通文件的读写是否交给 FileIOPool 执行，默认开启
+     * @details 关闭后在当前线程直接读写，适合确定在页缓存中的小文件，省掉两次线程切换
+     */
+    void setOffload(bool offload) {
+        is_offload_.store(offload, std::memory_order_relaxed);
+    }
+
+    bool isNoSigpipe() const {
+        return is_no_sigpipe_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 设置 socket 的写入是否带 MSG_NOSIGNAL，对端关闭后写入返回 EPIPE 而不是触发 SIGPIPE
+     * @details 对 hook 后的 write、writev、send、sendmsg 都生效，用于第三方库（如 OpenSSL）内部发起的写入
+     */
+    void setNoSigpipe(bool no_sigpipe) {
+        is_no_sigpipe_.store(no_sigpipe, std::memory_order_relaxed);
+    }
+
     bool isSysNonblock() const {
         return is_sys_nonblock_;
     }
 
     bool isUserNonblock() const {
-        return is_user_nonblock;
+        return is_user_nonblock.load(std::memory_order_relaxed);
     }
 
     bool isClose() const {
-        return is_close_;
+        return !(getGeneration() & 1);
     }
 
     void setUserNonblock(bool isUserNonblock) {
-        is_user_nonblock = isUserNonblock;
+        is_user_nonblock.store(isUserNonblock, std::memory_order_relaxed);
     }
+
+    /**
+     * @brief 获取超时时间
+     * @param type 超时类型，SO_RCVTIMEO 或 SO_SNDTIMEO
+     * @return 超时时间，毫秒，0 表示没有超时
+     */
+    uint64_t getTimeout(int type) const;
+
+    /**
+     * @brief 设置超时时间，由 hook 后的 setsockopt 调用，之后的 IO 不再需要 getsockopt
+     * @param type 超时类型，SO_RCVTIMEO 或 SO_SNDTIMEO
+     * @param timeout 超时时间，毫秒，0 表示没有超时
+     */
+    void setTimeout(int type, uint64_t timeout);
     // endregion
 
+private:
+    friend class FdManager;
+
+    /**
+     * @brief 为 fd 初始化上下文的所有状态，在代数发布之前调用
+     * @param fd 文件描述符
+     * @return fd 是否有效
+     */
+    bool init(int fd);
+
 private:
     /// 文件描述符
     int fd_;
+    /// 代数，奇数表示打开
+    std::atomic<uint32_t> generation_;
     /// 文件描述符上下文状态是否初始化
     bool is_init_:1;
     /// 是否是 socket 文件描述符
     bool is_socket_:1;
+    /// 是否是管道
+    bool is_fifo_:1;
+    /// 是否是普通文件
+    bool is_file_:1;
     /// hook 模块是否设置了非阻塞
     bool is_sys_nonblock_:1;
-    /// 用户是否设置了非阻塞
-    bool is_user_nonblock:1;
-    /// 文件描述符是否关闭
-    bool is_close_:1;           // 其实用不上，因为 close 之后就会从 FdManager 中删除了
+    /// 用户是否设置了非阻塞，fcntl 可能在其他线程修改
+    std::atomic<bool> is_user_nonblock;
+    /// 普通文件的读写是否交给 FileIOPool 执行
+    std::atomic<bool> is_offload_;
+    /// socket 的写入是否带 MSG_NOSIGNAL
+    std::atomic<bool> is_no_sigpipe_;
+    /// 接收超时时间，毫秒
+    std::atomic<uint64_t> recv_timeout_;
+    /// 发送超时时间，毫秒
+    std::atomic<uint64_t> send_timeout_;
 };
 
 /**
  * @brief 文件描述符上下文管理类
+ * @details 上下文按 fd 分块存放，块在第一次用到时分配，之后不移动也不释放。查找只有两次数组访问和一次 acquire 读，
+ * 不加锁也没有引用计数；创建和删除加锁，它们只发生在 socket、accept、close 这些本来就要系统调用的地方。
  */
-class FdManager {
+class FdManager : NonCopyable {
 public:
+    /// 每块的上下文数量
+    static const int CHUNK_SIZE = 1024;
+    /// 块数，支持的 fd 上限是 CHUNK_SIZE * MAX_CHUNKS，与内核 nr_open 的默认值相同
+    static const int MAX_CHUNKS = 1024;
+
     /**
      * @brief 构造函数
      */
     FdManager();
 
+    /**
+     * @brief 析构函数，释放所有块
+     */
+    ~FdManager();
+
     /**
      * @brief 获取或创建一个文件描述符上下文
      * @param fd 文件描述符
      * @param auto_create 文件描述符上下文不存在时是否创建
-     * @return 对应的文件描述符上下文
+     * @return 对应的文件描述符上下文，不存在或 fd 超出上限时返回 nullptr
      */
-    FdContext::ptr get(int fd, bool auto_create = false);
+    FdContext *get(int fd, bool auto_create = false);
 
     /**
-     * @ 删除一个文件描述符上下文
+     * @brief 删除一个文件描述符上下文
      * @param fd 文件描述符
      */
     void del(int fd);
 
 private:
-    /// 文件描述符不是属于某一个线程的，所以要加锁
-    RWMutex mutex_;
-    /// 文件描述符上下文数组
-    std::vector<FdContext::ptr> fds_;
+    /**
+     * @brief 获取 fd 所在的块中的上下文，块不存在时按需分配
+     */
+    FdContext *slot(int fd, bool alloc);
+
+private:
+    /// 只保护创建和删除
+    Mutex mutex_;
+    /// 上下文块
+    std::atomic<FdContext *> chunks_[MAX_CHUNKS];
 };
 
 /// 文件描述符上下文管理类的单例
@@ -0,0 +1,83 @@
+#include "file_io.h"
+#include "scheduler.h"
+
+namespace zy {
+
+FileIOPool::FileIOPool() : thread_num_(4), stopping_(false) {
+}
+
+FileIOPool::~FileIOPool() {
+    std::vector<Thread::ptr> threads;
+    {
+        Mutex::Lock lock(mutex_);
+        stopping_ = true;
+        threads.swap(threads_);
+    }
+    // 每个线程一次通知，队列空了之后退出
+    for (size_t i = 0; i < threads.size(); ++i) {
+        sem_.notify();
+    }
+    for (auto &thread : threads) {
+        thread->join();
+    }
+}
+
+void FileIOPool::run(const std::function<void()> &job) {
+    if (!Scheduler::IsInTask()) {
+        job();
+        return;
+    }
+
+    // 任务在协程栈上，协程恢复之前栈一直有效
+    Job task{job, Fiber::GetThis(), Scheduler::GetThis()};
+    task.scheduler_->park();
+    push(&task);
+    Fiber::GetThis()->yield();
+}
+
+void FileIOPool::post(std::function<void()> job) {
+    push(new Job{std::move(job), nullptr, nullptr});
+}
+
+void FileIOPool::push(Job *job) {
+    {
+        Mutex::Lock lock(mutex_);
+        jobs_.push_back(job);
+        if (threads_.empty() && !stopping_) {
+            for (uint32_t i = 0; i < thread_num_; ++i) {
+                threads_.emplace_back(new Thread("file_io_" + std::to_string(i), std::bind(&FileIOPool::work, this)));
+            }
+        }
+    }
+    sem_.notify();
+}
+
+void FileIOPool::work() {
+    while (true) {
+        sem_.wait();
+        Job *job = nullptr;
+        {
+            Mutex::Lock lock(mutex_);
+            if (jobs_.empty()) {
+                if (stopping_) {
+                    return;
+                }
+                continue;
+            }
+            job = jobs_.front();
+            jobs_.pop_front();
+        }
+
+        job->func_();
+        if (job->fiber_) {
+            // 放回调度器之后协程随时可能恢复并销毁 job，先把需要的东西取出来
+            Fiber::ptr fiber = std::move(job->fiber_);
+            Scheduler *scheduler = job->scheduler_;
+            scheduler->unpark(fiber);
+        } else {
+            delete job;
+        }
+    }
+}
+
+}
@@ -0,0 +1,100 @@
+#ifndef __ZY_FILE_IO_H__
+#define __ZY_FILE_IO_H__
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include "thread.h"
+#include "fiber.h"
+#include "utils/mutex.h"
+#include "utils/singleton.h"
+#include "utils/noncopyable.h"
+
+namespace zy {
+
+class Scheduler;
+
+/**
+ * @brief 普通文件 IO 线程池
+ * @details 普通文件在 epoll 看来总是可读写的，读写真正阻塞在磁盘上。hook 后的 read/write 遇到普通文件时，
+ * 把系统调用交给这里的线程执行，调用的协程挂起，执行完成后再放回原来的调度器，磁盘慢时不会卡住同一线程上的网络协程。
+ * 线程在第一次提交任务时创建。
+ */
+class FileIOPool : NonCopyable {
+public:
+    /**
+     * @brief 构造函数，不创建线程
+     */
+    FileIOPool();
+
+    /**
+     * @brief 析构函数，执行完已经提交的任务后回收所有线程
+     */
+    ~FileIOPool();
+
+    /**
+     * @brief 在 IO 线程中执行 job，当前协程挂起直到 job 执行完成
+     * @details 不在调度器的任务协程中时（调度协程、idle 协程、没有调度器的线程）直接在当前线程执行
+     * @param job 要执行的操作，执行期间调用者的栈保持有效，可以按引用捕获
+     */
+    void run(const std::function<void()> &job);
+
+    /**
+     * @brief 在 IO 线程中执行 job，不等待完成
+     * @param job 要执行的操作
+     */
+    void post(std::function<void()> job);
+
+    // region # Getter and Setter
+    uint32_t getThreadNum() const {
+        return thread_num_;
+    }
+
+    /**
+     * @brief 设置线程数，只在第一次提交任务之前有效
+     */
+    void setThreadNum(uint32_t thread_num) {
+        thread_num_ = thread_num ? thread_num : 1;
+    }
+    // endregion
+
+private:
+    struct Job {
+        std::function<void()> func_;
+        /// 等待完成的协程，post 提交的任务为空
+        Fiber::ptr fiber_;
+        /// 协程所属的调度器
+        Scheduler *scheduler_;
+    };
+
+    /**
+     * @brief 任务入队，第一次调用时创建线程
+     */
+    void push(Job *job);
+
+    /**
+     * @brief IO 线程的入口函数
+     */
+    void work();
+
+private:
+    /// 保护任务队列和线程数组
+    Mutex mutex_;
+    /// 每个任务通知一次
+    Semaphore sem_;
+    /// 任务队列
+    std::deque<Job *> jobs_;
+    /// IO 线程
+    std::vector<Thread::ptr> threads_;
+    /// 线程数
+    uint32_t thread_num_;
+    /// 是否正在析构
+    bool stopping_;
+};
+
+/// 普通文件 IO 线程池的单例
+using FileIOMgr = Singleton<FileIOPool>;
+
+}
+
+#endif //__ZY_FILE_IO_H__
@@ -0,0 +1,135 @@
+#include "frame_codec.h"
+
+#include <errno.h>
+#include <algorithm>
+#include "log.h"
+
+namespace zy {
+
+const size_t FrameCodec::READ_SIZE;
+
+FrameCodec::ptr FrameCodec::LengthPrefixed(Connection::ptr conn, size_t max_frame_size) {
+    return FrameCodec::ptr(new FrameCodec(std::move(conn), false, 0, max_frame_size));
+}
+
+FrameCodec::ptr FrameCodec::Delimited(Connection::ptr conn, char delimiter, size_t max_frame_size) {
+    return FrameCodec::ptr(new FrameCodec(std::move(conn), true, delimiter, max_frame_size));
+}
+
+FrameCodec::FrameCodec(Connection::ptr conn, bool delimited, char delimiter, size_t max_frame_size)
+    : conn_(std::move(conn)), delimited_(delimited), delimiter_(delimiter), max_frame_size_(max_frame_size)
+    , input_(std::make_shared<ByteArray>()), consumed_(0), searched_(0), too_large_(false), missing_(0)
+    , frames_(0), reads_(0) {
+}
+
+FrameCodec::Status FrameCodec::readFrame(StringView &frame) {
+    // 上一帧的视图到这里失效
+    input_->hasRead(consumed_);
+    consumed_ = 0;
+    if (too_large_) {
+        return TOO_LARGE;
+    }
+
+    while (true) {
+        size_t offset = 0, length = 0, total = 0;
+        if (parse(offset, length, total)) {
+            frame = input_->peek(offset, length, scratch_);
+            consumed_ = total;
+            ++frames_;
+            return FRAME;
+        }
+        if (too_large_) {
+            ZY_LOG_ERROR(ZY_LOG_ROOT()) << "frame exceeds " << max_frame_size_ << " bytes, peer = "
+                                        << conn_->getSocket()->getPeerAddress()->toString();
+            errno = EMSGSIZE;
+            return TOO_LARGE;
+        }
+
+        size_t n = conn_->read(input_, readSize());
+        ++reads_;
+        if (n == 0) {
+            if (input_->getReadableSize() == 0) {
+                return CLOSED;
+            }
+            // 对端在一帧的中间关闭
+            errno = ECONNRESET;
+            return ERROR;
+        }
+        if (n == static_cast<size_t>(-1)) {
+            return ERROR;
+        }
+    }
+}
+
+bool FrameCodec::parse(size_t &offset, size_t &length, size_t &total) {
+    size_t readable = input_->getReadableSize();
+    if (delimited_) {
+        size_t pos = input_->find(delimiter_, searched_);
+        if (pos == StringView::npos) {
+            searched_ = readable;
+            too_large_ = readable > max_frame_size_;
+            return false;
+        }
+        searched_ = 0;
+        if (pos > max_frame_size_) {
+            too_large_ = true;
+            return false;
+        }
+        offset = 0;
+        length = pos;
+        total = pos + 1;
+        return true;
+    }
+
+    if (readable < HEADER_SIZE) {
+        return false;
+    }
+    uint32_t size = 0;
+    for (size_t i = 0; i < HEADER_SIZE; ++i) {
+        size = size << 8 | static_cast<uint8_t>(input_->peekByte(i));
+    }
+    if (size > max_frame_size_) {
+        too_large_ = true;
+        return false;
+    }
+    if (readable < HEADER_SIZE + size) {
+        missing_ = HEADER_SIZE + size - readable;
+        return false;
+    }
+    missing_ = 0;
+    offset = HEADER_SIZE;
+    length = size;
+    total = HEADER_SIZE + size;
+    return true;
+}
+
+size_t FrameCodec::readSize() const {
+    size_t size = std::max(input_->getWriteableSize(), input_->getBlockSize());
+    if (missing_ > size) {
+        size = std::min(missing_, READ_SIZE);
+    }
+    return size;
+}
+
+size_t FrameCodec::writeFrame(const void *data, size_t length) {
+    if (!delimited_ && length > max_frame_size_) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    char header[HEADER_SIZE];
+    iovec iovs[2];
+    if (delimited_) {
+        iovs[0] = {const_cast<void *>(data), length};
+        iovs[1] = {&delimiter_, 1};
+    } else {
+        uint32_t size = static_cast<uint32_t>(length);
+        for (size_t i = 0; i < HEADER_SIZE; ++i) {
+            header[i] = static_cast<char>(size >> (8 * (HEADER_SIZE - 1 - i)));
+        }
+        iovs[0] = {header, HEADER_SIZE};
+        iovs[1] = {const_cast<void *>(data), length};
+    }
+    return conn_->writeBuffered(iovs, 2);
+}
+
+}
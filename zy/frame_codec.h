@@ -0,0 +1,149 @@
+#ifndef __ZY_FRAME_CODEC_H__
+#define __ZY_FRAME_CODEC_H__
+
+#include <memory>
+#include <string>
+#include "connection.h"
+#include "byte_array.h"
+#include "utils/string_view.h"
+
+namespace zy {
+
+/**
+ * @brief 消息分帧
+ * @details 在 Connection 上把字节流切分成完整的消息，支持两种格式：
+ * 长度前缀，每帧前面是 4 字节大端的负载长度；分隔符，每帧以一个分隔符结尾，负载中不能出现分隔符。
+ * 接收的数据放在一个复用的字节数组中，一次读取收到的多帧依次返回，不再读套接字；
+ * 一帧被拆成多次到达时继续读取，直到收齐。平时只读入字节数组已有的空闲空间（至少一个块），
+ * 空闲连接不会占住多余的块；长度前缀表明一帧更大时才按缺少的长度扩容。同一时刻只能有一个协程调用 readFrame。
+ */
+class FrameCodec {
+public:
+    using ptr = std::shared_ptr<FrameCodec>;
+
+    /// 默认的最大帧长度
+    static const size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+    /// 已知一帧还差多少字节时，每次从套接字读取的最大长度
+    static const size_t READ_SIZE = 64 * 1024;
+    /// 长度前缀的字节数
+    static const size_t HEADER_SIZE = 4;
+
+    /**
+     * @brief readFrame 的结果
+     */
+    enum Status {
+        /// 读到一帧
+        FRAME,
+        /// 对端关闭，没有未完成的帧
+        CLOSED,
+        /// 接收出错，或者对端在一帧的中间关闭
+        ERROR,
+        /// 帧超过最大长度，之后连接不可用
+        TOO_LARGE,
+    };
+
+    /**
+     * @brief 创建长度前缀格式的分帧器
+     * @param conn 连接
+     * @param max_frame_size 最大帧长度，不含长度前缀
+     */
+    static FrameCodec::ptr LengthPrefixed(Connection::ptr conn, size_t max_frame_size = MAX_FRAME_SIZE);
+
+    /**
+     * @brief 创建分隔符格式的分帧器
+     * @param conn 连接
+     * @param delimiter 分隔符
+     * @param max_frame_size 最大帧长度，不含分隔符
+     */
+    static FrameCodec::ptr Delimited(Connection::ptr conn, char delimiter, size_t max_frame_size = MAX_FRAME_SIZE);
+
+    /**
+     * @brief 读取下一帧，缓冲区中已有完整的帧时直接返回，不读套接字
+     * @param frame 输出帧的负载，在下一次 readFrame 之前有效
+     * @return 结果
+     */
+    Status readFrame(StringView &frame);
+
+    /**
+     * @brief 编码并发送一帧，连接开启了输出缓冲时写入缓冲区，帧的各部分整体写入
+     * @param data 负载
+     * @param length 负载长度
+     * @return 发送的字节数，包括长度前缀或分隔符，失败时返回 -1
+     */
+    size_t writeFrame(const void *data, size_t length);
+
+    size_t writeFrame(StringView data) { return writeFrame(data.data(), data.size()); }
+
+    // region # Getter
+    const Connection::ptr &getConnection() const { return conn_; }
+
+    /**
+     * @brief 缓冲区中还没有返回的字节数
+     */
+    size_t getBufferedSize() const { return input_->getReadableSize() - consumed_; }
+
+    /**
+     * @brief 返回的帧数
+     */
+    uint64_t getFrames() const { return frames_; }
+
+    /**
+     * @brief 读套接字的次数，和帧数比较可以看出一次读取平均带回几帧
+     */
+    uint64_t getReads() const { return reads_; }
+    // endregion
+
+private:
+    /**
+     * @brief 构造函数
+     * @param conn 连接
+     * @param delimited 是否是分隔符格式
+     * @param delimiter 分隔符
+     * @param max_frame_size 最大帧长度
+     */
+    FrameCodec(Connection::ptr conn, bool delimited, char delimiter, size_t max_frame_size);
+
+    /**
+     * @brief 在缓冲区中查找一帧
+     * @param offset 输出负载的偏移
+     * @param length 输出负载的长度
+     * @param total 输出整帧的长度，包括长度前缀或分隔符
+     * @return 是否找到完整的帧，帧超长时返回 false 并设置 too_large_
+     */
+    bool parse(size_t &offset, size_t &length, size_t &total);
+
+    /**
+     * @brief 下一次从套接字读取的长度
+     */
+    size_t readSize() const;
+
+private:
+    /// 连接
+    Connection::ptr conn_;
+    /// 是否是分隔符格式
+    bool delimited_;
+    /// 分隔符
+    char delimiter_;
+    /// 最大帧长度
+    size_t max_frame_size_;
+    /// 接收缓冲区，跨越多次 readFrame 复用
+    ByteArray::ptr input_;
+    /// 上一次返回的帧在缓冲区中占用的长度，下一次 readFrame 时消耗
+    size_t consumed_;
+    /// 分隔符格式中已经查找过、没有分隔符的长度，避免重复扫描
+    size_t searched_;
+    /// 帧是否超长
+    bool too_large_;
+    /// 长度前缀格式中当前帧还缺少的字节数，不知道时为 0
+    size_t missing_;
+    /// 帧跨越块时拷贝到这里
+    std::string scratch_;
+    /// 返回的帧数
+    uint64_t frames_;
+    /// 读套接字的次数
+    uint64_t reads_;
+};
+
+}
+
+#endif //__ZY_FRAME_CODEC_H__
@@ -2,10 +2,18 @@
 
 #include <dlfcn.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <cstdarg>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <algorithm>
 #include "fiber.h"
 #include "reactor.h"
+#include "clock.h"
 #include "file_descriptor.h"
+#include "file_io.h"
 
 //debug
 // #include "log.h"
@@ -13,21 +21,38 @@
 // 带参数的宏定义
 #define HOOK_FUN(XX) \
     XX(sleep)        \
+    XX(usleep)       \
+    XX(nanosleep)    \
+    XX(poll)         \
+    XX(select)       \
+    XX(epoll_wait)   \
     XX(socket)       \
+    XX(socketpair)   \
     XX(connect)      \
     XX(accept)       \
+    XX(accept4)      \
     XX(close)        \
+    XX(dup)          \
+    XX(dup2)         \
+    XX(dup3)         \
+    XX(pipe)         \
+    XX(pipe2)        \
     XX(read)         \
     XX(readv)        \
     XX(recv)         \
     XX(recvfrom)     \
     XX(recvmsg)      \
+    XX(recvmmsg)     \
     XX(write)        \
     XX(writev)       \
     XX(send)         \
     XX(sendto)       \
     XX(sendmsg)      \
+    XX(sendmmsg)     \
+    XX(sendfile)     \
     XX(fcntl)        \
+    XX(setsockopt)   \
+    XX(getsockopt)   \
 
 namespace zy {
     // 线程局部变量，标识该线程是否被 hook
@@ -55,10 +80,22 @@ namespace zy {
     // static 变量会在 main 函数之前被初始化，在 s_hook_init 被构造时会将上述的原始系统调用的地址保存在同名的 name_f 函数指针中。
     static HookInit s_hook_init;
 
-    // 指示定时器是否被取消，用于在回调函数中传递信息
-    struct TimerInfo {
-        int canceled = 0;
-    };
+    /**
+     * @brief 普通文件的读写交给 FileIOPool 执行，当前协程挂起直到完成
+     * @details 普通文件总是“就绪”的，epoll 等不了磁盘，只能换一个线程去阻塞
+     * @return 读写字节数，出错时 errno 与原始系统调用一致
+     */
+    template<typename OriginFunc, typename ... Args>
+    static ssize_t do_file_io(int fd, OriginFunc func, Args &&... args) {
+        ssize_t n = -1;
+        int error = 0;
+        FileIOMgr::GetInstance().run([&]() {
+            n = func(fd, args...);
+            error = errno;
+        });
+        errno = error;
+        return n;
+    }
 
     /**
      * @brief io 类型的系统调用的统一处理模板类
@@ -78,20 +115,34 @@ namespace zy {
         }
 
         auto ctx = FdMgr::GetInstance().get(fd);
-        if (!ctx || !ctx->isInit() || ctx->isClose()) {
+        if (!ctx) {
+            // 不经过 hook 打开的文件描述符（open、fopen、std::ofstream、eventfd）没有上下文
+            // 普通文件照样交给 IO 线程，其他的直接调用，无效的文件描述符由系统调用返回 EBADF
+            struct stat fd_stat{};
+            if (fstat(fd, &fd_stat) == 0 && S_ISREG(fd_stat.st_mode)) {
+                return do_file_io(fd, func, std::forward<Args>(args)...);
+            }
+            return func(fd, std::forward<Args>(args)...);
+        }
+        // 上下文可能在等待期间被关闭、复用，记下当前的代数
+        uint32_t generation = ctx->getGeneration();
+        if (!ctx->isInit()) {
             errno = EBADF;
             return -1;
         }
-        if (!ctx->isSocket() || ctx->isUserNonblock()) {
+        if (ctx->isFile()) {
+            if (!ctx->isOffload()) {
+                return func(fd, std::forward<Args>(args)...);
+            }
+            return do_file_io(fd, func, std::forward<Args>(args)...);
+        }
+        if (!ctx->isPollable() || ctx->isUserNonblock()) {
             return func(fd, std::forward<Args>(args)...);
         }
 
         // 执行到这里是 -- 用户没有设置非阻塞的 socket 文件描述符
-        // 获得 socket 文件描述符的超时事件，没有设置结果为 0
-        timeval tv{};
-        socklen_t len = sizeof tv;
-        getsockopt(fd, SOL_SOCKET, so_timeout, &tv, &len);
-        uint64_t timeout = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        // 超时时间由 hook 后的 setsockopt 记录在上下文中，没有设置结果为 0
+        uint64_t timeout = ctx->getTimeout(so_timeout);
 
         ssize_t n;
         while (true) {
@@ -102,48 +153,154 @@ namespace zy {
 
             // 立即返回了，但是没有新连接到来或者没有数据可读写
             if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                auto r = Reactor::GetThis();
-                std::shared_ptr<TimerInfo> shared_info(new TimerInfo);
-                std::weak_ptr<TimerInfo> weak_info(shared_info);        // 指向 shared_info 但不增加引用计数
-
-                Timer::ptr clock;
-                // 如果设置了超时时间
-                if (timeout != 0) {
-                    clock = r->addCondTimer(timeout, [r, weak_info, fd, event](){
-                        auto t = weak_info.lock();
-                        if (t) {
-                            t->canceled = ETIMEDOUT;        // 设置超时标志
-                        }
-                        // 删除前触发一次，使添加该定时器的协程可以 resume
-                        r->delEvent(fd, static_cast<ReactorEvent::Event>(event), true);
-                    }, weak_info);
+                // 等待事件到来，超时定时器嵌入在 Channel 中，不分配内存
+                if (!Reactor::GetThis()->waitEvent(fd, static_cast<ReactorEvent::Event>(event), timeout)
+                    && errno == ETIMEDOUT) {
+                    // 用户没有设置非阻塞，有超时时间，所以在超时之后返回错误
+                    return -1;
                 }
-
-                bool rt = r->addEvent(fd, static_cast<ReactorEvent::Event>(event));
-                if (rt) {
-                    Fiber::GetThis()->yield();
-                    // resume 有两种可能：定时器超时，注册的事件到来
-                    // 1. 用户没有设置非阻塞，有超时时间，所以在超时之后返回错误
-                    if (shared_info->canceled) {
-                        errno = shared_info->canceled;
-                        return -1;
-                    }
-                    // 2. 没有超时，是由于事件发生返回的，所以取消定时器，再次接受数据
-                    if (clock) {
-                        clock->cancel();
-                    }
-                } else {
-                    // 添加事件出错，再次接受数据
-                    if (clock) {
-                        clock->cancel();
-                    }
+                if (!ctx->isSame(generation)) {
+                    // 等待期间 fd 被关闭了，同一个编号可能已经是另一个文件，不能再读写
+                    errno = EBADF;
+                    return -1;
                 }
+                // 事件到来或者添加事件出错，再次读写数据
             } else {
                 break;
             }
         }
         return n;
     }
+
+    /**
+     * @brief poll 等待的多个事件共享的唤醒状态，只唤醒一次
+     */
+    struct PollWaiter {
+        Fiber::ptr fiber_;
+        std::atomic<bool> woken_{false};
+    };
+
+    /**
+     * @brief pollfd 的事件对应的反应堆事件
+     */
+    static uint32_t poll_to_events(short events) {
+        uint32_t rt = ReactorEvent::NONE;
+        if (events & (POLLIN | POLLPRI | POLLRDHUP)) {
+            rt |= ReactorEvent::READ;
+        }
+        if (events & POLLOUT) {
+            rt |= ReactorEvent::WRITE;
+        }
+        return rt;
+    }
+
+    /**
+     * @brief 协程版的 poll
+     * @details 先不阻塞地检查一次，没有就绪的 fd 时为每个 fd 注册一个 poll 回调并挂起当前协程，
+     * 任意一个事件到来或者超时之后注销所有回调，再不阻塞地检查一次。
+     * poll 回调和读写等待互不影响，其他协程在等待同一个 fd 时也不会阻塞线程；数组中重复的 fd 合并成一个回调
+     * @param fds 同 poll
+     * @param nfds 同 poll
+     * @param timeout 超时时间，毫秒，负数表示一直等待
+     * @return 同 poll
+     */
+    static int do_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+        int n = poll_f(fds, nfds, 0);
+        if (n != 0 || timeout == 0) {
+            return n;
+        }
+
+        std::map<int, uint32_t> interests;
+        for (nfds_t i = 0; i < nfds; ++i) {
+            uint32_t events = poll_to_events(fds[i].events);
+            if (fds[i].fd >= 0 && events) {
+                interests[fds[i].fd] |= events;
+            }
+        }
+
+        auto r = Reactor::GetThis();
+        uint64_t deadline = timeout > 0 ? Clock::NowMs() + timeout : ~0ull;
+        std::vector<std::pair<int, uint64_t>> registered;
+        while (true) {
+            std::shared_ptr<PollWaiter> waiter(new PollWaiter);
+            waiter->fiber_ = Fiber::GetThis();
+            // 回调可能在协程返回之后才执行，只能捕获共享的状态
+            std::function<void()> wake = [waiter, r]() {
+                if (!waiter->woken_.exchange(true)) {
+                    r->addTask(waiter->fiber_);
+                }
+            };
+
+            registered.clear();
+            for (auto &item : interests) {
+                uint64_t id = r->addPollCallback(item.first, item.second, wake);
+                if (id) {
+                    registered.emplace_back(item.first, id);
+                }
+            }
+            Timer::ptr timer;
+            if (deadline != ~0ull) {
+                uint64_t now = Clock::NowMs();
+                timer = r->addTimer(deadline > now ? deadline - now : 0, wake);
+            }
+
+            waiter->fiber_->yield();
+
+            if (timer) {
+                timer->cancel();
+            }
+            for (auto &item : registered) {
+                r->delPollCallback(item.first, item.second);
+            }
+            n = poll_f(fds, nfds, 0);
+            if (n != 0 || (deadline != ~0ull && Clock::NowMs() >= deadline)) {
+                return n;
+            }
+        }
+    }
+
+    /**
+     * @brief socket 的写入是否需要带 MSG_NOSIGNAL
+     */
+    static bool is_no_sigpipe(int fd) {
+        auto ctx = FdMgr::GetInstance().get(fd);
+        return ctx && ctx->isSocket() && ctx->isNoSigpipe();
+    }
+
+    /**
+     * @brief 新的文件描述符继承旧的上下文，两者共享同一个打开的文件，阻塞状态和超时也一样
+     * @param oldfd 旧的文件描述符
+     * @param newfd 新的文件描述符
+     */
+    static void dup_context(int oldfd, int newfd) {
+        auto old_ctx = FdMgr::GetInstance().get(oldfd);
+        if (!old_ctx) {
+            return;
+        }
+        auto ctx = FdMgr::GetInstance().get(newfd, true);
+        ctx->setUserNonblock(old_ctx->isUserNonblock());
+        ctx->setNoSigpipe(old_ctx->isNoSigpipe());
+        ctx->setTimeout(SO_RCVTIMEO, old_ctx->getTimeout(SO_RCVTIMEO));
+        ctx->setTimeout(SO_SNDTIMEO, old_ctx->getTimeout(SO_SNDTIMEO));
+    }
+
+    /**
+     * @brief 文件描述符即将被关闭或者已经被 dup2 覆盖，注销事件并删除上下文
+     * @details 被覆盖时内核已经删除了旧文件在 epoll 中的注册，这里只清理反应堆的状态
+     * @param fd 文件描述符
+     */
+    static void release_fd(int fd) {
+        auto ctx = FdMgr::GetInstance().get(fd);
+        if (ctx && isHooked()) {
+            auto r = Reactor::GetThis();
+            r->delEvent(fd, ReactorEvent::READ);
+            r->delEvent(fd, ReactorEvent::WRITE);
+            r->delEvent(fd, ReactorEvent::ERROR);
+            // poll 的等待者醒来后再检查一次，得到 POLLNVAL
+            r->triggerPollCallbacks(fd);
+        }
+        FdMgr::GetInstance().del(fd);
+    }
 }
 
 
@@ -170,6 +327,146 @@ extern "C" {
         return 0;
     }
 
+    int usleep(useconds_t usec) {
+        if (!zy::isHooked()) {
+            return usleep_f(usec);
+        }
+
+        auto fiber = zy::Fiber::GetThis();
+        auto r = zy::Reactor::GetThis();
+        r->addTimerUs(usec, [fiber, r](){
+            r->addTask(fiber);
+        });
+        fiber->yield();
+        return 0;
+    }
+
+    int nanosleep(const struct timespec *req, struct timespec *rem) {
+        if (!zy::isHooked()) {
+            return nanosleep_f(req, rem);
+        }
+        if (!req || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= 1000000000) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        // 向上取整到微秒，不会比请求的时间短
+        uint64_t usec = req->tv_sec * 1000000ull + (req->tv_nsec + 999) / 1000;
+        auto fiber = zy::Fiber::GetThis();
+        auto r = zy::Reactor::GetThis();
+        r->addTimerUs(usec, [fiber, r](){
+            r->addTask(fiber);
+        });
+        fiber->yield();
+        if (rem) {
+            rem->tv_sec = 0;
+            rem->tv_nsec = 0;
+        }
+        return 0;
+    }
+
+    int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+        if (!zy::isHooked()) {
+            return poll_f(fds, nfds, timeout);
+        }
+        return zy::do_poll(fds, nfds, timeout);
+    }
+
+    int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout) {
+        if (!zy::isHooked()) {
+            return select_f(nfds, readfds, writefds, exceptfds, timeout);
+        }
+
+        // 转换成 poll，超时时间向上取整到毫秒
+        std::vector<struct pollfd> fds;
+        for (int fd = 0; fd < nfds; ++fd) {
+            short events = 0;
+            if (readfds && FD_ISSET(fd, readfds)) {
+                events |= POLLIN;
+            }
+            if (writefds && FD_ISSET(fd, writefds)) {
+                events |= POLLOUT;
+            }
+            if (exceptfds && FD_ISSET(fd, exceptfds)) {
+                events |= POLLPRI;
+            }
+            if (events) {
+                fds.push_back({fd, events, 0});
+            }
+        }
+        int timeout_ms = timeout ? static_cast<int>(timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000) : -1;
+        uint64_t begin = zy::Clock::NowMs();
+        int n = zy::do_poll(fds.data(), fds.size(), timeout_ms);
+        if (n < 0) {
+            return n;
+        }
+
+        int count = 0;
+        if (readfds) {
+            FD_ZERO(readfds);
+        }
+        if (writefds) {
+            FD_ZERO(writefds);
+        }
+        if (exceptfds) {
+            FD_ZERO(exceptfds);
+        }
+        for (auto &pfd : fds) {
+            if (pfd.revents & POLLNVAL) {
+                errno = EBADF;
+                return -1;
+            }
+            if ((pfd.events & POLLIN) && (pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+                FD_SET(pfd.fd, readfds);
+                ++count;
+            }
+            if ((pfd.events & POLLOUT) && (pfd.revents & (POLLOUT | POLLERR))) {
+                FD_SET(pfd.fd, writefds);
+                ++count;
+            }
+            if ((pfd.events & POLLPRI) && (pfd.revents & POLLPRI)) {
+                FD_SET(pfd.fd, exceptfds);
+                ++count;
+            }
+        }
+        // Linux 的 select 会把超时时间改为剩余的时间
+        if (timeout) {
+            uint64_t elapsed = zy::Clock::NowMs() - begin;
+            uint64_t left = static_cast<uint64_t>(timeout_ms) > elapsed ? timeout_ms - elapsed : 0;
+            timeout->tv_sec = static_cast<time_t>(left / 1000);
+            timeout->tv_usec = static_cast<suseconds_t>(left % 1000 * 1000);
+        }
+        return count;
+    }
+
+    // 用户自己的 epoll fd 有事件就绪时可读，把它当作一个普通 fd 交给反应堆等待
+    int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+        if (!zy::isHooked()) {
+            return epoll_wait_f(epfd, events, maxevents, timeout);
+        }
+
+        uint64_t deadline = timeout >= 0 ? zy::Clock::NowMs() + timeout : ~0ull;
+        while (true) {
+            int n = epoll_wait_f(epfd, events, maxevents, 0);
+            if (n != 0 || timeout == 0) {
+                return n;
+            }
+            int left = -1;
+            if (deadline != ~0ull) {
+                uint64_t now = zy::Clock::NowMs();
+                if (now >= deadline) {
+                    return 0;
+                }
+                left = static_cast<int>(deadline - now);
+            }
+            struct pollfd pfd = {epfd, POLLIN, 0};
+            int rt = zy::do_poll(&pfd, 1, left);
+            if (rt <= 0) {
+                return rt;
+            }
+        }
+    }
+
     int socket(int domain, int type, int protocol) {
         if (!zy::isHooked()) {
             return socket_f(domain, type, protocol);
@@ -182,6 +479,15 @@ extern "C" {
         return fd;
     }
 
+    int socketpair(int domain, int type, int protocol, int sv[2]) {
+        int rt = socketpair_f(domain, type, protocol, sv);
+        if (rt == 0 && zy::isHooked()) {
+            zy::FdMgr::GetInstance().get(sv[0], true);
+            zy::FdMgr::GetInstance().get(sv[1], true);
+        }
+        return rt;
+    }
+
     int connect(int sockfd, const struct sockaddr *addr, socklen_t addlen) {
         if (!zy::isHooked()) {
             return connect_f(sockfd, addr, addlen);
@@ -197,15 +503,26 @@ extern "C" {
         }
 
         // 执行到这里是 -- 用户没有设置非阻塞的 socket 文件描述符
-        // 获得 socket 文件描述符的超时事件，没有设置结果为 0
-        timeval tv{};
-        socklen_t len = sizeof tv;
-        getsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv, &len);
-        uint64_t timeout = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        // 连接使用发送超时，没有设置结果为 0
+        uint64_t timeout = ctx->getTimeout(SO_SNDTIMEO);
 
         int n = connect_f(sockfd, addr, addlen);
         if (n == 0) {                                   // 连接成功
             return 0;
+        } else if (n == -1 && errno == EAGAIN && addr->sa_family == AF_UNIX) {
+            // Unix 域套接字在对端的监听队列满时返回 EAGAIN 而不是 EINPROGRESS，没有事件可以等待，退避一段时间后重试
+            uint64_t deadline = timeout ? zy::Clock::NowMs() + timeout : 0;
+            useconds_t backoff = 1000;
+            while (n == -1 && errno == EAGAIN) {
+                if (deadline && zy::Clock::NowMs() >= deadline) {
+                    errno = ETIMEDOUT;
+                    return -1;
+                }
+                usleep(backoff);
+                backoff = std::min<useconds_t>(backoff * 2, 64 * 1000);
+                n = connect_f(sockfd, addr, addlen);
+            }
+            return n;
         } else if (n == -1 && errno != EINPROGRESS) {   // 连接失败
             // connect 被信号中断之后不能再次 connect，需要返回错误，这也是 connect 函数不能归类到 do_io 的原因
             return -1;
@@ -213,41 +530,10 @@ extern "C" {
 
         // 立即返回了，但是没有连接成功
         // n == -1 && errno == EINPROGRESS，表示连接还在进行中
-        auto r = zy::Reactor::GetThis();
-        std::shared_ptr<zy::TimerInfo> shared_info(new zy::TimerInfo);
-        std::weak_ptr<zy::TimerInfo> weak_info(shared_info);              // 指向 shared_info 但不增加引用计数
-
-        zy::Timer::ptr clock;
-        if (timeout != 0) {
-            clock = r->addCondTimer(timeout, [r, weak_info, sockfd](){
-                auto t = weak_info.lock();
-                if (t) {
-                    t->canceled = ETIMEDOUT;
-                }
-                // 删除前触发一次，使添加该定时器的协程可以 resume
-                r->delEvent(sockfd, zy::ReactorEvent::WRITE, true);
-            }, weak_info);
-        }
-
-
-        bool rt = r->addEvent(sockfd, zy::ReactorEvent::WRITE);
-        if (rt) {
-            zy::Fiber::GetThis()->yield();
-            // resume 有两种可能：定时器超时，写事件到来
-            // 1. 超时之后返回错误
-            if (shared_info->canceled) {
-                errno = shared_info->canceled;
-                return -1;
-            }
-            // 2. 没有超时，是由于事件发生返回的，所以取消定时器
-            if (clock) {
-                clock->cancel();
-            }
-        } else {
-            // 添加写事件出错
-            if (clock) {
-                clock->cancel();
-            }
+        // 等待写事件，超时之后返回错误
+        if (!zy::Reactor::GetThis()->waitEvent(sockfd, zy::ReactorEvent::WRITE, timeout)
+            && errno == ETIMEDOUT) {
+            return -1;
         }
 
         // 执行到这里是 -- connect 连接成功或者添加写事件失败
@@ -274,20 +560,73 @@ extern "C" {
         return fd;
     }
 
+    int accept4(int sockfd, struct sockaddr *addr, socklen_t *addlen, int flags) {
+        ssize_t rt = zy::do_io(sockfd, accept4_f,
+                                zy::ReactorEvent::READ, SO_RCVTIMEO, addr, addlen, flags);
+        int fd = static_cast<int>(rt);
+        if (fd >= 0) {
+            // SOCK_NONBLOCK 在初始化上下文时识别为用户设置的非阻塞
+            zy::FdMgr::GetInstance().get(fd, true);
+        }
+        return fd;
+    }
+
     int close(int fd) {
         if (!zy::isHooked()) {
             return close_f(fd);
         }
-        auto ctx = zy::FdMgr::GetInstance().get(fd);
-        if (ctx) {
-            auto r = zy::Reactor::GetThis();
-            r->delEvent(fd, zy::ReactorEvent::READ);
-            r->delEvent(fd, zy::ReactorEvent::WRITE);
-        }
-        zy::FdMgr::GetInstance().del(fd);
+        zy::release_fd(fd);
         return close_f(fd);
     }
 
+    // region # dup and pipe 系列函数
+    int dup(int oldfd) {
+        int fd = dup_f(oldfd);
+        if (fd >= 0) {
+            zy::dup_context(oldfd, fd);
+        }
+        return fd;
+    }
+
+    int dup2(int oldfd, int newfd) {
+        int fd = dup2_f(oldfd, newfd);
+        if (fd >= 0 && oldfd != newfd) {
+            // newfd 被隐式关闭了，成功之后才丢弃它原来的上下文，失败时 newfd 保持原样
+            zy::release_fd(fd);
+            zy::dup_context(oldfd, fd);
+        }
+        return fd;
+    }
+
+    int dup3(int oldfd, int newfd, int flags) {
+        int fd = dup3_f(oldfd, newfd, flags);
+        if (fd >= 0) {
+            zy::release_fd(fd);
+            zy::dup_context(oldfd, fd);
+        }
+        return fd;
+    }
+
+    int pipe(int pipefd[2]) {
+        int rt = pipe_f(pipefd);
+        if (rt == 0 && zy::isHooked()) {
+            zy::FdMgr::GetInstance().get(pipefd[0], true);
+            zy::FdMgr::GetInstance().get(pipefd[1], true);
+        }
+        return rt;
+    }
+
+    int pipe2(int pipefd[2], int flags) {
+        int rt = pipe2_f(pipefd, flags);
+        if (rt == 0 && zy::isHooked()) {
+            // O_NONBLOCK 在初始化上下文时识别为用户设置的非阻塞
+            zy::FdMgr::GetInstance().get(pipefd[0], true);
+            zy::FdMgr::GetInstance().get(pipefd[1], true);
+        }
+        return rt;
+    }
+    // endregion
+
     // region # read and write 系列函数
     ssize_t read(int fd, void *buf, size_t count) {
         return zy::do_io(fd, read_f, zy::ReactorEvent::READ, SO_RCVTIMEO, buf, count);
@@ -311,15 +650,34 @@ extern "C" {
         return zy::do_io(sockfd, recvmsg_f, zy::ReactorEvent::READ, SO_RCVTIMEO, msg, flags);
     }
 
+    // 一个数据报都没有时挂起等待，有数据之后与原始调用一样，timeout 只在读到第一个数据报之后起作用
+    int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout) {
+        return static_cast<int>(zy::do_io(sockfd, recvmmsg_f, zy::ReactorEvent::READ, SO_RCVTIMEO,
+                                          msgvec, vlen, flags, timeout));
+    }
+
     ssize_t write(int fd, const void *buf, size_t count) {
+        if (zy::is_no_sigpipe(fd)) {
+            return zy::do_io(fd, send_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO, buf, count, MSG_NOSIGNAL);
+        }
         return zy::do_io(fd, write_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO, buf, count);
     }
 
     ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+        if (zy::is_no_sigpipe(fd)) {
+            struct msghdr msg{};
+            msg.msg_iov = const_cast<struct iovec *>(iov);
+            msg.msg_iovlen = iovcnt;
+            return zy::do_io(fd, sendmsg_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO,
+                             const_cast<const struct msghdr *>(&msg), MSG_NOSIGNAL);
+        }
         return zy::do_io(fd, writev_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO, iov, iovcnt);
     }
 
     ssize_t send(int sockfd, const void *buf, size_t len, int flags) {
+        if (zy::is_no_sigpipe(sockfd)) {
+            flags |= MSG_NOSIGNAL;
+        }
         return zy::do_io(sockfd, send_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO, buf, len, flags);
     }
 
@@ -330,10 +688,56 @@ extern "C" {
     }
 
     ssize_t sendmsg(int socket, const struct msghdr *msg, int flags) {
+        if (zy::is_no_sigpipe(socket)) {
+            flags |= MSG_NOSIGNAL;
+        }
         return zy::do_io(socket, sendmsg_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO, msg, flags);
     }
+
+    int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+        return static_cast<int>(zy::do_io(sockfd, sendmmsg_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO,
+                                          msgvec, vlen, flags));
+    }
+
+    // 等待的是输出端可写，输入端是普通文件，读取由内核直接从页缓存拷贝
+    ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+        return zy::do_io(out_fd, sendfile_f, zy::ReactorEvent::WRITE, SO_SNDTIMEO, in_fd, offset, count);
+    }
     // endregion
 
+    // hook setsockopt 的目的是把超时时间记录在文件描述符上下文中，读写时不需要再 getsockopt
+    int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen) {
+        int rt = setsockopt_f(sockfd, level, optname, optval, optlen);
+        if (rt == 0 && level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO)
+            && optlen >= sizeof(timeval)) {
+            // 不论当前线程是否 hook 都要记录，socket 可能在别的线程设置之后交给协程使用
+            auto ctx = zy::FdMgr::GetInstance().get(sockfd);
+            if (ctx) {
+                auto tv = static_cast<const timeval *>(optval);
+                ctx->setTimeout(optname, tv->tv_sec * 1000 + tv->tv_usec / 1000);
+            }
+        }
+        return rt;
+    }
+
+    // 超时时间从上下文中读取，不需要系统调用
+    int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optlen) {
+        if (zy::isHooked() && level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO)
+            && optval && optlen && *optlen >= sizeof(timeval)) {
+            auto ctx = zy::FdMgr::GetInstance().get(sockfd);
+            if (ctx && ctx->isSocket()) {
+                uint64_t timeout = ctx->getTimeout(optname);
+                timeval tv{};
+                tv.tv_sec = static_cast<time_t>(timeout / 1000);
+                tv.tv_usec = static_cast<suseconds_t>(timeout % 1000 * 1000);
+                memcpy(optval, &tv, sizeof tv);
+                *optlen = sizeof tv;
+                return 0;
+            }
+        }
+        return getsockopt_f(sockfd, level, optname, optval, optlen);
+    }
+
     // hook fcntl 的目的是使文件描述符的阻塞状态与用户所设置的一致
     int fcntl(int fd, int cmd, ...) {
         va_list va;
@@ -344,7 +748,7 @@ extern "C" {
                 va_end(va);
 
                 auto ctx = zy::FdMgr::GetInstance().get(fd);
-                if (!ctx || !ctx->init() || ctx->isClose() || !ctx->isSocket()) {
+                if (!ctx || !ctx->isInit() || !ctx->isPollable()) {
                     return fcntl_f(fd, cmd, arg);
                 }
 
@@ -361,7 +765,7 @@ extern "C" {
                 int flags = fcntl_f(fd, cmd);
 
                 auto ctx = zy::FdMgr::GetInstance().get(fd);
-                if (!ctx || !ctx->init() || ctx->isClose() || !ctx->isSocket()) {
+                if (!ctx || !ctx->isInit() || !ctx->isPollable()) {
                     return flags;
                 }
 
@@ -2,6 +2,12 @@
 #define __ZY_HOOK_H__
 
 #include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <unistd.h>
+#include <ctime>
 
 namespace zy {
     /**
@@ -27,19 +33,58 @@ extern "C" {
 typedef unsigned int (*sleep_fun)(unsigned int seconds);
 extern sleep_fun sleep_f;
 
+typedef int (*usleep_fun)(useconds_t usec);
+extern usleep_fun usleep_f;
+
+typedef int (*nanosleep_fun)(const struct timespec *req, struct timespec *rem);
+extern nanosleep_fun nanosleep_f;
+
+/// 多路复用系列函数
+typedef int (*poll_fun)(struct pollfd *fds, nfds_t nfds, int timeout);
+extern poll_fun poll_f;
+
+typedef int (*select_fun)(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+                          struct timeval *timeout);
+extern select_fun select_f;
+
+typedef int (*epoll_wait_fun)(int epfd, struct epoll_event *events, int maxevents, int timeout);
+extern epoll_wait_fun epoll_wait_f;
+
 /// socket 系列函数
 typedef int (*socket_fun)(int domain, int type, int protocol);
 extern socket_fun socket_f;
 
+typedef int (*socketpair_fun)(int domain, int type, int protocol, int sv[2]);
+extern socketpair_fun socketpair_f;
+
 typedef int (*connect_fun)(int sockfd, const struct sockaddr *addr, socklen_t addlen);
 extern connect_fun connect_f;
 
 typedef int (*accept_fun)(int sockfd, struct sockaddr *addr, socklen_t *addlen);
 extern accept_fun accept_f;
 
+typedef int (*accept4_fun)(int sockfd, struct sockaddr *addr, socklen_t *addlen, int flags);
+extern accept4_fun accept4_f;
+
 typedef int (*close_fun)(int fd);
 extern close_fun close_f;
 
+/// 复制文件描述符、管道
+typedef int (*dup_fun)(int oldfd);
+extern dup_fun dup_f;
+
+typedef int (*dup2_fun)(int oldfd, int newfd);
+extern dup2_fun dup2_f;
+
+typedef int (*dup3_fun)(int oldfd, int newfd, int flags);
+extern dup3_fun dup3_f;
+
+typedef int (*pipe_fun)(int pipefd[2]);
+extern pipe_fun pipe_f;
+
+typedef int (*pipe2_fun)(int pipefd[2], int flags);
+extern pipe2_fun pipe2_f;
+
 /// read 系列函数
 typedef ssize_t (*read_fun)(int fd, void *buf, size_t count);
 extern read_fun read_f;
@@ -57,6 +102,10 @@ extern recvfrom_fun recvfrom_f;
 typedef ssize_t (*recvmsg_fun)(int sockfd, struct msghdr *msg, int flags);
 extern recvmsg_fun recvmsg_f;
 
+typedef int (*recvmmsg_fun)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                            struct timespec *timeout);
+extern recvmmsg_fun recvmmsg_f;
+
 /// write 系列函数
 typedef ssize_t (*write_fun)(int fd, const void *buf, size_t count);
 extern write_fun write_f;
@@ -74,9 +123,22 @@ extern sendto_fun sendto_f;
 typedef ssize_t (*sendmsg_fun)(int socket, const struct msghdr *msg, int flags);
 extern sendmsg_fun sendmsg_f;
 
+typedef int (*sendmmsg_fun)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+extern sendmmsg_fun sendmmsg_f;
+
+typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t *offset, size_t count);
+extern sendfile_fun sendfile_f;
+
 /// fcntl
 typedef int (*fcntl_fun)(int fd, int cmd, ...);
 extern fcntl_fun fcntl_f;
 
+/// socket 选项
+typedef int (*setsockopt_fun)(int sockfd, int level, int optname, const void *optval, socklen_t optlen);
+extern setsockopt_fun setsockopt_f;
+
+typedef int (*getsockopt_fun)(int sockfd, int level, int optname, void *optval, socklen_t *optlen);
+extern getsockopt_fun getsockopt_f;
+
 }
 #endif //ZY_HOOK_H
@@ -8,6 +8,9 @@
 #include <utility>
 #include <functional>
 #include <iostream>
+#include "hook.h"
+#include "scheduler.h"
+#include "file_io.h"
 
 namespace zy {
     std::string LogLevel::ToString(LogLevel::Level level) {
@@ -335,7 +338,24 @@ namespace zy {
         return os;
     }
 
+    /**
+     * @brief 在作用域内关闭当前线程的 hook
+     * @details 输出地持有自旋锁写文件，hook 后的 write 遇到普通文件会挂起协程，持锁挂起会让同一线程的其他协程在锁上死等
+     */
+    struct UnhookedScope {
+        UnhookedScope() : hooked_(isHooked()) {
+            setHooked(false);
+        }
+
+        ~UnhookedScope() {
+            setHooked(hooked_);
+        }
+
+        bool hooked_;
+    };
+
     void StdoutLogAppender::log(LogEvent::ptr event) {
+        UnhookedScope unhooked;
         SpinLock::Lock lock(mutex_);
         formatter_->format(std::cout, event);
     }
@@ -344,33 +364,66 @@ namespace zy {
     FileLogAppender::FileLogAppender(std::string filename)
         : LogAppender(std::make_shared<LogFormatter>())
         , filename_(std::move(filename)), reopen_error_(false)
-        , last_open_time_(0) {
+        , last_open_time_(Clock::WallSeconds()), flushing_(false) {
         reopen();
     }
     // endregion
 
     bool FileLogAppender::reopen() {
-        SpinLock::Lock lock(mutex_);
         if (filestream_) {
             filestream_.close();
         }
-        filestream_.open(filename_);
+        // 追加模式，重开时不能清空已经写入的日志
+        filestream_.open(filename_, std::ios::app);
         reopen_error_ = !filestream_;
         return !reopen_error_;
     }
 
     void FileLogAppender::log(LogEvent::ptr event) {
-        // 如果一个文件打开超过 3 秒就重新打开一次，确保日志文件可以正常写入
-        uint64_t now = event->getTime();
-        if (now > last_open_time_ + 3) {
-            reopen();
-            last_open_time_ = now;
+        // 格式化不需要持锁
+        std::stringstream ss;
+        formatter_->format(ss, event);
+        {
+            SpinLock::Lock lock(mutex_);
+            buffer_.append(ss.str());
+            if (flushing_) {
+                return;                 // 正在刷盘的任务会把这一条一起写出去
+            }
+            flushing_ = true;
         }
-        if (reopen_error_) {
-            return;
+
+        if (Scheduler::IsInTask()) {
+            FileIOMgr::GetInstance().post(std::bind(&FileLogAppender::flush, shared_from_this()));
+        } else {
+            flush();
+        }
+    }
+
+    void FileLogAppender::flush() {
+        UnhookedScope unhooked;
+        std::string buffer;
+        while (true) {
+            {
+                SpinLock::Lock lock(mutex_);
+                if (buffer_.empty()) {
+                    flushing_ = false;
+                    return;
+                }
+                buffer.swap(buffer_);
+            }
+
+            // 如果一个文件打开超过 3 秒就重新打开一次，确保日志文件被删除或轮转后可以继续写入
+            uint64_t now = Clock::WallSeconds();
+            if (now > last_open_time_ + 3) {
+                reopen();
+                last_open_time_ = now;
+            }
+            if (!reopen_error_) {
+                filestream_ << buffer;
+                filestream_.flush();
+            }
+            buffer.clear();
         }
-        SpinLock::Lock lock(mutex_);
-        formatter_->format(filestream_, event);
     }
 
     // region # Logger::Logger()
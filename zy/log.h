@@ -11,6 +11,7 @@
 #include "utils/singleton.h"
 #include "utils/mutex.h"
 #include "utils/util.h"
+#include "clock.h"
 
 // region # 宏定义获取日志器
 #define ZY_LOG_ROOT() LoggerMgr::GetInstance().getRootLogger()
@@ -27,7 +28,7 @@
                              new zy::LogEvent(level, (logger)->getLoggerName(),                           \
                                  __FILE__, __FUNCTION__, __LINE__,                                          \
                                  zy::getThreadName(), zy::getElapseMs() - (logger)->getCreateTime(),    \
-                                 time(nullptr), zy::getThreadId(), zy::getFiberId()                     \
+                                 zy::Clock::WallSeconds(), zy::getThreadId(), zy::getFiberId()                     \
                              )                                                                              \
                                 )).getLogEvent()->getMessageStream()                                        \
 
@@ -49,7 +50,7 @@
                     new LogEvent(level, (logger)->getLoggerName(),                                  \
                                  __FILE__, __FUNCTION__, __LINE__,                                  \
                                  getThreadName(), getElapseMs() - (logger)->getCreateTime(),        \
-                                 time(nullptr), getThreadId(), getFiberId()                         \
+                                 zy::Clock::WallSeconds(), getThreadId(), getFiberId()                         \
                              )                                                                      \
                                 )).getLogEvent()->Print(fmt, __VA_ARGS__);                          \
 
@@ -322,8 +323,10 @@ namespace zy {
 
     /**
      * @brief 文件输出地
+     * @details 日志先格式化到内存缓冲区，由 FileIOPool 的线程写入文件，任务协程打印日志时不会阻塞在磁盘上。
+     * 同一时刻只有一个刷盘任务，缓冲区按顺序写出，日志不会乱序。不在任务协程中时直接在当前线程刷盘。
      */
-    class FileLogAppender : public LogAppender {
+    class FileLogAppender : public LogAppender, public std::enable_shared_from_this<FileLogAppender> {
     public:
         /**
          * @brief 构造函数
@@ -333,13 +336,19 @@ namespace zy {
         explicit FileLogAppender(std::string filename);
 
         /**
-         * @brief 重写父类的 log 方法，实现往标准输出打印日志
+         * @brief 重写父类的 log 方法，实现往文件打印日志
          * @param event 日志现场
          */
         void log(LogEvent::ptr event) override;
 
+    private:
+        /**
+         * @brief 把缓冲区写入文件，直到缓冲区为空
+         */
+        void flush();
+
         /**
-         * @brief 文件超时重开
+         * @brief 文件超时重开，只在刷盘时调用
          * @return 操作是否出错
          */
         bool reopen();
@@ -347,12 +356,16 @@ namespace zy {
     private:
         /// 保存日志的文件名
         std::string filename_;
-        /// 文件输出流
+        /// 文件输出流，只有刷盘任务会访问
         std::ofstream filestream_;
         /// 文件重开是否出错
         bool reopen_error_;
-        /// 上一次打开文件的时间
+        /// 上一次打开文件的时间，秒
         uint64_t last_open_time_;
+        /// 等待写入文件的日志
+        std::string buffer_;
+        /// 是否已经有刷盘任务
+        bool flushing_;
     };
 
     /**
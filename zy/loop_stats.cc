@@ -0,0 +1,144 @@
+#include "loop_stats.h"
+
+#include <sstream>
+#include "clock.h"
+#include "utils/util.h"
+
+namespace zy {
+
+std::atomic<bool> LoopStats::s_enabled{false};
+
+// 当前线程的统计对象，所有权在 LoopStatsManager 中，线程退出后统计仍然可以被抓取
+static thread_local LoopStats *t_loop_stats = nullptr;
+
+Histogram::Histogram() {
+    reset();
+}
+
+void Histogram::record(uint64_t value) {
+    int index = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    if (index >= BUCKETS) {
+        index = BUCKETS - 1;
+    }
+    // 单写者，不需要 fetch_add
+    buckets_[index].store(buckets_[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value > max_.load(std::memory_order_relaxed)) {
+        max_.store(value, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::reset() {
+    for (auto &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::BucketBound(int index) {
+    if (index >= BUCKETS - 1) {
+        return ~0ull;
+    }
+    return index == 0 ? 0 : (1ull << index) - 1;
+}
+
+LoopStats::LoopStats(std::string thread_name, uint32_t tid)
+    : thread_name_(std::move(thread_name)), tid_(tid) {
+}
+
+void LoopStats::reset() {
+    for (auto &histogram : histograms_) {
+        histogram.reset();
+    }
+}
+
+std::ostream &LoopStats::dump(std::ostream &os, Metric metric) const {
+    const Histogram &h = histograms_[metric];
+    std::string name = std::string("zy_loop_") + MetricName(metric);
+    std::stringstream labels;
+    labels << "thread=\"" << thread_name_ << "\",tid=\"" << tid_ << "\"";
+
+    // Prometheus 的桶是累计值
+    uint64_t cumulative = 0;
+    for (int i = 0; i < Histogram::BUCKETS - 1; ++i) {
+        cumulative += h.getBucket(i);
+        os << name << "_bucket{" << labels.str() << ",le=\"" << Histogram::BucketBound(i) << "\"} "
+           << cumulative << "\n";
+    }
+    os << name << "_bucket{" << labels.str() << ",le=\"+Inf\"} " << h.getCount() << "\n";
+    os << name << "_sum{" << labels.str() << "} " << h.getSum() << "\n";
+    os << name << "_count{" << labels.str() << "} " << h.getCount() << "\n";
+    return os;
+}
+
+const char *LoopStats::MetricName(Metric metric) {
+    switch (metric) {
+#define XX(name, str) case name: return str;
+        XX(EPOLL_WAIT_US, "epoll_wait_us")
+        XX(EVENTS_PER_WAKEUP, "events_per_wakeup")
+        XX(TIMERS_PER_TICK, "timers_per_tick")
+        XX(QUEUE_DELAY_US, "queue_delay_us")
+        XX(TASK_RUN_US, "task_run_us")
+#undef XX
+        default:
+            return "unknown";
+    }
+}
+
+LoopStats *LoopStats::GetThis() {
+    if (!t_loop_stats) {
+        LoopStats::ptr stats(new LoopStats(zy::getThreadName(), zy::getThreadId()));
+        LoopStatsMgr::GetInstance().add(stats);
+        t_loop_stats = stats.get();
+    }
+    return t_loop_stats;
+}
+
+uint64_t LoopStats::NowUs() {
+    return Clock::NowUs();
+}
+
+void LoopStatsManager::add(const LoopStats::ptr &stats) {
+    Mutex::Lock lock(mutex_);
+    stats_.push_back(stats);
+}
+
+std::vector<LoopStats::ptr> LoopStatsManager::getAll() {
+    Mutex::Lock lock(mutex_);
+    return stats_;
+}
+
+void LoopStatsManager::reset() {
+    for (auto &stats : getAll()) {
+        stats->reset();
+    }
+}
+
+std::ostream &LoopStatsManager::dump(std::ostream &os) {
+    auto all = getAll();
+    for (int i = 0; i < LoopStats::METRIC_NUM; ++i) {
+        auto metric = static_cast<LoopStats::Metric>(i);
+        os << "# TYPE zy_loop_" << LoopStats::MetricName(metric) << " histogram\n";
+        for (auto &stats : all) {
+            stats->dump(os, metric);
+        }
+        // 最大值单独作为 gauge 输出，TASK_RUN_US 的最大值即最长一次未 yield 的任务运行时间
+        os << "# TYPE zy_loop_" << LoopStats::MetricName(metric) << "_max gauge\n";
+        for (auto &stats : all) {
+            os << "zy_loop_" << LoopStats::MetricName(metric) << "_max{thread=\"" << stats->getThreadName()
+               << "\",tid=\"" << stats->getTid() << "\"} " << stats->getHistogram(metric).getMax() << "\n";
+        }
+    }
+    return os;
+}
+
+std::string LoopStatsManager::toString() {
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+}
@@ -0,0 +1,207 @@
+#ifndef __ZY_LOOP_STATS_H__
+#define __ZY_LOOP_STATS_H__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ostream>
+#include "utils/mutex.h"
+#include "utils/singleton.h"
+
+namespace zy {
+
+/**
+ * @brief 按 2 的幂分桶的直方图
+ * @details 第 i 个桶统计落在 [2^(i-1), 2^i) 内的值，第 0 个桶只统计 0，超出范围的值计入最后一个桶。
+ * 每个直方图只由所属线程写入，所以写入时使用 relaxed 的 load + store，不需要原子读改写；抓取线程读到的是近似值。
+ */
+class Histogram {
+public:
+    /// 桶的数量，最后一个桶的上界为 2^(BUCKETS - 2)
+    static const int BUCKETS = 26;
+
+    Histogram();
+
+    /**
+     * @brief 记录一个值，只能由所属线程调用
+     * @param value 值
+     */
+    void record(uint64_t value);
+
+    /**
+     * @brief 清空所有统计
+     */
+    void reset();
+
+    /**
+     * @brief 获取桶的上界（包含）
+     * @param index 桶下标
+     * @return 上界，最后一个桶返回 ~0ull
+     */
+    static uint64_t BucketBound(int index);
+
+    // region # Getter
+    uint64_t getBucket(int index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    uint64_t getCount() const { return count_.load(std::memory_order_relaxed); }
+
+    uint64_t getSum() const { return sum_.load(std::memory_order_relaxed); }
+
+    uint64_t getMax() const { return max_.load(std::memory_order_relaxed); }
+    // endregion
+
+private:
+    std::atomic<uint64_t> buckets_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+/**
+ * @brief 单个调度线程的事件循环统计
+ */
+class LoopStats {
+public:
+    using ptr = std::shared_ptr<LoopStats>;
+
+    /**
+     * @brief 统计项
+     */
+    enum Metric {
+        /// 阻塞在 epoll_wait 中的时间，微秒
+        EPOLL_WAIT_US,
+        /// 每次从 epoll_wait 返回时的就绪事件数量
+        EVENTS_PER_WAKEUP,
+        /// 每轮循环处理的超时定时器数量
+        TIMERS_PER_TICK,
+        /// 任务从加入任务队列（如 IO 就绪）到被 resume 的等待时间，微秒
+        QUEUE_DELAY_US,
+        /// 任务一次 resume 到 yield 之间连续运行的时间，微秒
+        TASK_RUN_US,
+        METRIC_NUM,
+    };
+
+    /**
+     * @brief 构造函数
+     * @param thread_name 线程名
+     * @param tid 线程 id
+     */
+    LoopStats(std::string thread_name, uint32_t tid);
+
+    /**
+     * @brief 记录一个统计值
+     * @param metric 统计项
+     * @param value 值
+     */
+    void record(Metric metric, uint64_t value) { histograms_[metric].record(value); }
+
+    /**
+     * @brief 清空所有统计
+     */
+    void reset();
+
+    /**
+     * @brief 以 Prometheus 文本格式输出一个统计项的样本行，不含 # TYPE 行
+     * @param os 输出流
+     * @param metric 统计项
+     * @return 输出流
+     */
+    std::ostream &dump(std::ostream &os, Metric metric) const;
+
+    // region # Getter
+    const Histogram &getHistogram(Metric metric) const { return histograms_[metric]; }
+
+    const std::string &getThreadName() const { return thread_name_; }
+
+    uint32_t getTid() const { return tid_; }
+    // endregion
+
+    /**
+     * @brief 统计项名称
+     * @param metric 统计项
+     * @return 名称
+     */
+    static const char *MetricName(Metric metric);
+
+    /**
+     * @brief 获取当前线程的统计对象，第一次调用时创建并注册到 LoopStatsManager
+     * @return 当前线程的统计对象
+     */
+    static LoopStats *GetThis();
+
+    /**
+     * @brief 统计是否开启，关闭时各个统计点只有一次 relaxed load 的开销
+     * @return 是否开启
+     */
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 开启或关闭统计
+     * @param flag 是否开启
+     */
+    static void SetEnabled(bool flag) { s_enabled.store(flag, std::memory_order_relaxed); }
+
+    /**
+     * @brief 统计使用的单调时钟
+     * @return 微秒
+     */
+    static uint64_t NowUs();
+
+private:
+    /// 线程名
+    std::string thread_name_;
+    /// 线程 id
+    uint32_t tid_;
+    /// 各统计项的直方图
+    Histogram histograms_[METRIC_NUM];
+    /// 统计开关，默认关闭
+    static std::atomic<bool> s_enabled;
+};
+
+/**
+ * @brief 统计对象管理类，供监控抓取所有线程的统计
+ */
+class LoopStatsManager {
+public:
+    /**
+     * @brief 注册一个线程的统计对象
+     * @param stats 统计对象
+     */
+    void add(const LoopStats::ptr &stats);
+
+    /**
+     * @brief 获取所有线程的统计对象
+     * @return 统计对象数组
+     */
+    std::vector<LoopStats::ptr> getAll();
+
+    /**
+     * @brief 清空所有线程的统计
+     */
+    void reset();
+
+    /**
+     * @brief 以 Prometheus 文本格式输出所有线程的统计
+     * @param os 输出流
+     * @return 输出流
+     */
+    std::ostream &dump(std::ostream &os);
+
+    /**
+     * @brief 以 Prometheus 文本格式输出所有线程的统计
+     * @return 字符串
+     */
+    std::string toString();
+
+private:
+    Mutex mutex_;
+    std::vector<LoopStats::ptr> stats_;
+};
+
+/// 统计对象管理类的单例
+using LoopStatsMgr = Singleton<LoopStatsManager>;
+
+}
+
+#endif //__ZY_LOOP_STATS_H__
@@ -1,18 +1,27 @@
 #include "reactor.h"
 
 #include <utility>
+#include <algorithm>
 #include <unistd.h>
 #include <cstring>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <iostream>
 #include "log.h"
+#include "clock.h"
+#include "hook.h"
 #include "utils/macro.h"
 #include <signal.h>
 
 namespace zy {
 
-Channel::Channel(int fd, ReactorEvent::Event event) : fd_(fd), event_(event) {}
+Channel::Channel(int fd, ReactorEvent::Event event) : fd_(fd), event_(event) {
+    read_timeout_.channel_ = this;
+    read_timeout_.event_ = ReactorEvent::READ;
+    write_timeout_.channel_ = this;
+    write_timeout_.event_ = ReactorEvent::WRITE;
+}
 
 Channel::EventCallback &Channel::getEventCallback(ReactorEvent::Event event) {
     switch (event) {
@@ -20,11 +29,24 @@ Channel::EventCallback &Channel::getEventCallback(ReactorEvent::Event event) {
             return read_;
         case ReactorEvent::WRITE:
             return write_;
+        case ReactorEvent::ERROR:
+            return error_;
         default:
             ZY_ASSERT2(false, "getEventCallback")
     }
 }
 
+Channel::EventTimeout &Channel::getEventTimeout(ReactorEvent::Event event) {
+    switch (event) {
+        case ReactorEvent::READ:
+            return read_timeout_;
+        case ReactorEvent::WRITE:
+            return write_timeout_;
+        default:
+            ZY_ASSERT2(false, "getEventTimeout")
+    }
+}
+
 void Channel::resetEventCallback(Channel::EventCallback &event_callback) {
     event_callback.scheduler_ = nullptr;
     event_callback.fiber_.reset();
@@ -43,11 +65,37 @@ void Channel::triggerEvent(ReactorEvent::Event event) {
     resetEventCallback(callback);
 }
 
+uint32_t Channel::getPollEvents(uint32_t except) const {
+    uint32_t events = ReactorEvent::NONE;
+    for (const PollCallback &callback : poll_callbacks_) {
+        if (!(callback.events_ & except)) {
+            events |= callback.events_;
+        }
+    }
+    return events;
+}
+
+size_t Channel::triggerPollCallbacks(uint32_t events) {
+    size_t count = 0;
+    for (auto it = poll_callbacks_.begin(); it != poll_callbacks_.end();) {
+        if (it->events_ & events) {
+            it->scheduler_->addTask(it->func_);
+            it = poll_callbacks_.erase(it);
+            ++count;
+        } else {
+            ++it;
+        }
+    }
+    return count;
+}
+
 Reactor::Reactor(std::string name, uint32_t thread_num, bool use_caller)
         : Scheduler(std::move(name), thread_num, use_caller)
+        , TimerManager(TIMER_TICK_US)
         , epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
         , wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
-        , pending_event_num_(0) {
+        , pending_event_num_(0)
+        , poll_callback_id_(0) {
 
     ZY_ASSERT(epoll_fd_ != -1);
     ZY_ASSERT(wakeup_fd_ != -1);
@@ -68,6 +116,10 @@ void Reactor::channelResize(size_t size) {
     for (int i = 0; i < static_cast<int>(channels_.size()); ++i) {
         if (!channels_[i]) {
             channels_[i] = new Channel(i);
+            channels_[i]->read_timeout_.reactor_ = this;
+            channels_[i]->read_timeout_.on_expire_ = &Reactor::OnEventTimeout;
+            channels_[i]->write_timeout_.reactor_ = this;
+            channels_[i]->write_timeout_.on_expire_ = &Reactor::OnEventTimeout;
         }
     }
 }
@@ -77,41 +129,37 @@ Reactor::~Reactor() {
     stop();
     ::close(epoll_fd_);
     ::close(wakeup_fd_);
+    // 被遗弃的等待（例如 fd 在等待时被 close）可能还留在时间轮上，先全部摘下
+    clearAll();
     for (auto &channel: channels_) {
         delete channel;
     }
 }
 
-bool Reactor::addEvent(int fd, ReactorEvent::Event event, const std::function<void()> &cb) {
-    // 取出 fd 对应的 channel，如果没有则扩容
-    Channel *channel;
+Channel *Reactor::getChannel(int fd) {
     RWMutex::ReadLock lock(mutex_);
     if (static_cast<int>(channels_.size()) > fd) {
-        channel = channels_[fd];
-        lock.unlock();
-    } else {
-        lock.unlock();
-        RWMutex::WriteLock lock1(mutex_);
+        return channels_[fd];
+    }
+    lock.unlock();
+    RWMutex::WriteLock lock1(mutex_);
+    if (static_cast<int>(channels_.size()) <= fd) {
         channelResize(fd * 2);
-        channel = channels_[fd];
     }
+    return channels_[fd];
+}
+
+bool Reactor::addEvent(int fd, ReactorEvent::Event event, const std::function<void()> &cb) {
+    // 取出 fd 对应的 channel，如果没有则扩容
+    Channel *channel = getChannel(fd);
 
     // 不可以重复注册事件
     Mutex::Lock lock1(channel->mutex_);
     ZY_ASSERT(!(channel->event_ & event));
 
-    // 使用系统调用修改底层 epoll
-    epoll_event ev{};
-    memset(&ev, 0, sizeof ev);
-    ev.events = channel->event_ | event | EPOLLET;
-    ev.data.fd = fd;
-    ev.data.ptr = channel;
-    int op = channel->event_ ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
-    int rt = epoll_ctl(epoll_fd_, op, fd, &ev);
-    if (rt) {
-        ZY_LOG_ERROR(ZY_LOG_ROOT()) << "epoll_ctl(" << epoll_fd_ << ", "
-                                        << op << ", " << fd << ", " << ev.events << "):"
-                                        << rt << "(" << errno << ")(" << strerror(errno) << ")";
+    // 使用系统调用修改底层 epoll，poll 回调等待的事件也要保留
+    uint32_t registered = channel->event_ | channel->getPollEvents();
+    if (!updateEpoll(channel, registered, registered | event)) {
         return false;
     }
 
@@ -141,55 +189,175 @@ bool Reactor::delEvent(int fd, ReactorEvent::Event event, bool trigger) {
     Channel *channel = channels_[fd];
     lock.unlock();
 
-    // 不可以删除没有注册的事件
     Mutex::Lock lock1(channel->mutex_);
+    return delEvent(channel, event, trigger);
+}
+
+bool Reactor::delEvent(Channel *channel, ReactorEvent::Event event, bool trigger) {
+    // 不可以删除没有注册的事件
     if (!(channel->event_ & event)) {
         return false;
     }
 
-    // 使用系统调用修改底层 epoll
+    // 使用系统调用修改底层 epoll，poll 回调等待的事件也要保留
+    uint32_t polled = channel->getPollEvents();
+    if (!updateEpoll(channel, channel->event_ | polled, (channel->event_ & ~event) | polled)) {
+        return false;
+    }
+
+    --pending_event_num_;
+    if (trigger) {
+        channel->triggerEvent(event);
+    }
+    channel->event_ = static_cast<ReactorEvent::Event>(channel->event_ & ~event);
+    Channel::EventCallback &event_callback = channel->getEventCallback(event);
+    Channel::resetEventCallback(event_callback);
+    return true;
+}
+
+bool Reactor::updateEpoll(Channel *channel, uint32_t old_events, uint32_t new_events) {
     epoll_event ev{};
     memset(&ev, 0, sizeof ev);
-    ev.events = (channel->event_ & ~event) | EPOLLET;
-    ev.data.fd = fd;
+    ev.events = new_events | EPOLLET;
+    ev.data.fd = channel->fd_;
     ev.data.ptr = channel;
-    int op = (channel->event_ & ~event) ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-    int rt = epoll_ctl(epoll_fd_, op, fd, &ev);
+    int op = !old_events ? EPOLL_CTL_ADD : new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    int rt = epoll_ctl(epoll_fd_, op, channel->fd_, &ev);
     if (rt) {
+        if (op != EPOLL_CTL_ADD && !(new_events & ~old_events) && (errno == ENOENT || errno == EBADF)) {
+            return true;
+        }
         ZY_LOG_ERROR(ZY_LOG_ROOT()) << "epoll_ctl(" << epoll_fd_ << ", "
-                                        << op << ", " << fd << ", " << ev.events << "):"
+                                        << op << ", " << channel->fd_ << ", " << ev.events << "):"
                                         << rt << "(" << errno << ")(" << strerror(errno) << ")";
         return false;
     }
+    return true;
+}
 
+uint64_t Reactor::addPollCallback(int fd, uint32_t events, const std::function<void()> &cb) {
+    Channel *channel = getChannel(fd);
+    Mutex::Lock lock(channel->mutex_);
+    // 已经注册的事件也 MOD 一次，边缘触发重新检查就绪状态，检查之后到来的事件不会丢失
+    uint32_t registered = channel->event_ | channel->getPollEvents();
+    if (!updateEpoll(channel, registered, registered | events)) {
+        return 0;
+    }
+    ++pending_event_num_;
+    uint64_t id = ++poll_callback_id_;
+    channel->poll_callbacks_.push_back({id, events, Scheduler::GetThis(), cb});
+    return id;
+}
+
+bool Reactor::delPollCallback(int fd, uint64_t id) {
+    RWMutex::ReadLock lock(mutex_);
+    if (static_cast<int>(channels_.size()) <= fd) {
+        return false;
+    }
+    Channel *channel = channels_[fd];
+    lock.unlock();
+
+    Mutex::Lock lock1(channel->mutex_);
+    auto &callbacks = channel->poll_callbacks_;
+    auto it = std::find_if(callbacks.begin(), callbacks.end(),
+                           [id](const Channel::PollCallback &callback) { return callback.id_ == id; });
+    if (it == callbacks.end()) {
+        return false;
+    }
+    uint32_t old_events = channel->event_ | channel->getPollEvents();
+    callbacks.erase(it);
     --pending_event_num_;
-    if (trigger) {
-        channel->triggerEvent(event);
+    updateEpoll(channel, old_events, channel->event_ | channel->getPollEvents());
+    return true;
+}
+
+void Reactor::triggerPollCallbacks(int fd) {
+    RWMutex::ReadLock lock(mutex_);
+    if (static_cast<int>(channels_.size()) <= fd) {
+        return;
+    }
+    Channel *channel = channels_[fd];
+    lock.unlock();
+
+    Mutex::Lock lock1(channel->mutex_);
+    uint32_t polled = channel->getPollEvents();
+    if (!polled) {
+        return;
+    }
+    pending_event_num_ -= channel->triggerPollCallbacks(polled);
+    updateEpoll(channel, channel->event_ | polled, channel->event_);
+}
+
+bool Reactor::waitEvent(int fd, ReactorEvent::Event event, uint64_t timeout) {
+    Channel *channel = getChannel(fd);
+    Channel::EventTimeout &event_timeout = channel->getEventTimeout(event);
+    {
+        // 新的一轮等待，在注册事件之前更新状态字：上一轮还没执行完的到期处理（可能排在其他线程）
+        // 看到事件已经注册时，状态字一定已经变了，不会误判为本轮超时
+        Mutex::Lock lock(channel->mutex_);
+        event_timeout.expired_ = false;
+        event_timeout.renew();
+    }
+    if (!addEvent(fd, event)) {
+        return false;
+    }
+    // 先注册事件再挂定时器，定时器到期时事件一定已经注册，可以通过删除事件唤醒协程
+    if (timeout != 0) {
+        // 大量连接的超时时间相近，按超时时间的 1/10 合并到同一次唤醒
+        event_timeout.slack_ = std::max<uint32_t>(TimerSlack::ForTimeout(timeout), 1) * 1000;
+        // 挂到当前线程的时间轮上，不加锁
+        bindThread();
+        armNode(&event_timeout, Clock::NowUs() + timeout * 1000);
+    }
+    Fiber::GetThis()->yield();
+    // resume 有两种可能：定时器超时，注册的事件到来
+    // 到期处理持有 channel 的锁，只有在事件还在等待时才设置 expired_ 并唤醒协程，协程 resume 后 expired_ 就是确定的
+    if (timeout != 0) {
+        disarmNode(&event_timeout);
+    }
+    if (event_timeout.expired_) {
+        errno = ETIMEDOUT;
+        return false;
     }
-    channel->event_ = static_cast<ReactorEvent::Event>(channel->event_ & ~event);
-    Channel::EventCallback &event_callback = channel->getEventCallback(event);
-    Channel::resetEventCallback(event_callback);
     return true;
 }
 
+void Reactor::OnEventTimeout(TimerNode *node, uint64_t state) {
+    auto event_timeout = static_cast<Channel::EventTimeout *>(node);
+    Channel *channel = event_timeout->channel_;
+    Mutex::Lock lock(channel->mutex_);
+    // 已经开始了新的一轮等待，事件已经到来，或者等待的协程已经不在了
+    if (event_timeout->state_.load() != state
+        || !(channel->event_ & event_timeout->event_)
+        || !channel->getEventCallback(event_timeout->event_).fiber_) {
+        return;
+    }
+    event_timeout->expired_ = true;
+    // 删除前触发一次，使等待的协程可以 resume
+    event_timeout->reactor_->delEvent(channel, event_timeout->event_, true);
+}
+
 Reactor *Reactor::GetThis() {
     return dynamic_cast<Reactor *>(Scheduler::GetThis());
 }
 
 bool Reactor::stopping() {
-    uint64_t timeout = getNextTime();
     // 定时器和调度器都没有任务时才可以停止
-    return timeout == ~0ull && pending_event_num_ == 0 && Scheduler::stopping();
+    return !hasTimer() && pending_event_num_ == 0 && Scheduler::stopping();
 }
 
 void Reactor::idle() {
     static const uint32_t MAX_EVENTS = 256;
-    static const uint64_t MAX_TIMEOUT = 3000;
+    static const uint64_t MAX_TIMEOUT = 3000 * 1000;
     std::vector<epoll_event> events(MAX_EVENTS);
     bool flag = false;
+    // 成为定时器线程，之后本线程新增的定时器挂在自己的时间轮上
+    bindThread();
     while (!stopping() && !flag) {
-        // 根据定时器确定超时时间
-        uint64_t next_timeout = getNextTime();
+        // 每一轮刷新一次循环时间，本轮的定时器操作都使用它
+        Clock::UpdateLoopTime();
+        // 根据定时器确定超时时间，微秒
+        uint64_t next_timeout = getNextTimeUs();
         int event_num = 0;
         
         if (next_timeout != ~0ull) {
@@ -198,11 +366,18 @@ void Reactor::idle() {
             next_timeout = MAX_TIMEOUT;
         }
         // 阻塞等待
-        event_num = epoll_wait(epoll_fd_, &*events.begin(), MAX_EVENTS,
-                                    static_cast<int>(next_timeout));
+        bool stats_enabled = LoopStats::IsEnabled();
+        uint64_t wait_begin_us = stats_enabled ? LoopStats::NowUs() : 0;
+        event_num = waitEpoll(&*events.begin(), MAX_EVENTS, next_timeout);
+        if (stats_enabled) {
+            LoopStats *stats = LoopStats::GetThis();
+            stats->record(LoopStats::EPOLL_WAIT_US, LoopStats::NowUs() - wait_begin_us);
+            stats->record(LoopStats::EVENTS_PER_WAKEUP, event_num > 0 ? event_num : 0);
+        }
         if(event_num < 0 && errno == EINTR) {
             flag = true;
         }
+        Clock::UpdateLoopTime();
         // TODO 处理信号
                 // int rt = 0;
         // do {
@@ -228,6 +403,9 @@ void Reactor::idle() {
         for (const auto &callback: callbacks) {
             addTask(callback);
         }
+        if (stats_enabled) {
+            LoopStats::GetThis()->record(LoopStats::TIMERS_PER_TICK, callbacks.size());
+        }
 
         // 处理到来的事件
         for (int i = 0; i < event_num; ++i) {
@@ -240,13 +418,21 @@ void Reactor::idle() {
 
             auto *channel = static_cast<Channel *>(event.data.ptr);
             Mutex::Lock lock(channel->mutex_);
+            uint32_t registered = channel->event_ | channel->getPollEvents();
+            if (!registered) {
+                continue;                   // 取出事件之后 fd 上的事件被全部删除了（例如被其他线程关闭），是过时的通知
+            }
 
-            // TODO 多种事件的处理
-            // if(event.events & (EPOLLERR | EPOLLHUP)) {
-            //     event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->events;
-            // }
-            // 现阶段只处理读写事件
             uint32_t real_events = ReactorEvent::NONE;
+            if ((event.events & EPOLLERR) && (channel->event_ & ReactorEvent::ERROR)) {
+                // 错误队列由注册者处理，只有对端也关闭了才需要唤醒读写的等待者
+                real_events |= ReactorEvent::ERROR;
+                event.events &= ~EPOLLERR;
+            }
+            // 出错或者对端关闭时没有 EPOLLIN/EPOLLOUT（例如管道的写端关闭），唤醒所有等待者，由它们的读写返回错误
+            if (event.events & (EPOLLERR | EPOLLHUP)) {
+                event.events |= (EPOLLIN | EPOLLOUT) & registered;
+            }
             if (event.events & EPOLLIN) {
                 real_events |= ReactorEvent::READ;
             }
@@ -254,25 +440,25 @@ void Reactor::idle() {
                 real_events |= ReactorEvent::WRITE;
             }
 
-            uint32_t left_events = (channel->event_ & ~real_events);
-            int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-            event.events = left_events | EPOLLET;
-            int rt = epoll_ctl(epoll_fd_, op, channel->fd_, &event);
-            if (rt) {
-                ZY_LOG_ERROR(ZY_LOG_ROOT()) << "epoll_ctl(" << epoll_fd_ << ", "
-                                                << op << ", " << channel->fd_ << ", " << event.events << "):"
-                                                << rt << "(" << errno << ")(" << strerror(errno) << ")";
+            // 触发的 poll 回调整个移除，它等待的其他事件也不再需要
+            uint32_t left_events = (channel->event_ & ~real_events) | channel->getPollEvents(real_events);
+            if (!updateEpoll(channel, registered, left_events)) {
                 continue;
             }
 
-            if (real_events & EPOLLIN) {
+            if (real_events & channel->event_ & ReactorEvent::READ) {
                 channel->triggerEvent(ReactorEvent::READ);
                 --pending_event_num_;
             }
-            if (real_events & EPOLLOUT) {
+            if (real_events & channel->event_ & ReactorEvent::WRITE) {
                 channel->triggerEvent(ReactorEvent::WRITE);
                 --pending_event_num_;
             }
+            if (real_events & ReactorEvent::ERROR) {
+                channel->triggerEvent(ReactorEvent::ERROR);
+                --pending_event_num_;
+            }
+            pending_event_num_ -= channel->triggerPollCallbacks(real_events);
         }  // end for
 
         auto cur = Fiber::GetThis();
@@ -282,6 +468,25 @@ void Reactor::idle() {
     } // end while
 }
 
+int Reactor::waitEpoll(epoll_event *events, int max_events, uint64_t timeout) {
+#ifdef SYS_epoll_pwait2
+    // 内核 5.11 之前没有 epoll_pwait2，第一次失败之后不再尝试
+    static std::atomic<bool> s_has_pwait2{true};
+    if (s_has_pwait2.load(std::memory_order_relaxed)) {
+        struct timespec ts{};
+        ts.tv_sec = static_cast<time_t>(timeout / 1000000);
+        ts.tv_nsec = static_cast<long>(timeout % 1000000 * 1000);
+        int rt = static_cast<int>(syscall(SYS_epoll_pwait2, epoll_fd_, events, max_events, &ts, nullptr, 0));
+        if (rt >= 0 || errno != ENOSYS) {
+            return rt;
+        }
+        s_has_pwait2.store(false, std::memory_order_relaxed);
+    }
+#endif
+    // epoll_wait 被 hook 了，这里要用原始的系统调用
+    return epoll_wait_f(epoll_fd_, events, max_events, static_cast<int>((timeout + 999) / 1000));
+}
+
 void Reactor::tickle() {
     eventfd_write(wakeup_fd_, 1);
 }
@@ -2,6 +2,7 @@
 #define __ZY_REACTOR_H__
 
 #include <atomic>
+#include <sys/epoll.h>
 #include "utils/noncopyable.h"
 #include "scheduler.h"
 #include "timer.h"
@@ -9,16 +10,20 @@
 namespace zy {
 
 /**
- * @brief IO 事件，与 epoll 对事件的定义相同，暂时只关心读写事件
+ * @brief IO 事件，与 epoll 对事件的定义相同
  */
 struct ReactorEvent {
     enum Event {
         NONE = 0x00,
         READ = 0x01,
         WRITE = 0x04,
+        /// 错误队列有数据（如 MSG_ZEROCOPY 的完成通知），注册后没有 EPOLLHUP 的 EPOLLERR 只触发这个事件
+        ERROR = 0x08,
     };
 };
 
+class Reactor;
+
 /**
  * @brief socket fd 上下文，fd - 事件 -回调三元组
  */
@@ -32,6 +37,29 @@ struct Channel : NonCopyable {
         std::function<void()> func_;
     };
 
+    /**
+     * @brief 嵌入在 Channel 中的 IO 等待超时定时器，阻塞 IO 的超时不需要分配内存
+     */
+    struct EventTimeout : TimerNode {
+        Reactor *reactor_ = nullptr;
+        Channel *channel_ = nullptr;
+        ReactorEvent::Event event_ = ReactorEvent::NONE;
+        /// 本次等待是否因为超时结束
+        bool expired_ = false;
+    };
+
+    /**
+     * @brief poll 的等待回调，同一个事件可以有多个，和读写回调互不影响
+     */
+    struct PollCallback {
+        /// 由 Reactor 分配的编号，用于注销
+        uint64_t id_;
+        /// 等待的事件，多个事件用 | 连接
+        uint32_t events_;
+        Scheduler *scheduler_;
+        std::function<void()> func_;
+    };
+
     /**
      * @brief 构造函数
      * @param fd socket fd
@@ -46,6 +74,13 @@ struct Channel : NonCopyable {
      */
     EventCallback &getEventCallback(ReactorEvent::Event event);
 
+    /**
+     * @brief 获取对应事件的超时定时器
+     * @param event 事件
+     * @return 超时定时器的引用
+     */
+    EventTimeout &getEventTimeout(ReactorEvent::Event event);
+
     /**
      * @brief 重置回调
      * @param event_callback 需要被重置的回调
@@ -59,6 +94,20 @@ struct Channel : NonCopyable {
      */
     void triggerEvent(ReactorEvent::Event event);
 
+    /**
+     * @brief poll 等待的事件
+     * @param except 忽略等待了其中任意一个事件的回调
+     * @return 其余回调等待的事件之和
+     */
+    uint32_t getPollEvents(uint32_t except = ReactorEvent::NONE) const;
+
+    /**
+     * @brief 触发等待了 events 中任意一个事件的 poll 回调，每个回调只触发一次，触发后移除
+     * @param events 到来的事件
+     * @return 触发的回调数
+     */
+    size_t triggerPollCallbacks(uint32_t events);
+
     /// socket 描述符
     int fd_;
     /// 感兴趣的事件，多个事件用 | 连接
@@ -67,6 +116,14 @@ struct Channel : NonCopyable {
     EventCallback read_;
     /// 写事件回调
     EventCallback write_;
+    /// 错误事件回调
+    EventCallback error_;
+    /// 读事件等待超时
+    EventTimeout read_timeout_;
+    /// 写事件等待超时
+    EventTimeout write_timeout_;
+    /// poll 的等待回调
+    std::vector<PollCallback> poll_callbacks_;
     Mutex mutex_;
 };
 
@@ -107,6 +164,41 @@ public:
          */
         bool delEvent(int fd, ReactorEvent::Event event, bool trigger = false);
 
+        /**
+         * @brief 为 poll 注册一次性的等待回调
+         * @details 和 addEvent 不同，同一个 fd 的同一个事件可以同时有多个 poll 回调，也可以和读写回调共存，
+         * 事件到来时全部触发
+         * @param fd 文件描述符
+         * @param events 等待的事件，READ 和 WRITE 的组合
+         * @param cb 事件到来时执行的回调
+         * @return 回调的编号，失败时返回 0
+         */
+        uint64_t addPollCallback(int fd, uint32_t events, const std::function<void()> &cb);
+
+        /**
+         * @brief 注销还没有触发的 poll 回调
+         * @param fd 文件描述符
+         * @param id addPollCallback 返回的编号
+         * @return 回调是否还在，已经触发过返回 false
+         */
+        bool delPollCallback(int fd, uint64_t id);
+
+        /**
+         * @brief 触发 fd 上所有的 poll 回调，用于 fd 被关闭时唤醒等待者
+         * @param fd 文件描述符
+         */
+        void triggerPollCallbacks(int fd);
+
+        /**
+         * @brief 当前协程等待 fd 上的 event 事件，最多等待 timeout 毫秒
+         * @details 超时定时器嵌入在 Channel 中，整个等待过程不分配内存
+         * @param fd socket 描述符
+         * @param event 等待的事件
+         * @param timeout 超时时间，毫秒，0 表示一直等待
+         * @return 事件是否到来，超时返回 false 且 errno 为 ETIMEDOUT，注册事件失败也返回 false
+         */
+        bool waitEvent(int fd, ReactorEvent::Event event, uint64_t timeout);
+
         /**
          * @brief 获取当前线程的反应堆模型
          * @return 当前线程的反应堆模型
@@ -141,7 +233,53 @@ public:
          */
         void channelResize(size_t size);
 
+        /**
+         * @brief 获取 fd 对应的 channel，不够时扩容
+         * @param fd socket 描述符
+         * @return fd 对应的 channel
+         */
+        Channel *getChannel(int fd);
+
+        /**
+         * @brief 将 channel 的 event 事件从 epoll 中删除，调用者需要持有 channel 的锁
+         * @param channel fd 对应的 channel
+         * @param event 不感兴趣的事件
+         * @param trigger 删除之前是否触发一次
+         * @return 操作是否成功
+         */
+        bool delEvent(Channel *channel, ReactorEvent::Event event, bool trigger);
+
+        /**
+         * @brief 把 channel 在 epoll 中注册的事件从 old_events 改为 new_events，调用者需要持有 channel 的锁
+         * @details fd 已经被关闭或者被 dup2 覆盖时内核已经删除了注册，只是去掉事件时当作成功
+         * @param channel fd 对应的 channel
+         * @param old_events 原来注册的事件
+         * @param new_events 新的事件
+         * @return 操作是否成功
+         */
+        bool updateEpoll(Channel *channel, uint32_t old_events, uint32_t new_events);
+
+        /**
+         * @brief 等待 epoll 事件，超时精确到微秒
+         * @details 优先使用 epoll_pwait2，内核不支持时退回 epoll_wait，超时向上取整到毫秒
+         * @param events 事件数组
+         * @param max_events 数组大小
+         * @param timeout 超时时间，微秒
+         * @return 同 epoll_wait
+         */
+        int waitEpoll(epoll_event *events, int max_events, uint64_t timeout);
+
+        /**
+         * @brief IO 等待超时，在定时器线程内直接执行，唤醒等待的协程
+         * @param node Channel::EventTimeout
+         * @param state 到期时的状态字
+         */
+        static void OnEventTimeout(TimerNode *node, uint64_t state);
+
     private:
+        /// 时间轮每个 tick 的微秒数，决定微秒级定时器的精度；tick 越小第 0 层覆盖的时间越短，cascade 引起的唤醒越多
+        static const uint64_t TIMER_TICK_US = 100;
+
         /// epoll 描述符
         int epoll_fd_;
         /// event fd，用于唤醒 epoll_wait
@@ -150,6 +288,8 @@ public:
         int sig_fd_;
         /// 当前等待执行的 IO 事件的数量
         std::atomic_uint32_t pending_event_num_;
+        /// 下一个 poll 回调的编号
+        std::atomic<uint64_t> poll_callback_id_;
         /// epoll 所管理的所有 socket fd
         std::vector<Channel *> channels_;
         RWMutex mutex_;
@@ -0,0 +1,700 @@
+#include "resolver.h"
+
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+#include "socket.h"
+#include "clock.h"
+#include "log.h"
+#include "utils/endian.h"
+
+namespace zy {
+const uint32_t Resolver::NEGATIVE_TTL;
+const uint32_t Resolver::MAX_TTL;
+const uint64_t Resolver::RELOAD_INTERVAL;
+const size_t Resolver::MAX_CACHE_SIZE;
+
+// DNS 报文的常量，见 RFC 1035
+static const uint16_t DNS_PORT = 53;
+static const uint16_t TYPE_A = 1;
+static const uint16_t TYPE_CNAME = 5;
+static const uint16_t TYPE_SOA = 6;
+static const uint16_t TYPE_AAAA = 28;
+static const uint16_t CLASS_IN = 1;
+static const uint16_t FLAG_QR = 0x8000;
+static const uint16_t FLAG_TC = 0x0200;
+static const uint16_t FLAG_RD = 0x0100;
+static const uint16_t RCODE_NXDOMAIN = 3;
+static const size_t HEADER_SIZE = 12;
+// 名字压缩指针的最大跳转次数，防止构造的报文形成环
+static const int MAX_JUMPS = 64;
+
+static uint16_t read16(const char *p) {
+    return static_cast<uint16_t>(static_cast<uint8_t>(p[0]) << 8 | static_cast<uint8_t>(p[1]));
+}
+
+static uint32_t read32(const char *p) {
+    return static_cast<uint32_t>(read16(p)) << 16 | read16(p + 2);
+}
+
+static void append16(std::string &s, uint16_t value) {
+    s.push_back(static_cast<char>(value >> 8));
+    s.push_back(static_cast<char>(value & 0xff));
+}
+
+static std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+/**
+ * @brief 读取报文中 offset 处的名字，处理压缩指针
+ * @param name 不为空时写入名字，标签之间用 '.' 分隔，没有结尾的 '.'
+ * @return 名字在原位置之后的偏移，报文不合法时返回 0
+ */
+static size_t readName(const char *data, size_t length, size_t offset, std::string *name) {
+    size_t end = 0;
+    int jumps = 0;
+    while (offset < length) {
+        uint8_t len = static_cast<uint8_t>(data[offset]);
+        if ((len & 0xc0) == 0xc0) {
+            if (offset + 1 >= length || ++jumps > MAX_JUMPS) {
+                return 0;
+            }
+            if (!end) {
+                end = offset + 2;
+            }
+            offset = (len & 0x3f) << 8 | static_cast<uint8_t>(data[offset + 1]);
+        } else if (len == 0) {
+            return end ? end : offset + 1;
+        } else if (len > 63 || offset + 1 + len > length) {
+            return 0;
+        } else {
+            if (name) {
+                if (!name->empty()) {
+                    name->push_back('.');
+                }
+                name->append(data + offset + 1, len);
+            }
+            offset += 1 + len;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 文件的修改时间，纳秒，文件不存在时返回 0
+ */
+static int64_t modifyTime(const std::string &path) {
+    struct stat st{};
+    if (::stat(path.c_str(), &st)) {
+        return 0;
+    }
+    return st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief 把地址的端口设置为 port，端口为 0 时才设置
+ */
+static IPAddress::ptr withDefaultPort(const IPAddress::ptr &address, uint16_t port) {
+    if (address->getPort()) {
+        return address;
+    }
+    sockaddr_storage addr{};
+    memcpy(&addr, address->getAddr(), address->getAddrLen());
+    if (addr.ss_family == AF_INET) {
+        reinterpret_cast<sockaddr_in *>(&addr)->sin_port = onBigEndian(port);
+    } else {
+        reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port = onBigEndian(port);
+    }
+    return std::dynamic_pointer_cast<IPAddress>(Address::Create(reinterpret_cast<sockaddr *>(&addr)));
+}
+
+/**
+ * @brief 接收 length 字节
+ * @return 是否收满
+ */
+static bool recvAll(const Socket::ptr &sock, char *buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        size_t n = sock->recv(buffer + total, length - total);
+        if (n == static_cast<size_t>(-1) || n == 0) {
+            return false;
+        }
+        total += n;
+    }
+    return true;
+}
+
+/**
+ * @brief 生成随机的查询 id，防止伪造应答
+ */
+static uint16_t randomId() {
+    static thread_local std::mt19937 rng(std::random_device{}());
+    return static_cast<uint16_t>(rng());
+}
+
+Resolver::Resolver(std::string resolv_conf, std::string hosts)
+    : resolv_conf_(std::move(resolv_conf)), hosts_(std::move(hosts)), checked_ms_(0)
+    , resolv_conf_mtime_(-1), hosts_mtime_(-1), manual_nameservers_(false), manual_timeout_(false)
+    , query_count_(0) {
+    reload();
+}
+
+std::vector<IPAddress::ptr> Resolver::lookup(const std::string &host, uint16_t port, int family) {
+    // 数字地址不需要查询
+    if (family != AF_INET6) {
+        IPAddress::ptr addr = IPv4Address::Create(host.c_str(), port);
+        if (addr) {
+            return {addr};
+        }
+    }
+    if (family != AF_INET) {
+        IPAddress::ptr addr = IPv6Address::Create(host.c_str(), port);
+        if (addr) {
+            return {addr};
+        }
+    }
+
+    std::string name = toLower(host);
+    if (BuildQuery(0, name, TYPE_A).empty()) {
+        return {};
+    }
+    std::string bare = name.back() == '.' ? name.substr(0, name.size() - 1) : name;
+
+    reload();
+    std::vector<int> families;
+    if (family == AF_UNSPEC || family == AF_INET) {
+        families.push_back(AF_INET);
+    }
+    if (family == AF_UNSPEC || family == AF_INET6) {
+        families.push_back(AF_INET6);
+    }
+
+    std::vector<Record> records;
+    std::vector<Answer> answers;
+    Config config;
+    uint64_t now = Clock::CoarseMs();
+    {
+        Mutex::Lock lock(mutex_);
+        auto it = hosts_records_.find(bare);
+        if (it != hosts_records_.end()) {
+            for (auto &record : it->second) {
+                if (std::find(families.begin(), families.end(), record.family) != families.end()) {
+                    records.push_back(record);
+                }
+            }
+            if (!records.empty()) {
+                return ToAddresses(records, port);
+            }
+        }
+
+        for (int f : families) {
+            if (!lookupCache(name + (f == AF_INET ? "/4" : "/6"), now, records)) {
+                Answer answer;
+                answer.qtype = f == AF_INET ? TYPE_A : TYPE_AAAA;
+                answers.push_back(answer);
+            }
+        }
+        if (answers.empty()) {
+            return ToAddresses(records, port);
+        }
+        config = config_;
+    }
+
+    resolve(name, config, answers);
+
+    {
+        Mutex::Lock lock(mutex_);
+        if (cache_.size() > MAX_CACHE_SIZE) {
+            for (auto it = cache_.begin(); it != cache_.end();) {
+                it = it->second.expire_ms <= now ? cache_.erase(it) : std::next(it);
+            }
+        }
+        for (auto &answer : answers) {
+            if (!answer.ok) {
+                continue;
+            }
+            if (answer.ttl) {
+                Entry &entry = cache_[name + (answer.qtype == TYPE_A ? "/4" : "/6")];
+                entry.records = answer.records;
+                entry.expire_ms = now + answer.ttl * 1000ull;
+            }
+            records.insert(records.end(), answer.records.begin(), answer.records.end());
+        }
+    }
+    // 缓存命中的和刚查询到的混在一起，保持 IPv4 在前
+    std::stable_sort(records.begin(), records.end(), [](const Record &lhs, const Record &rhs) {
+        return lhs.family == AF_INET && rhs.family != AF_INET;
+    });
+    if (records.empty()) {
+        ZY_LOG_DEBUG(ZY_LOG_ROOT()) << "resolve " << host << " failed";
+    }
+    return ToAddresses(records, port);
+}
+
+IPAddress::ptr Resolver::lookupAny(const std::string &host, uint16_t port, int family) {
+    std::vector<IPAddress::ptr> addresses = lookup(host, port, family);
+    return addresses.empty() ? nullptr : addresses.front();
+}
+
+void Resolver::setNameservers(const std::vector<IPAddress::ptr> &nameservers) {
+    Mutex::Lock lock(mutex_);
+    manual_nameservers_ = true;
+    config_.nameservers.clear();
+    for (auto &nameserver : nameservers) {
+        config_.nameservers.push_back(withDefaultPort(nameserver, DNS_PORT));
+    }
+    cache_.clear();
+}
+
+void Resolver::setTimeout(uint64_t timeout_ms, uint32_t attempts) {
+    Mutex::Lock lock(mutex_);
+    manual_timeout_ = true;
+    config_.timeout_ms = timeout_ms;
+    config_.attempts = std::max<uint32_t>(attempts, 1);
+}
+
+void Resolver::clearCache() {
+    Mutex::Lock lock(mutex_);
+    cache_.clear();
+}
+
+void Resolver::reload() {
+    uint64_t now = Clock::CoarseMs();
+    int64_t resolv_conf_mtime;
+    int64_t hosts_mtime;
+    {
+        Mutex::Lock lock(mutex_);
+        if (resolv_conf_mtime_ != -1 && now - checked_ms_ < RELOAD_INTERVAL) {
+            return;
+        }
+        checked_ms_ = now;
+        resolv_conf_mtime = resolv_conf_mtime_;
+        hosts_mtime = hosts_mtime_;
+    }
+
+    // 读文件时不持有锁，其他协程在此期间使用旧的配置
+    int64_t new_resolv_conf_mtime = modifyTime(resolv_conf_);
+    int64_t new_hosts_mtime = modifyTime(hosts_);
+    bool load_resolv_conf = new_resolv_conf_mtime != resolv_conf_mtime;
+    bool load_hosts = new_hosts_mtime != hosts_mtime;
+    if (!load_resolv_conf && !load_hosts) {
+        return;
+    }
+    Config config;
+    HostsMap hosts;
+    if (load_resolv_conf) {
+        config = ParseResolvConf(resolv_conf_);
+    }
+    if (load_hosts) {
+        hosts = ParseHosts(hosts_);
+    }
+
+    Mutex::Lock lock(mutex_);
+    if (load_resolv_conf) {
+        resolv_conf_mtime_ = new_resolv_conf_mtime;
+        if (!manual_nameservers_) {
+            config_.nameservers = config.nameservers;
+        }
+        if (!manual_timeout_) {
+            config_.timeout_ms = config.timeout_ms;
+            config_.attempts = config.attempts;
+        }
+        config_.search = config.search;
+        config_.ndots = config.ndots;
+    }
+    if (load_hosts) {
+        hosts_mtime_ = new_hosts_mtime;
+        hosts_records_.swap(hosts);
+    }
+    cache_.clear();
+}
+
+bool Resolver::lookupCache(const std::string &key, uint64_t now, std::vector<Record> &records) {
+    auto it = cache_.find(key);
+    if (it == cache_.end()) {
+        return false;
+    }
+    if (it->second.expire_ms <= now) {
+        cache_.erase(it);
+        return false;
+    }
+    records.insert(records.end(), it->second.records.begin(), it->second.records.end());
+    return true;
+}
+
+void Resolver::resolve(const std::string &name, const Config &config, std::vector<Answer> &answers) {
+    // 与 glibc 相同：以 '.' 结尾的是全称，不使用搜索域；点的数量不少于 ndots 时先按全称查询
+    std::vector<std::string> candidates;
+    if (name.back() == '.') {
+        candidates.push_back(name.substr(0, name.size() - 1));
+    } else {
+        bool absolute_first = static_cast<uint32_t>(std::count(name.begin(), name.end(), '.')) >= config.ndots;
+        if (absolute_first) {
+            candidates.push_back(name);
+        }
+        for (auto &domain : config.search) {
+            candidates.push_back(name + "." + domain);
+        }
+        if (!absolute_first) {
+            candidates.push_back(name);
+        }
+    }
+
+    for (auto &candidate : candidates) {
+        for (auto &answer : answers) {
+            answer.ok = false;
+            answer.records.clear();
+        }
+        query(candidate, config, answers);
+        bool all_ok = true;
+        for (auto &answer : answers) {
+            if (!answer.records.empty()) {
+                return;
+            }
+            all_ok = all_ok && answer.ok;
+        }
+        // 服务器出错时不再尝试其他候选，也不缓存
+        if (!all_ok) {
+            return;
+        }
+    }
+}
+
+void Resolver::query(const std::string &name, const Config &config, std::vector<Answer> &answers) {
+    for (uint32_t attempt = 0; attempt < config.attempts; ++attempt) {
+        for (auto &nameserver : config.nameservers) {
+            if (queryUDP(name, nameserver, config.timeout_ms, answers)) {
+                queryTCP(name, nameserver, config.timeout_ms, answers);
+            }
+            bool done = true;
+            for (auto &answer : answers) {
+                done = done && answer.ok;
+            }
+            if (done) {
+                return;
+            }
+        }
+    }
+}
+
+bool Resolver::queryUDP(const std::string &name, const IPAddress::ptr &nameserver, uint64_t timeout_ms,
+                        std::vector<Answer> &answers) {
+    Socket::ptr sock = Socket::CreateUDP(nameserver->getFamily());
+    // 连接之后只收这个服务器的应答，服务器不可达时 recv 立即返回 ECONNREFUSED
+    if (!sock->connect(nameserver)) {
+        return false;
+    }
+
+    // 所有类型的查询一起发出，等待时间只有一个往返
+    std::vector<uint16_t> ids(answers.size());
+    std::vector<bool> pending(answers.size(), false);
+    size_t pending_num = 0;
+    for (size_t i = 0; i < answers.size(); ++i) {
+        if (answers[i].ok) {
+            continue;
+        }
+        ids[i] = randomId();
+        std::string packet = BuildQuery(ids[i], name, answers[i].qtype);
+        if (sock->send(packet.data(), packet.size()) != packet.size()) {
+            return false;
+        }
+        ++query_count_;
+        pending[i] = true;
+        ++pending_num;
+    }
+
+    char buffer[4096];
+    uint64_t deadline = Clock::NowMs() + timeout_ms;
+    while (pending_num) {
+        uint64_t now = Clock::NowMs();
+        if (now >= deadline) {
+            break;
+        }
+        sock->setRecvTimeout(deadline - now);
+        size_t n = sock->recv(buffer, sizeof buffer);
+        if (n == static_cast<size_t>(-1)) {
+            break;
+        }
+        for (size_t i = 0; i < answers.size(); ++i) {
+            bool truncated = false;
+            if (pending[i] && ParseResponse(buffer, n, ids[i], name, answers[i], truncated)) {
+                if (truncated) {
+                    return true;
+                }
+                pending[i] = false;
+                --pending_num;
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+void Resolver::queryTCP(const std::string &name, const IPAddress::ptr &nameserver, uint64_t timeout_ms,
+                        std::vector<Answer> &answers) {
+    Socket::ptr sock = Socket::CreateTCP(nameserver->getFamily());
+    sock->setSendTimeout(timeout_ms);
+    sock->setRecvTimeout(timeout_ms);
+    if (!sock->connect(nameserver)) {
+        return;
+    }
+
+    // TCP 上的报文前面有两个字节的长度
+    std::vector<char> buffer(UINT16_MAX);
+    for (auto &answer : answers) {
+        if (answer.ok) {
+            continue;
+        }
+        uint16_t id = randomId();
+        std::string packet;
+        append16(packet, 0);
+        packet += BuildQuery(id, name, answer.qtype);
+        packet[0] = static_cast<char>((packet.size() - 2) >> 8);
+        packet[1] = static_cast<char>((packet.size() - 2) & 0xff);
+        size_t sent = 0;
+        while (sent < packet.size()) {
+            size_t n = sock->send(packet.data() + sent, packet.size() - sent);
+            if (n == static_cast<size_t>(-1)) {
+                return;
+            }
+            sent += n;
+        }
+        ++query_count_;
+
+        char prefix[2];
+        if (!recvAll(sock, prefix, sizeof prefix)) {
+            return;
+        }
+        uint16_t length = read16(prefix);
+        bool truncated = false;
+        if (!recvAll(sock, buffer.data(), length)
+            || !ParseResponse(buffer.data(), length, id, name, answer, truncated)) {
+            return;
+        }
+    }
+}
+
+std::string Resolver::BuildQuery(uint16_t id, const std::string &name, uint16_t qtype) {
+    std::string packet;
+    append16(packet, id);
+    append16(packet, FLAG_RD);
+    append16(packet, 1);
+    append16(packet, 0);
+    append16(packet, 0);
+    append16(packet, 0);
+
+    std::string bare = !name.empty() && name.back() == '.' ? name.substr(0, name.size() - 1) : name;
+    if (bare.empty() || bare.size() > 253) {
+        return "";
+    }
+    size_t begin = 0;
+    while (begin <= bare.size()) {
+        size_t end = bare.find('.', begin);
+        if (end == std::string::npos) {
+            end = bare.size();
+        }
+        size_t len = end - begin;
+        if (len == 0 || len > 63) {
+            return "";
+        }
+        packet.push_back(static_cast<char>(len));
+        packet.append(bare, begin, len);
+        begin = end + 1;
+    }
+    packet.push_back('\0');
+    append16(packet, qtype);
+    append16(packet, CLASS_IN);
+    return packet;
+}
+
+bool Resolver::ParseResponse(const char *data, size_t length, uint16_t id, const std::string &name,
+                             Answer &answer, bool &truncated) {
+    if (length < HEADER_SIZE || read16(data) != id) {
+        return false;
+    }
+    uint16_t flags = read16(data + 2);
+    uint16_t qdcount = read16(data + 4);
+    uint16_t ancount = read16(data + 6);
+    uint16_t nscount = read16(data + 8);
+    if (!(flags & FLAG_QR) || qdcount != 1) {
+        return false;
+    }
+
+    // 应答中的问题必须与查询相同
+    std::string qname;
+    size_t offset = readName(data, length, HEADER_SIZE, &qname);
+    if (!offset || offset + 4 > length || toLower(qname) != name
+        || read16(data + offset) != answer.qtype || read16(data + offset + 2) != CLASS_IN) {
+        return false;
+    }
+    offset += 4;
+
+    truncated = flags & FLAG_TC;
+    if (truncated) {
+        return true;
+    }
+    uint16_t rcode = flags & 0xf;
+    answer.ok = false;
+    answer.records.clear();
+    if (rcode != 0 && rcode != RCODE_NXDOMAIN) {
+        return true;
+    }
+
+    uint32_t ttl = MAX_TTL;
+    uint32_t negative_ttl = NEGATIVE_TTL;
+    size_t addr_len = answer.qtype == TYPE_A ? 4 : 16;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(ancount) + nscount; ++i) {
+        offset = readName(data, length, offset, nullptr);
+        if (!offset || offset + 10 > length) {
+            answer.records.clear();
+            return true;
+        }
+        uint16_t type = read16(data + offset);
+        uint16_t cls = read16(data + offset + 2);
+        uint32_t rr_ttl = read32(data + offset + 4);
+        uint16_t rdlength = read16(data + offset + 8);
+        offset += 10;
+        if (offset + rdlength > length) {
+            answer.records.clear();
+            return true;
+        }
+        if (i < ancount) {
+            // CNAME 链上的记录一起出现在应答中，缓存时间取链上最小的 TTL
+            if (type == answer.qtype && cls == CLASS_IN && rdlength == addr_len) {
+                Record record{};
+                record.family = answer.qtype == TYPE_A ? AF_INET : AF_INET6;
+                memcpy(record.addr, data + offset, addr_len);
+                answer.records.push_back(record);
+                ttl = std::min(ttl, rr_ttl);
+            } else if (type == TYPE_CNAME) {
+                ttl = std::min(ttl, rr_ttl);
+            }
+        } else if (type == TYPE_SOA && rdlength >= 20) {
+            // 否定应答的缓存时间取 SOA 记录的 TTL 和 MINIMUM 中较小的，RFC 2308
+            negative_ttl = std::min(rr_ttl, read32(data + offset + rdlength - 4));
+        }
+        offset += rdlength;
+    }
+    answer.ok = true;
+    answer.ttl = std::min(answer.records.empty() ? negative_ttl : ttl, MAX_TTL);
+    return true;
+}
+
+Resolver::Config Resolver::ParseResolvConf(const std::string &path) {
+    Config config;
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        line = line.substr(0, line.find_first_of("#;"));
+        std::istringstream iss(line);
+        std::string key;
+        iss >> key;
+        if (key == "nameserver") {
+            std::string value;
+            iss >> value;
+            // 忽略 IPv6 链路本地地址的 %scope
+            value = value.substr(0, value.find('%'));
+            IPAddress::ptr addr = IPv4Address::Create(value.c_str(), DNS_PORT);
+            if (!addr) {
+                addr = IPv6Address::Create(value.c_str(), DNS_PORT);
+            }
+            if (addr) {
+                config.nameservers.push_back(addr);
+            }
+        } else if (key == "search" || key == "domain") {
+            config.search.clear();
+            std::string domain;
+            while (iss >> domain) {
+                if (domain.back() == '.') {
+                    domain.pop_back();
+                }
+                if (!domain.empty()) {
+                    config.search.push_back(toLower(domain));
+                }
+            }
+        } else if (key == "options") {
+            std::string option;
+            while (iss >> option) {
+                size_t colon = option.find(':');
+                if (colon == std::string::npos) {
+                    continue;
+                }
+                uint32_t value = static_cast<uint32_t>(atoi(option.c_str() + colon + 1));
+                std::string name = option.substr(0, colon);
+                // 上限与 glibc 相同
+                if (name == "ndots") {
+                    config.ndots = std::min<uint32_t>(value, 15);
+                } else if (name == "timeout") {
+                    config.timeout_ms = std::min<uint32_t>(std::max<uint32_t>(value, 1), 30) * 1000;
+                } else if (name == "attempts") {
+                    config.attempts = std::min<uint32_t>(std::max<uint32_t>(value, 1), 5);
+                }
+            }
+        }
+    }
+    // 没有配置服务器时与 glibc 相同，使用本机
+    if (config.nameservers.empty()) {
+        config.nameservers.push_back(IPv4Address::Create("127.0.0.1", DNS_PORT));
+    }
+    return config;
+}
+
+Resolver::HostsMap Resolver::ParseHosts(const std::string &path) {
+    HostsMap hosts;
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream iss(line);
+        std::string address;
+        if (!(iss >> address)) {
+            continue;
+        }
+        Record record{};
+        if (inet_pton(AF_INET, address.c_str(), record.addr) > 0) {
+            record.family = AF_INET;
+        } else if (inet_pton(AF_INET6, address.c_str(), record.addr) > 0) {
+            record.family = AF_INET6;
+        } else {
+            continue;
+        }
+        std::string name;
+        while (iss >> name) {
+            hosts[toLower(name)].push_back(record);
+        }
+    }
+    // hosts 文件不存在时 localhost 也要能解析
+    if (!hosts.count("localhost")) {
+        Record v4{};
+        v4.family = AF_INET;
+        inet_pton(AF_INET, "127.0.0.1", v4.addr);
+        Record v6{};
+        v6.family = AF_INET6;
+        inet_pton(AF_INET6, "::1", v6.addr);
+        hosts["localhost"] = {v4, v6};
+    }
+    return hosts;
+}
+
+std::vector<IPAddress::ptr> Resolver::ToAddresses(const std::vector<Record> &records, uint16_t port) {
+    std::vector<IPAddress::ptr> addresses;
+    addresses.reserve(records.size());
+    for (auto &record : records) {
+        if (record.family == AF_INET) {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = onBigEndian(port);
+            memcpy(&addr.sin_addr, record.addr, sizeof addr.sin_addr);
+            addresses.push_back(std::make_shared<IPv4Address>(addr));
+        } else {
+            addresses.push_back(std::make_shared<IPv6Address>(record.addr, port));
+        }
+    }
+    return addresses;
+}
+}
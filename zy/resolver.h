@@ -0,0 +1,216 @@
+#ifndef __ZY_RESOLVER_H__
+#define __ZY_RESOLVER_H__
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include "address.h"
+#include "utils/mutex.h"
+#include "utils/singleton.h"
+#include "utils/noncopyable.h"
+
+namespace zy {
+
+/**
+ * @brief 域名解析器
+ * @details getaddrinfo 在 libc 内部阻塞读写套接字，hook 无法让它让出协程。解析器自己构造 DNS 报文，
+ * 通过 UDP 套接字向 resolv.conf 中的服务器查询，在协程中收发时挂起的是协程而不是线程；应答被截断时改用 TCP 重新查询。
+ * 查询顺序与 glibc 的 "files dns" 相同：数字地址直接解析，然后查 hosts 文件，最后查 DNS。
+ * DNS 的结果按应答中的 TTL 缓存，名字不存在或没有对应类型的记录时按 SOA 的最小 TTL 做否定缓存。
+ */
+class Resolver : NonCopyable {
+public:
+    /// 没有 SOA 记录时否定缓存的时间，秒
+    static const uint32_t NEGATIVE_TTL = 30;
+    /// 缓存时间的上限，秒
+    static const uint32_t MAX_TTL = 24 * 3600;
+    /// 检查 resolv.conf 和 hosts 是否修改的间隔，毫秒
+    static const uint64_t RELOAD_INTERVAL = 5000;
+    /// 缓存项数量超过这个值时清理过期的项
+    static const size_t MAX_CACHE_SIZE = 4096;
+
+    /**
+     * @brief 构造函数，读取配置文件
+     * @param resolv_conf resolv.conf 的路径
+     * @param hosts hosts 文件的路径
+     */
+    explicit Resolver(std::string resolv_conf = "/etc/resolv.conf", std::string hosts = "/etc/hosts");
+
+    /**
+     * @brief 解析域名
+     * @param host 域名或数字地址
+     * @param port 端口号，写入返回的每个地址
+     * @param family AF_INET、AF_INET6 或 AF_UNSPEC，AF_UNSPEC 时同时查询两种地址，IPv4 在前
+     * @return 解析到的地址，失败时为空
+     */
+    std::vector<IPAddress::ptr> lookup(const std::string &host, uint16_t port = 0, int family = AF_UNSPEC);
+
+    /**
+     * @brief 解析域名，返回第一个地址
+     * @return 解析到的地址，失败时返回 nullptr
+     */
+    IPAddress::ptr lookupAny(const std::string &host, uint16_t port = 0, int family = AF_UNSPEC);
+
+    /**
+     * @brief 设置 DNS 服务器，替换 resolv.conf 中的配置，之后不再重新读取 resolv.conf
+     * @param nameservers 服务器地址，端口为 0 时使用 53
+     */
+    void setNameservers(const std::vector<IPAddress::ptr> &nameservers);
+
+    /**
+     * @brief 设置单次查询的超时时间和每个服务器的尝试次数，替换 resolv.conf 中的 options timeout/attempts
+     */
+    void setTimeout(uint64_t timeout_ms, uint32_t attempts);
+
+    /**
+     * @brief 清空缓存
+     */
+    void clearCache();
+
+    /**
+     * @brief 发往 DNS 服务器的查询次数，用于观察缓存的效果
+     */
+    uint64_t getQueryCount() const { return query_count_; }
+
+private:
+    /**
+     * @brief 解析得到的一个地址，不含端口
+     */
+    struct Record {
+        int family;
+        uint8_t addr[16];
+    };
+
+    /// hosts 文件中的名字（小写）到地址
+    using HostsMap = std::unordered_map<std::string, std::vector<Record>>;
+
+    /**
+     * @brief 缓存项，records 为空表示否定缓存
+     */
+    struct Entry {
+        std::vector<Record> records;
+        /// 过期时间，单调时钟，毫秒
+        uint64_t expire_ms;
+    };
+
+    /**
+     * @brief resolv.conf 中的配置，查询时复制一份，查询期间不持有锁
+     */
+    struct Config {
+        /// DNS 服务器
+        std::vector<IPAddress::ptr> nameservers;
+        /// 搜索域
+        std::vector<std::string> search;
+        /// 名字中的点少于 ndots 时先尝试搜索域
+        uint32_t ndots = 1;
+        /// 单次查询的超时时间，毫秒
+        uint64_t timeout_ms = 5000;
+        /// 每个服务器的尝试次数
+        uint32_t attempts = 2;
+    };
+
+    /**
+     * @brief 一种记录类型的查询结果
+     */
+    struct Answer {
+        /// 查询的记录类型，A 或 AAAA
+        uint16_t qtype = 0;
+        /// 是否得到了服务器的明确应答，超时、服务器出错时为 false，不缓存
+        bool ok = false;
+        std::vector<Record> records;
+        /// 缓存时间，秒
+        uint32_t ttl = 0;
+    };
+
+    /**
+     * @brief 距离上次检查超过 RELOAD_INTERVAL 时重新读取修改过的配置文件
+     * @details 读文件时不持有锁，hook 后的读可能挂起协程
+     */
+    void reload();
+
+    /**
+     * @brief 在缓存中查找，顺便删除过期的项，调用时持有 mutex_
+     * @param records 命中时追加缓存的地址
+     * @return 是否命中，否定缓存也算命中
+     */
+    bool lookupCache(const std::string &key, uint64_t now, std::vector<Record> &records);
+
+    /**
+     * @brief 按 search 和 ndots 的规则依次查询名字的候选全称，直到有一个存在
+     */
+    void resolve(const std::string &name, const Config &config, std::vector<Answer> &answers);
+
+    /**
+     * @brief 向服务器依次查询一个全称，直到得到明确的应答
+     */
+    void query(const std::string &name, const Config &config, std::vector<Answer> &answers);
+
+    /**
+     * @brief 通过 UDP 向一个服务器查询所有类型，所有查询一起发出
+     * @return 应答是否被截断
+     */
+    bool queryUDP(const std::string &name, const IPAddress::ptr &nameserver, uint64_t timeout_ms,
+                  std::vector<Answer> &answers);
+
+    /**
+     * @brief 通过 TCP 向一个服务器查询所有类型
+     */
+    void queryTCP(const std::string &name, const IPAddress::ptr &nameserver, uint64_t timeout_ms,
+                  std::vector<Answer> &answers);
+
+    /**
+     * @brief 构造查询报文
+     * @return 报文，名字不合法时为空
+     */
+    static std::string BuildQuery(uint16_t id, const std::string &name, uint16_t qtype);
+
+    /**
+     * @brief 解析应答报文
+     * @param truncated 应答是否被截断
+     * @return 应答是否与查询匹配，不匹配的报文（过期的应答、伪造的应答）应当丢弃
+     */
+    static bool ParseResponse(const char *data, size_t length, uint16_t id, const std::string &name,
+                              Answer &answer, bool &truncated);
+
+    static Config ParseResolvConf(const std::string &path);
+
+    static HostsMap ParseHosts(const std::string &path);
+
+    /**
+     * @brief 把记录转换成带端口的地址
+     */
+    static std::vector<IPAddress::ptr> ToAddresses(const std::vector<Record> &records, uint16_t port);
+
+private:
+    /// resolv.conf 的路径
+    std::string resolv_conf_;
+    /// hosts 文件的路径
+    std::string hosts_;
+    /// 保护以下所有状态，查询期间不持有
+    Mutex mutex_;
+    /// 上次检查配置文件的时间
+    uint64_t checked_ms_;
+    /// resolv.conf 的修改时间
+    int64_t resolv_conf_mtime_;
+    /// hosts 文件的修改时间
+    int64_t hosts_mtime_;
+    /// 是否通过 setNameservers 手动设置了服务器
+    bool manual_nameservers_;
+    /// 是否通过 setTimeout 手动设置了超时
+    bool manual_timeout_;
+    /// 当前配置
+    Config config_;
+    /// hosts 文件中的名字
+    HostsMap hosts_records_;
+    /// DNS 缓存，键为小写名字加协议簇
+    std::unordered_map<std::string, Entry> cache_;
+    /// 查询次数
+    std::atomic<uint64_t> query_count_;
+};
+
+/// 域名解析器的单例
+using ResolverMgr = Singleton<Resolver>;
+}
+
+#endif //__ZY_RESOLVER_H__
@@ -9,10 +9,12 @@ namespace zy {
 static thread_local Scheduler* t_scheduler = nullptr;
 // 当前线程的调度协程，调度器所在线程的调度协程不是主协程，其余线程的调度协程为主协程
 static thread_local Fiber* t_scheduler_fiber = nullptr;
+// 当前线程正在执行任务协程，调度协程和 idle 协程中为 false
+static thread_local bool t_in_task = false;
 
 Scheduler::Scheduler(std::string name, uint32_t thread_num, bool use_caller)
     : name_(std::move(name)), stopping_(false), thread_num_(thread_num)
-    , active_thread_num_(0), idle_thread_num_(0)
+    , active_thread_num_(0), idle_thread_num_(0), parked_fiber_num_(0)
     , use_caller_(use_caller), caller_tid_(-1) {
     setThreadName(name_);
     // 初始化主线程的主协程，即调度器所在的协程
@@ -99,7 +101,7 @@ void Scheduler::stop() {
 bool Scheduler::stopping() {
     Mutex::Lock lock(mutex_);
     // 所有任务都执行结束才可以停止调度器
-    return stopping_ && tasks_.empty() && active_thread_num_ == 0;
+    return stopping_ && tasks_.empty() && active_thread_num_ == 0 && parked_fiber_num_ == 0;
 }
 
 void Scheduler::run() {
@@ -142,26 +144,41 @@ void Scheduler::run() {
 
                 ZY_ASSERT(it->fiber_ || it->cb_);
                 //非上述两种情况才处理
-                task = *it;
-                tasks_.erase(it++);
+                task = std::move(*it);
+                // deque 删除后迭代器失效，先记下后面是否还有任务
+                bool has_more = (it + 1 != tasks_.end());
+                tasks_.erase(it);
                 ++active_thread_num_;
+                // 当前调度协程拿走一个任务后，还有剩余任务，也需要通知其他线程继续调度
+                tickle_me |= has_more;
                 break;
             }
-            // 当前调度协程拿走一个任务后，还有剩余任务，也需要通知其他线程继续调度
-            tickle_me |= (it != tasks_.end());
         }
 
         if (tickle_me) {
             tickle();
         }
 
+        // 统计排队延迟和本次运行时间，关闭时 start_us 为 0
+        uint64_t start_us = 0;
+        if ((task.fiber_ || task.cb_) && LoopStats::IsEnabled()) {
+            start_us = LoopStats::NowUs();
+            if (task.ready_us_ && start_us > task.ready_us_) {
+                LoopStats::GetThis()->record(LoopStats::QUEUE_DELAY_US, start_us - task.ready_us_);
+            }
+        }
+
         // 如果任务是fiber，并且任务处于可执行状态
         if (task.fiber_) {                                          // 协程直接调度
+            t_in_task = true;
             task.fiber_->resume();
+            t_in_task = false;
             --active_thread_num_;
         } else if (task.cb_) {
             Fiber::ptr func_fiber(new Fiber(task.cb_));   // 函数封装成协程再调度
+            t_in_task = true;
             func_fiber->resume();
+            t_in_task = false;
             --active_thread_num_;
         } else {                                                    // 没有任务了，进入到 idle 协程
             if (idle_fiber->getState() == Fiber::TERM) {            // idle 协程在满足退出条件后会退出，执行状态变成 TERM
@@ -171,7 +188,13 @@ void Scheduler::run() {
             idle_fiber->resume();
             --idle_thread_num_;
         }
+
+        if (start_us) {
+            LoopStats::GetThis()->record(LoopStats::TASK_RUN_US, LoopStats::NowUs() - start_us);
+        }
     }
+    // 调度结束，use_caller 时调度器所在线程回到普通线程，之后的 sleep 等调用不能再走 hook
+    setHooked(false);
 }
 
 void Scheduler::tickle() {
@@ -203,5 +226,9 @@ Fiber *Scheduler::GetSchedulerFiber() {
     return t_scheduler_fiber;
 }
 
+bool Scheduler::IsInTask() {
+    return t_in_task;
+}
+
 
 }
\ No newline at end of file
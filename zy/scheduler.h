@@ -1,7 +1,7 @@
 #ifndef __ZY_SCHEDULER_H__
 #define __ZY_SCHEDULER_H__
 
-#include <list>
+#include <deque>
 #include <vector>
 #include <atomic>
 #include "thread.h"
@@ -9,6 +9,7 @@
 #include "utils/mutex.h"
 #include "utils/noncopyable.h"
 #include "log.h"
+#include "loop_stats.h"
 
 namespace zy {
 
@@ -59,8 +60,11 @@ public:
             Mutex::Lock lock(mutex_);
             need_tickle = tasks_.empty();
             SchedulerTask task(t, tid);
+            if (LoopStats::IsEnabled()) {
+                task.ready_us_ = LoopStats::NowUs();
+            }
             if (task.fiber_ || task.cb_) {
-                tasks_.push_back(task);//存入fiber列表中
+                tasks_.push_back(std::move(task));//存入fiber列表中
                 //ZY_LOG_INFO(ZY_LOG_ROOT()) << "task pushed in";
             }
         }
@@ -69,6 +73,22 @@ public:
         }
     }
 
+    /**
+     * @brief 登记一个挂起在调度器之外的协程，之后由其他线程调用 unpark 放回，登记期间调度器不会停止
+     */
+    void park() {
+        ++parked_fiber_num_;
+    }
+
+    /**
+     * @brief 把 park 登记过的协程放回任务队列，调用之后不能再访问调度器
+     * @param fiber 挂起的协程
+     */
+    void unpark(const Fiber::ptr &fiber) {
+        addTask(fiber);
+        --parked_fiber_num_;
+    }
+
 protected:
     /**
      * @brief 调度器是否可以停止
@@ -110,6 +130,12 @@ public:
      */    
     static Fiber *GetSchedulerFiber();
 
+    /**
+     * @brief 当前是否在执行调度器的任务协程
+     * @details 只有任务协程可以挂起等待，调度协程和 idle 协程挂起后没有人再调度它们
+     */
+    static bool IsInTask();
+
 
 private:
     struct SchedulerTask {
@@ -117,21 +143,24 @@ private:
         std::function<void()> cb_;
         // 线程id 协程在哪个线程上 
         uint32_t tid_;
+        // 加入任务队列的时间，只在开启 LoopStats 时记录，用于统计排队延迟
+        uint64_t ready_us_;
 
-        SchedulerTask() : fiber_(nullptr), cb_(nullptr), tid_(-1) {}
+        SchedulerTask() : fiber_(nullptr), cb_(nullptr), tid_(-1), ready_us_(0) {}
 
         explicit SchedulerTask(Fiber::ptr fiber, uint32_t tid = -1)
-            : fiber_(std::move(fiber)), cb_(nullptr), tid_(tid) {
+            : fiber_(std::move(fiber)), cb_(nullptr), tid_(tid), ready_us_(0) {
         }
 
         explicit SchedulerTask(std::function<void()> func, uint32_t tid = -1)
-            : fiber_(nullptr), cb_(std::move(func)), tid_(tid) {
+            : fiber_(nullptr), cb_(std::move(func)), tid_(tid), ready_us_(0) {
         }
 
         void reset() {
             fiber_ = nullptr;
             cb_ = nullptr;
             tid_ = -1;
+            ready_us_ = 0;
         }
     };
 private:
@@ -142,7 +171,7 @@ private:
     bool stopping_;
 
     /// 调度器需要调度的任务队列
-    std::list<SchedulerTask> tasks_;
+    std::deque<SchedulerTask> tasks_;
 
     /// 线程池
     std::vector<Thread::ptr> threads_;
@@ -152,6 +181,8 @@ private:
     std::atomic_uint32_t active_thread_num_;
     /// 空闲线程数量
     std::atomic_uint32_t idle_thread_num_;
+    /// 挂起在调度器之外等待 unpark 的协程数量
+    std::atomic_uint32_t parked_fiber_num_;
 
     /// 调度器所在的线程是否参数调度
     bool use_caller_;
@@ -0,0 +1,457 @@
+#include "secure_socket.h"
+
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/x509.h>
+#include <openssl/evp.h>
+#include "log.h"
+#include "buffer_pool.h"
+#include "file_descriptor.h"
+#include "file_io.h"
+#include "utils/macro.h"
+
+namespace zy {
+const size_t TlsContext::MAX_SESSIONS;
+
+// 一个 TLS 记录最多 16KB 明文，退化的 sendFile 和聚合的 writev 按这个大小分块
+static const size_t TLS_RECORD_SIZE = 16 * 1024;
+
+/**
+ * @brief 取出 OpenSSL 线程错误队列中的第一个错误并清空队列
+ */
+static std::string takeError() {
+    unsigned long err = ERR_get_error();
+    ERR_clear_error();
+    if (!err) {
+        return "unknown error";
+    }
+    char buffer[256];
+    ERR_error_string_n(err, buffer, sizeof buffer);
+    return buffer;
+}
+
+TlsContext::ptr TlsContext::CreateServer(const std::string &cert_file, const std::string &key_file) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        return nullptr;
+    }
+    TlsContext::ptr context(new TlsContext(ctx, true));
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1
+        || SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+        || SSL_CTX_check_private_key(ctx) != 1) {
+        ZY_LOG_ERROR(ZY_LOG_ROOT()) << "load certificate " << cert_file << " failed, " << takeError();
+        return nullptr;
+    }
+    return context;
+}
+
+TlsContext::ptr TlsContext::CreateSelfSigned(const std::string &common_name) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        return nullptr;
+    }
+    TlsContext::ptr context(new TlsContext(ctx, true));
+
+    // P-256 的签名和握手都比 RSA 快得多，基准测的是框架而不是非对称运算
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    bool ok = key && cert;
+    if (ok) {
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 365 * 24 * 3600L);
+        X509_set_pubkey(cert, key);
+        X509_NAME *name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char *>(common_name.c_str()), -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        ok = X509_sign(cert, key, EVP_sha256()) > 0
+             && SSL_CTX_use_certificate(ctx, cert) == 1
+             && SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    }
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    if (!ok) {
+        ZY_LOG_ERROR(ZY_LOG_ROOT()) << "create self-signed certificate failed, " << takeError();
+        return nullptr;
+    }
+    return context;
+}
+
+TlsContext::ptr TlsContext::CreateClient(bool verify, const std::string &ca_file) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    if (!ctx) {
+        return nullptr;
+    }
+    TlsContext::ptr context(new TlsContext(ctx, false));
+    if (verify) {
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+        int rt = ca_file.empty() ? SSL_CTX_set_default_verify_paths(ctx)
+                                 : SSL_CTX_load_verify_locations(ctx, ca_file.c_str(), nullptr);
+        if (rt != 1) {
+            ZY_LOG_ERROR(ZY_LOG_ROOT()) << "load ca " << ca_file << " failed, " << takeError();
+            return nullptr;
+        }
+    }
+    // 会话只保存在 sessions_ 中，由 OnNewSession 按主机名存放
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, &TlsContext::OnNewSession);
+    return context;
+}
+
+TlsContext::TlsContext(SSL_CTX *ctx, bool server) : ctx_(ctx), server_(server) {
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    // 合并小块数据的缓冲区每次从块池借出，用户设置非阻塞后重试时地址可能不同
+    SSL_CTX_set_mode(ctx_, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    if (server_) {
+        static const unsigned char s_session_id_context[] = "zy";
+        SSL_CTX_set_session_id_context(ctx_, s_session_id_context, sizeof s_session_id_context - 1);
+    }
+    setKTLS(true);
+}
+
+TlsContext::~TlsContext() {
+    for (auto &item : sessions_) {
+        SSL_SESSION_free(item.second);
+    }
+    SSL_CTX_free(ctx_);
+}
+
+void TlsContext::setKTLS(bool on) {
+#ifdef SSL_OP_ENABLE_KTLS
+    if (on) {
+        SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+    } else {
+        SSL_CTX_clear_options(ctx_, SSL_OP_ENABLE_KTLS);
+    }
+#endif
+}
+
+SSL_SESSION *TlsContext::getSession(const std::string &key) {
+    Mutex::Lock lock(mutex_);
+    auto it = sessions_.find(key);
+    if (it == sessions_.end()) {
+        return nullptr;
+    }
+    SSL_SESSION_up_ref(it->second);
+    return it->second;
+}
+
+void TlsContext::putSession(const std::string &key, SSL_SESSION *session) {
+    Mutex::Lock lock(mutex_);
+    auto it = sessions_.find(key);
+    if (it != sessions_.end()) {
+        SSL_SESSION_free(it->second);
+        it->second = session;
+        return;
+    }
+    if (sessions_.size() >= MAX_SESSIONS) {
+        for (auto &item : sessions_) {
+            SSL_SESSION_free(item.second);
+        }
+        sessions_.clear();
+    }
+    sessions_[key] = session;
+}
+
+int TlsContext::OnNewSession(SSL *ssl, SSL_SESSION *session) {
+    auto sock = static_cast<SecureSocket *>(SSL_get_app_data(ssl));
+    if (!sock) {
+        return 0;
+    }
+    // 返回 1 表示取得了 session 的引用
+    sock->ctx_->putSession(sock->sessionKey(), session);
+    return 1;
+}
+
+SecureSocket::ptr SecureSocket::CreateTCP(const TlsContext::ptr &ctx, int family) {
+    SecureSocket::ptr sock(new SecureSocket(ctx, family, SOCK_STREAM, 0));
+    return sock;
+}
+
+SecureSocket::SecureSocket(TlsContext::ptr ctx, int family, int type, int protocol)
+    : Socket(family, type, protocol), ctx_(std::move(ctx)), ssl_(nullptr), handshaked_(false) {
+}
+
+SecureSocket::SecureSocket(TlsContext::ptr ctx, int fd, int family, int type, int protocol)
+    : Socket(fd, family, type, protocol), ctx_(std::move(ctx)), ssl_(nullptr), handshaked_(false) {
+    attach();
+}
+
+SecureSocket::~SecureSocket() {
+    close();
+}
+
+bool SecureSocket::connect(const Address::ptr &addr) {
+    if (!Socket::connect(addr) || !attach()) {
+        return false;
+    }
+    if (!host_name_.empty()) {
+        SSL_set_tlsext_host_name(ssl_, host_name_.c_str());
+        SSL_set1_host(ssl_, host_name_.c_str());
+    }
+    SSL_SESSION *session = ctx_->getSession(sessionKey());
+    if (session) {
+        SSL_set_session(ssl_, session);
+        SSL_SESSION_free(session);
+    }
+    return handshake();
+}
+
+bool SecureSocket::handshake() {
+    if (handshaked_) {
+        return true;
+    }
+    if (!ssl_ || !isConnected()) {
+        return false;
+    }
+    // fd 对用户是阻塞的，hook 后的读写在不可读写时挂起当前协程，这里不会返回 WANT_READ/WANT_WRITE
+    int rt = ctx_->isServer() ? SSL_accept(ssl_) : SSL_connect(ssl_);
+    if (rt != 1) {
+        onError(rt);
+        return false;
+    }
+    handshaked_ = true;
+    return true;
+}
+
+bool SecureSocket::close() {
+    if (ssl_) {
+        if (handshaked_ && isConnected()) {
+            // 只发送 close_notify，不等待对端的回应
+            SSL_shutdown(ssl_);
+        }
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+        ERR_clear_error();
+    }
+    handshaked_ = false;
+    return Socket::close();
+}
+
+size_t SecureSocket::send(const void *buffer, size_t length, int flags) {
+    if (!handshake()) {
+        return -1;
+    }
+    if (length == 0) {
+        return 0;
+    }
+    int rt = SSL_write(ssl_, buffer, static_cast<int>(std::min<size_t>(length, INT_MAX)));
+    if (rt > 0) {
+        return touch(rt);
+    }
+    return onError(rt);
+}
+
+size_t SecureSocket::send(const iovec *buffer, size_t length, int flags) {
+    if (!handshake()) {
+        return -1;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < length; ++i) {
+        total += buffer[i].iov_len;
+    }
+    // 小块数据合并成一个记录，避免每个 iovec 一个记录、一次系统调用
+    if (total <= TLS_RECORD_SIZE) {
+        // 协程栈很小，下面还有 OpenSSL 的栈帧，缓冲区从块池借出
+        PooledBuffer data(TLS_RECORD_SIZE);
+        size_t offset = 0;
+        for (size_t i = 0; i < length; ++i) {
+            memcpy(data.data() + offset, buffer[i].iov_base, buffer[i].iov_len);
+            offset += buffer[i].iov_len;
+        }
+        return send(data.data(), total, flags);
+    }
+
+    size_t sent = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (!buffer[i].iov_len) {
+            continue;
+        }
+        size_t n = send(buffer[i].iov_base, buffer[i].iov_len, flags);
+        if (n == static_cast<size_t>(-1) || n == 0) {
+            return sent ? sent : n;
+        }
+        sent += n;
+    }
+    return sent;
+}
+
+size_t SecureSocket::recv(void *buffer, size_t length, int flags) {
+    if (!handshake()) {
+        return -1;
+    }
+    if (length == 0) {
+        return 0;
+    }
+    int len = static_cast<int>(std::min<size_t>(length, INT_MAX));
+    int rt = (flags & MSG_PEEK) ? SSL_peek(ssl_, buffer, len) : SSL_read(ssl_, buffer, len);
+    if (rt > 0) {
+        return touch(rt);
+    }
+    return onError(rt);
+}
+
+size_t SecureSocket::recv(iovec *buffer, size_t length, int flags) {
+    size_t total = 0;
+    for (size_t i = 0; i < length; ++i) {
+        char *base = static_cast<char *>(buffer[i].iov_base);
+        size_t filled = 0;
+        while (filled < buffer[i].iov_len) {
+            // 第一次读可以挂起等待，之后只取已经解密好的数据
+            if (total + filled && !SSL_pending(ssl_)) {
+                return total + filled;
+            }
+            size_t n = recv(base + filled, buffer[i].iov_len - filled, flags);
+            if (n == static_cast<size_t>(-1) || n == 0) {
+                return total + filled ? total + filled : n;
+            }
+            filled += n;
+        }
+        total += filled;
+    }
+    return total;
+}
+
+size_t SecureSocket::sendFile(int fd, off_t offset, size_t length) {
+    if (!handshake()) {
+        return -1;
+    }
+
+    size_t total = 0;
+#ifndef OPENSSL_NO_KTLS
+    if (isKTLSSend()) {
+        while (total < length) {
+            ossl_ssize_t n = SSL_sendfile(ssl_, fd, offset, length - total, 0);
+            if (n <= 0) {
+                if (!total) {
+                    return onError(static_cast<int>(n));
+                }
+                break;
+            }
+            offset += n;
+            // 大文件要发很久，每一段都刷新活跃时间，空闲检测不会在传输中途关闭连接
+            total += touch(n);
+        }
+        return total;
+    }
+#endif
+    // 用户态加密，文件内容要读出来；读磁盘交给 FileIOPool，不阻塞反应堆线程
+    auto ctx = FdMgr::GetInstance().get(fd);
+    bool offload = !ctx || ctx->isOffload();
+    PooledBuffer buffer(TLS_RECORD_SIZE);
+    while (total < length) {
+        size_t want = std::min(length - total, buffer.size());
+        ssize_t r = 0;
+        if (offload) {
+            FileIOMgr::GetInstance().run([&]() { r = ::pread(fd, buffer.data(), want, offset); });
+        } else {
+            r = ::pread(fd, buffer.data(), want, offset);
+        }
+        if (r <= 0) {
+            break;
+        }
+        // send 成功时刷新活跃时间
+        size_t w = send(buffer.data(), r);
+        if (w != static_cast<size_t>(r)) {
+            break;
+        }
+        offset += r;
+        total += r;
+    }
+    return total ? total : -1;
+}
+
+bool SecureSocket::isKTLSSend() const {
+#ifndef OPENSSL_NO_KTLS
+    return ssl_ && BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+    return false;
+#endif
+}
+
+bool SecureSocket::isKTLSRecv() const {
+#ifndef OPENSSL_NO_KTLS
+    return ssl_ && BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+    return false;
+#endif
+}
+
+bool SecureSocket::isSessionReused() const {
+    return ssl_ && SSL_session_reused(ssl_);
+}
+
+std::string SecureSocket::getVersion() const {
+    return ssl_ ? SSL_get_version(ssl_) : "";
+}
+
+std::string SecureSocket::getCipher() const {
+    return ssl_ ? SSL_get_cipher_name(ssl_) : "";
+}
+
+Socket::ptr SecureSocket::newSocket(int fd) {
+    return Socket::ptr(new SecureSocket(ctx_, fd, getFamily(), getType(), getProtocol()));
+}
+
+bool SecureSocket::attach() {
+    if (ssl_) {
+        return true;
+    }
+    ssl_ = SSL_new(ctx_->getNative());
+    if (!ssl_) {
+        ZY_LOG_ERROR(ZY_LOG_ROOT()) << "SSL_new failed, " << takeError();
+        return false;
+    }
+    SSL_set_fd(ssl_, getFd());
+    SSL_set_app_data(ssl_, this);
+    // OpenSSL 的 socket BIO 用 write 发送，hook 后的 write 在这个 fd 上改用 MSG_NOSIGNAL，
+    // 对端关闭后写入返回 EPIPE，不需要在整个进程忽略 SIGPIPE
+    if (auto ctx = FdMgr::GetInstance().get(getFd(), true)) {
+        ctx->setNoSigpipe(true);
+    }
+    return true;
+}
+
+std::string SecureSocket::sessionKey() const {
+    if (!host_name_.empty()) {
+        return host_name_;
+    }
+    return getPeerAddress() ? getPeerAddress()->toString() : "";
+}
+
+size_t SecureSocket::onError(int rt) {
+    int error = SSL_get_error(ssl_, rt);
+    switch (error) {
+        case SSL_ERROR_ZERO_RETURN:
+            // 对端发送了 close_notify
+            ERR_clear_error();
+            return 0;
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            // 用户设置了非阻塞
+            errno = EAGAIN;
+            ERR_clear_error();
+            return -1;
+        case SSL_ERROR_SYSCALL:
+            // errno 由底层的读写设置，为 0 时是对端没有发送 close_notify 就关闭了连接
+            ERR_clear_error();
+            return errno ? -1 : 0;
+        default: {
+            int saved = errno;
+            unsigned long err = ERR_peek_error();
+            if (ERR_GET_REASON(err) == SSL_R_UNEXPECTED_EOF_WHILE_READING) {
+                ERR_clear_error();
+                return 0;
+            }
+            ZY_LOG_ERROR(ZY_LOG_ROOT()) << "tls error " << error << " on fd " << getFd() << ", " << takeError();
+            errno = saved ? saved : EPROTO;
+            return -1;
+        }
+    }
+}
+}
@@ -0,0 +1,243 @@
+#ifndef __ZY_SECURE_SOCKET_H__
+#define __ZY_SECURE_SOCKET_H__
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <openssl/ssl.h>
+#include "socket.h"
+#include "utils/mutex.h"
+#include "utils/noncopyable.h"
+
+namespace zy {
+
+/**
+ * @brief TLS 上下文，封装 SSL_CTX
+ * @details 证书、协议版本和会话缓存都在上下文中，同一个上下文创建的连接之间可以恢复会话：
+ * 服务端使用 OpenSSL 默认的会话缓存和 TLS 1.3 会话票据，客户端按主机名（没有设置时按对端地址）保存最近一次的会话。
+ * 默认开启 kTLS，握手完成后由 OpenSSL 设置 TCP_ULP "tls"，之后的加解密在内核中进行，sendFile 仍然零拷贝。
+ */
+class TlsContext : NonCopyable {
+public:
+    using ptr = std::shared_ptr<TlsContext>;
+
+    /// 客户端最多保存的会话数量，超过时清空
+    static const size_t MAX_SESSIONS = 1024;
+
+    /**
+     * @brief 创建服务端上下文
+     * @param cert_file PEM 格式的证书链
+     * @param key_file PEM 格式的私钥
+     * @return 上下文，证书或私钥加载失败时返回 nullptr
+     */
+    static TlsContext::ptr CreateServer(const std::string &cert_file, const std::string &key_file);
+
+    /**
+     * @brief 创建使用自签名证书的服务端上下文，证书和私钥只在内存中，用于本机测试和基准
+     * @param common_name 证书的 CN
+     * @return 上下文，生成失败时返回 nullptr
+     */
+    static TlsContext::ptr CreateSelfSigned(const std::string &common_name = "localhost");
+
+    /**
+     * @brief 创建客户端上下文
+     * @param verify 是否校验服务端证书
+     * @param ca_file PEM 格式的 CA 证书，为空时使用系统默认的 CA
+     * @return 上下文，CA 加载失败时返回 nullptr
+     */
+    static TlsContext::ptr CreateClient(bool verify = true, const std::string &ca_file = "");
+
+    /**
+     * @brief 析构函数，释放 SSL_CTX 和保存的会话
+     */
+    ~TlsContext();
+
+    /**
+     * @brief 设置握手后是否开启 kTLS，只影响之后创建的连接
+     */
+    void setKTLS(bool on);
+
+    // region # Getter
+    SSL_CTX *getNative() const { return ctx_; }
+
+    bool isServer() const { return server_; }
+    // endregion
+
+private:
+    friend class SecureSocket;
+
+    /**
+     * @brief 构造函数
+     * @param ctx SSL_CTX，所有权转移给 TlsContext
+     * @param server 是否是服务端上下文
+     */
+    TlsContext(SSL_CTX *ctx, bool server);
+
+    /**
+     * @brief 取出 key 对应的会话，用于客户端恢复会话
+     * @return 会话，增加了引用计数，没有时返回 nullptr
+     */
+    SSL_SESSION *getSession(const std::string &key);
+
+    /**
+     * @brief 保存 key 对应的会话，替换原来的会话，取得 session 的一个引用
+     */
+    void putSession(const std::string &key, SSL_SESSION *session);
+
+    /**
+     * @brief OpenSSL 收到新会话（TLS 1.3 是会话票据）时的回调
+     */
+    static int OnNewSession(SSL *ssl, SSL_SESSION *session);
+
+private:
+    /// OpenSSL 上下文
+    SSL_CTX *ctx_;
+    /// 是否是服务端上下文
+    bool server_;
+    /// 保护 sessions_
+    Mutex mutex_;
+    /// 客户端保存的会话
+    std::unordered_map<std::string, SSL_SESSION *> sessions_;
+};
+
+/**
+ * @brief TLS 套接字
+ * @details 底层 fd 被 hook 设置为非阻塞，OpenSSL 的读写走 hook 后的 read/write/sendmsg，
+ * 不可读写时挂起的是当前协程，握手和收发写成阻塞的形式即可。
+ * 客户端在 connect 时握手；服务端 accept 得到的套接字在第一次收发时握手，握手不占用 accept 的协程。
+ * 同一时刻只能有一个协程收发，Splice 直接操作 fd，不能用于 TLS 套接字。
+ */
+class SecureSocket : public Socket {
+public:
+    using ptr = std::shared_ptr<SecureSocket>;
+
+    /**
+     * @brief 创建一个 TLS over TCP 套接字
+     * @param ctx TLS 上下文，决定套接字是客户端还是服务端
+     * @param family 协议簇，默认为 AF_INET
+     * @return 套接字
+     */
+    static SecureSocket::ptr CreateTCP(const TlsContext::ptr &ctx, int family = AF_INET);
+
+    /**
+     * @brief 构造函数
+     * @param ctx TLS 上下文
+     * @param family 协议簇
+     * @param type 套接字类型
+     * @param protocol 传输协议
+     */
+    SecureSocket(TlsContext::ptr ctx, int family, int type, int protocol = 0);
+
+    /**
+     * @brief 析构函数，发送 close_notify 后关闭
+     */
+    ~SecureSocket() override;
+
+    /**
+     * @brief 设置服务端的主机名，用于 SNI、证书校验和会话恢复，需要在 connect 之前设置
+     */
+    void setHostName(const std::string &host_name) { host_name_ = host_name; }
+
+    /**
+     * @brief 发起连接并完成握手
+     * @param addr 目标网络地址
+     * @return 连接和握手是否都成功
+     */
+    bool connect(const Address::ptr &addr) override;
+
+    /**
+     * @brief 完成握手，已经完成时直接返回
+     * @return 握手是否成功，失败后连接不可用
+     */
+    bool handshake();
+
+    /**
+     * @brief 发送 close_notify 并关闭套接字，不等待对端的 close_notify
+     */
+    bool close() override;
+
+    // region # Send and Recv
+    size_t send(const void *buffer, size_t length, int flags = 0) override;
+
+    size_t send(const iovec *buffer, size_t length, int flags = 0) override;
+
+    size_t recv(void *buffer, size_t length, int flags = 0) override;
+
+    size_t recv(iovec *buffer, size_t length, int flags = 0) override;
+
+    /**
+     * @brief 发送文件，kTLS 发送生效时由内核加密，数据不经过用户态，否则退化为 pread + SSL_write，pread 交给 FileIOPool 执行
+     */
+    size_t sendFile(int fd, off_t offset, size_t length) override;
+    // endregion
+
+    // region # Getter
+    /**
+     * @brief 发送方向的加密是否由内核完成
+     */
+    bool isKTLSSend() const;
+
+    /**
+     * @brief 接收方向的解密是否由内核完成
+     */
+    bool isKTLSRecv() const;
+
+    /**
+     * @brief 握手是否恢复了之前的会话
+     */
+    bool isSessionReused() const;
+
+    /**
+     * @brief 协商的协议版本，例如 "TLSv1.3"
+     */
+    std::string getVersion() const;
+
+    /**
+     * @brief 协商的密码套件
+     */
+    std::string getCipher() const;
+
+    const TlsContext::ptr &getContext() const { return ctx_; }
+    // endregion
+
+protected:
+    /**
+     * @brief 根据 accept 得到的 fd 构造服务端套接字
+     */
+    SecureSocket(TlsContext::ptr ctx, int fd, int family, int type, int protocol);
+
+    Socket::ptr newSocket(int fd) override;
+
+private:
+    friend class TlsContext;
+
+    /**
+     * @brief 创建 SSL 对象并绑定 fd
+     */
+    bool attach();
+
+    /**
+     * @brief 客户端保存和恢复会话使用的键
+     */
+    std::string sessionKey() const;
+
+    /**
+     * @brief 把 OpenSSL 的错误转换成 errno 并记录日志
+     * @param rt SSL_* 函数的返回值
+     * @return 对端正常关闭时返回 0，否则返回 -1
+     */
+    size_t onError(int rt);
+
+private:
+    /// TLS 上下文
+    TlsContext::ptr ctx_;
+    /// OpenSSL 连接
+    SSL *ssl_;
+    /// 握手是否完成
+    bool handshaked_;
+    /// 服务端主机名
+    std::string host_name_;
+};
+}
+
+#endif //__ZY_SECURE_SOCKET_H__
@@ -2,9 +2,20 @@
 #include <unistd.h>
 #include <netinet/tcp.h>        // for TCP_NODELAY
 #include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <netinet/udp.h>
 #include "utils/macro.h"
 #include "file_descriptor.h"
 #include "reactor.h"
+#include "hook.h"
+#include "clock.h"
+#include "buffer_pool.h"
+#include "file_io.h"
 
 namespace zy {
 Socket::ptr Socket::CreateTCP(int family) {
@@ -17,10 +28,97 @@ Socket::ptr Socket::CreateUDP(int family) {
     return sock;
 }
 
+Socket::ptr Socket::CreateUnix(int type) {
+    Socket::ptr sock(new Socket(AF_UNIX, type, 0));
+    return sock;
+}
+
+// 每个数据报的控制消息空间，UDP_SEGMENT 是 uint16_t，UDP_GRO 是 int
+static const size_t DATAGRAM_CONTROL = CMSG_SPACE(sizeof(int));
+
+DatagramBatch::DatagramBatch(size_t capacity, size_t max_size)
+    : max_size_(max_size), size_(0), buffer_(capacity * max_size), iovs_(capacity)
+    , addrs_(capacity), controls_(capacity * DATAGRAM_CONTROL), msgs_(capacity), segments_(capacity) {
+    clear();
+}
+
+bool DatagramBatch::push(const void *data, size_t length, const Address::ptr &to, uint16_t segment) {
+    if (size_ == msgs_.size() || length > max_size_) {
+        return false;
+    }
+
+    size_t i = size_++;
+    memcpy(&buffer_[i * max_size_], data, length);
+    iovs_[i].iov_len = length;
+    msghdr &hdr = msgs_[i].msg_hdr;
+    if (to) {
+        memcpy(&addrs_[i], to->getAddr(), to->getAddrLen());
+        hdr.msg_name = &addrs_[i];
+        hdr.msg_namelen = to->getAddrLen();
+    } else {
+        hdr.msg_name = nullptr;
+        hdr.msg_namelen = 0;
+    }
+
+    // 只有超过一个分段时才需要 GSO
+    segments_[i] = segment && length > segment ? segment : 0;
+    if (segments_[i]) {
+        hdr.msg_control = &controls_[i * DATAGRAM_CONTROL];
+        hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cm), &segments_[i], sizeof(uint16_t));
+    } else {
+        hdr.msg_control = nullptr;
+        hdr.msg_controllen = 0;
+    }
+    msgs_[i].msg_len = length;
+    return true;
+}
+
+void DatagramBatch::clear() {
+    size_ = 0;
+    for (size_t i = 0; i < msgs_.size(); ++i) {
+        iovs_[i].iov_base = &buffer_[i * max_size_];
+        iovs_[i].iov_len = max_size_;
+        memset(&msgs_[i], 0, sizeof msgs_[i]);
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        segments_[i] = 0;
+    }
+}
+
+void DatagramBatch::prepareRecv(size_t i) {
+    iovs_[i].iov_len = max_size_;
+    msghdr &hdr = msgs_[i].msg_hdr;
+    hdr.msg_name = &addrs_[i];
+    hdr.msg_namelen = sizeof addrs_[i];
+    hdr.msg_control = &controls_[i * DATAGRAM_CONTROL];
+    hdr.msg_controllen = DATAGRAM_CONTROL;
+    hdr.msg_flags = 0;
+    msgs_[i].msg_len = 0;
+    segments_[i] = 0;
+}
+
+uint16_t DatagramBatch::segment(size_t i) const {
+    return segments_[i];
+}
+
+Address::ptr DatagramBatch::getAddress(size_t i) const {
+    if (!msgs_[i].msg_hdr.msg_namelen) {
+        return nullptr;
+    }
+    return Address::Create(reinterpret_cast<const sockaddr *>(&addrs_[i]), msgs_[i].msg_hdr.msg_namelen);
+}
+
 // region Socket::Socket()
 Socket::Socket(int family, int type, int protocol)
     : fd_(::socket(family, type, protocol))
-    , family_(family), type_(type), protocol_(protocol), connected_(false) {
+    , family_(family), type_(type), protocol_(protocol), connected_(false)
+    , last_active_ms_(Clock::NowMs())
+    , zerocopy_threshold_(0), zerocopy_next_(0), zerocopy_reactor_(nullptr), zerocopy_copied_(0) {
     ZY_ASSERT(fd_ != -1);
     setReuseAndNodelay();
 }
@@ -32,26 +130,26 @@ Socket::~Socket() {
 
 uint64_t Socket::getSendTimeout() const {
     timeval tv{};
-    getOption(SOL_SOCKET, SO_RCVTIMEO, tv);
+    getOption(SOL_SOCKET, SO_SNDTIMEO, tv);
     uint64_t timeout = tv.tv_sec * 1000 + tv.tv_usec / 1000;
     return timeout == 0 ? -1 : timeout;
 }
 
 void Socket::setSendTimeout(uint64_t timeout) {
     timeval tv{static_cast<int>(timeout / 1000), static_cast<int>(timeout % 1000 * 1000)};
-    setOption(SOL_SOCKET, SO_RCVTIMEO, &tv);
+    setOption(SOL_SOCKET, SO_SNDTIMEO, tv);
 }
 
 uint64_t Socket::getRecvTimeout() const {
     timeval tv{};
-    getOption(SOL_SOCKET, SO_SNDTIMEO, tv);
+    getOption(SOL_SOCKET, SO_RCVTIMEO, tv);
     uint64_t timeout = tv.tv_sec * 1000 + tv.tv_usec / 1000;
     return timeout == 0 ? -1 : timeout;
 }
 
 void Socket::setRecvTimeout(uint64_t timeout) {
     timeval tv{static_cast<int>(timeout / 1000), static_cast<int>(timeout % 1000 * 1000)};
-    setOption(SOL_SOCKET, SO_SNDTIMEO, &tv);
+    setOption(SOL_SOCKET, SO_RCVTIMEO, tv);
 }
 
 bool Socket::bind(const Address::ptr& addr) {
@@ -63,7 +161,7 @@ bool Socket::bind(const Address::ptr& addr) {
         close();
         return false;
     }
-    getLocalAddress();
+    setLocalAddress();
     return true;
 }
 
@@ -82,7 +180,7 @@ Socket::ptr Socket::accept() {
     if (conn_fd == -1) {
         return nullptr;
     }
-    Socket::ptr sock(new Socket(conn_fd, family_, type_, protocol_));
+    Socket::ptr sock = newSocket(conn_fd);
     sock->connected_ = true;
     sock->setLocalAddress();
     sock->setPeerAddress();
@@ -105,11 +203,26 @@ bool Socket::connect(const Address::ptr& addr) {
     return true;
 }
 
+bool Socket::shutdown(int how) {
+    if (fd_ == -1) {
+        return false;
+    }
+    return ::shutdown(fd_, how) == 0;
+}
+
 bool Socket::close() {
     if (fd_ == -1) {
         return false;
     }
     connected_ = false;
+    {
+        // 关闭之后收不到完成通知了，没完成的缓冲区随套接字对象一起释放
+        Mutex::Lock lock(zerocopy_mutex_);
+        if (zerocopy_reactor_) {
+            zerocopy_reactor_->delEvent(fd_, ReactorEvent::ERROR);
+            zerocopy_reactor_ = nullptr;
+        }
+    }
     ::close(fd_);
     fd_ = -1;
     return true;
@@ -117,7 +230,7 @@ bool Socket::close() {
 
 size_t Socket::send(const void *buffer, size_t length, int flags) {
     if (isConnected()) {
-        return ::send(fd_, buffer, length, flags);
+        return touch(::send(fd_, buffer, length, flags));
     }
     return -1;
 }
@@ -128,34 +241,34 @@ size_t Socket::send(const iovec *buffer, size_t length, int flags) {
         memset(&msg, 0, sizeof msg);
         msg.msg_iov = const_cast<iovec *>(buffer);
         msg.msg_iovlen = length;
-        return ::sendmsg(fd_, &msg, flags);
+        return touch(::sendmsg(fd_, &msg, flags));
     }
     return -1;
 }
 
 size_t Socket::sendTo(const void *buffer, size_t length, const Address::ptr &to, int flags) {
-    if (isConnected()) {
-        return sendto(fd_, buffer, length, flags, to->getAddr(), to->getAddrLen());
+    if (canTransfer()) {
+        return touch(sendto(fd_, buffer, length, flags, to->getAddr(), to->getAddrLen()));
     }
     return -1;
 }
 
 size_t Socket::sendTo(const iovec *buffer, size_t length, const Address::ptr &to, int flags) {
-    if (isConnected()) {
+    if (canTransfer()) {
         msghdr msg{};
         memset(&msg, 0, sizeof msg);
         msg.msg_iov = const_cast<iovec *>(buffer);
         msg.msg_iovlen = length;
         msg.msg_name = to->getAddr();
         msg.msg_namelen = to->getAddrLen();
-        return ::sendmsg(fd_, &msg, flags);
+        return touch(::sendmsg(fd_, &msg, flags));
     }
     return -1;
 }
 
 size_t Socket::recv(void *buffer, size_t length, int flags) {
     if (isConnected()) {
-        return ::recv(fd_, buffer, length, flags);
+        return touch(::recv(fd_, buffer, length, flags));
     }
     return -1;
 }
@@ -166,32 +279,390 @@ size_t Socket::recv(iovec *buffer, size_t length, int flags) {
         memset(&msg, 0, sizeof msg);
         msg.msg_iov = static_cast<iovec *>(buffer);
         msg.msg_iovlen = length;
-        return ::recvmsg(fd_, &msg, flags);
+        return touch(::recvmsg(fd_, &msg, flags));
     }
     return -1;
 }
 
 size_t Socket::recvFrom(void *buffer, size_t length, const Address::ptr &from, int flags) {
-    if (isConnected()) {
+    if (canTransfer()) {
+        // 变长的 Unix 域地址先恢复成最大长度，收到之后再记录实际长度
+        from->setAddrLen(sizeof(sockaddr_un));
         socklen_t len = from->getAddrLen();
-        return ::recvfrom(fd_, buffer, length, flags, from->getAddr(), &len);
+        size_t rt = ::recvfrom(fd_, buffer, length, flags, from->getAddr(), &len);
+        from->setAddrLen(len);
+        return touch(rt);
     }
     return -1;
 }
 
 size_t Socket::recvFrom(iovec *buffer, size_t length, const Address::ptr &from, int flags) {
-    if (isConnected()) {
+    if (canTransfer()) {
         msghdr msg{};
         memset(&msg, 0, sizeof msg);
         msg.msg_iov = buffer;
         msg.msg_iovlen = length;
+        from->setAddrLen(sizeof(sockaddr_un));
         msg.msg_name = from->getAddr();
         msg.msg_namelen = from->getAddrLen();
-        return ::recvmsg(fd_, &msg, flags);
+        size_t rt = ::recvmsg(fd_, &msg, flags);
+        from->setAddrLen(msg.msg_namelen);
+        return touch(rt);
     }
     return -1;
 }
 
+// 一次转发的最大长度，也是管道的默认容量
+static const size_t TRANSFER_CHUNK = 64 * 1024;
+
+size_t Socket::sendFile(int fd, off_t offset, size_t length) {
+    if (!isConnected()) {
+        return -1;
+    }
+
+    size_t total = 0;
+    while (total < length) {
+        // 被 hook 的 sendfile 在套接字不可写时挂起当前协程
+        ssize_t n = ::sendfile(fd_, fd, &offset, length - total);
+        if (n > 0) {
+            total += n;
+            continue;
+        }
+        if (n == -1 && (errno == EINVAL || errno == ENOSYS) && total == 0) {
+            // 文件不支持 mmap 式的读取（如某些虚拟文件系统），退化为用户态拷贝；读磁盘交给 FileIOPool，不阻塞反应堆线程
+            auto ctx = FdMgr::GetInstance().get(fd);
+            bool offload = !ctx || ctx->isOffload();
+            PooledBuffer buffer(std::min(length, TRANSFER_CHUNK));
+            while (total < length) {
+                size_t want = std::min(length - total, buffer.size());
+                ssize_t r = 0;
+                if (offload) {
+                    FileIOMgr::GetInstance().run([&]() { r = ::pread(fd, buffer.data(), want, offset); });
+                } else {
+                    r = ::pread(fd, buffer.data(), want, offset);
+                }
+                if (r <= 0) {
+                    break;
+                }
+                offset += r;
+                size_t w = sendAll(buffer.data(), r);
+                total += w;
+                if (w < static_cast<size_t>(r)) {
+                    break;
+                }
+            }
+        }
+        // n == 0 是到了文件末尾
+        break;
+    }
+    return touch(total ? total : -1);
+}
+
+size_t Socket::Splice(const Socket::ptr &from, const Socket::ptr &to, size_t length) {
+    if (!from->isConnected() || !to->isConnected()) {
+        return -1;
+    }
+
+    // 套接字之间不能直接 splice，中间要经过一个管道
+    int pipe_fd[2];
+    if (pipe2(pipe_fd, O_NONBLOCK | O_CLOEXEC) == -1) {
+        return -1;
+    }
+
+    size_t total = 0;
+    bool copy = false;
+    while (total < length) {
+        ssize_t n = ::splice(from->fd_, nullptr, pipe_fd[1], nullptr, std::min(length - total, TRANSFER_CHUNK),
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n == -1) {
+            if (errno == EINTR || (errno == EAGAIN && from->waitReady(false))) {
+                continue;
+            }
+            copy = (errno == EINVAL || errno == ENOSYS) && total == 0;
+            break;
+        }
+        if (n == 0) {
+            break;                      // 对端关闭
+        }
+
+        // 管道中的数据全部写出去再读下一段
+        while (n > 0) {
+            ssize_t m = ::splice(pipe_fd[0], nullptr, to->fd_, nullptr, n, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (m > 0) {
+                n -= m;
+                total += m;
+            } else if (m == -1 && (errno == EINTR || (errno == EAGAIN && to->waitReady(true)))) {
+                continue;
+            } else {
+                break;
+            }
+        }
+        if (n > 0) {
+            break;                      // 写出错，管道里剩下的数据丢弃
+        }
+    }
+    ::close(pipe_fd[0]);
+    ::close(pipe_fd[1]);
+
+    if (copy) {
+        PooledBuffer buffer(std::min(length, TRANSFER_CHUNK));
+        while (total < length) {
+            size_t r = from->recv(buffer.data(), std::min(length - total, buffer.size()));
+            if (static_cast<ssize_t>(r) <= 0) {
+                break;
+            }
+            size_t w = to->sendAll(buffer.data(), r);
+            total += w;
+            if (w < r) {
+                break;
+            }
+        }
+    }
+    from->touch(total);
+    return to->touch(total ? total : -1);
+}
+
+size_t Socket::sendBatch(DatagramBatch &batch, int flags) {
+    if (!canTransfer()) {
+        return -1;
+    }
+
+    size_t sent = 0;
+    while (sent < batch.size_) {
+        // 被 hook 的 sendmmsg 在发送缓冲区满时挂起当前协程
+        int n = ::sendmmsg(fd_, &batch.msgs_[sent], static_cast<unsigned int>(batch.size_ - sent), flags);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        // 出错的一定是第一个没发出去的数据报，网卡或内核不支持 GSO 时逐段发送
+        if (n == -1 && (errno == EIO || errno == EINVAL) && batch.segments_[sent]
+            && sendSegments(batch, sent, flags)) {
+            ++sent;
+            continue;
+        }
+        break;
+    }
+    return touch(sent ? sent : -1);
+}
+
+bool Socket::sendSegments(DatagramBatch &batch, size_t i, int flags) {
+    msghdr hdr = batch.msgs_[i].msg_hdr;
+    hdr.msg_control = nullptr;
+    hdr.msg_controllen = 0;
+    const char *data = batch.data(i);
+    size_t length = batch.iovs_[i].iov_len;
+    size_t segment = batch.segments_[i];
+    for (size_t offset = 0; offset < length; offset += segment) {
+        iovec iov{const_cast<char *>(data + offset), std::min(segment, length - offset)};
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        if (::sendmsg(fd_, &hdr, flags) == -1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t Socket::recvBatch(DatagramBatch &batch, int flags) {
+    if (!canTransfer()) {
+        return -1;
+    }
+
+    batch.clear();
+    for (size_t i = 0; i < batch.capacity(); ++i) {
+        batch.prepareRecv(i);
+    }
+    // MSG_WAITFORONE：读到第一个数据报之后不再等待，只取已经到达的
+    int n = ::recvmmsg(fd_, &batch.msgs_[0], static_cast<unsigned int>(batch.capacity()),
+                       flags | MSG_WAITFORONE, nullptr);
+    if (n < 0) {
+        return -1;
+    }
+    batch.size_ = n;
+    for (int i = 0; i < n; ++i) {
+        msghdr &hdr = batch.msgs_[i].msg_hdr;
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                int segment = 0;
+                memcpy(&segment, CMSG_DATA(cm), sizeof segment);
+                batch.segments_[i] = static_cast<uint16_t>(segment);
+            }
+        }
+    }
+    return touch(n);
+}
+
+bool Socket::setGRO(bool on) {
+    int value = on ? 1 : 0;
+    return setOption(SOL_UDP, UDP_GRO, value);
+}
+
+bool Socket::setZeroCopy(size_t threshold) {
+    int on = 1;
+    if (!setOption(SOL_SOCKET, SO_ZEROCOPY, on)) {
+        return false;
+    }
+    zerocopy_threshold_ = threshold ? threshold : 1;
+    return true;
+}
+
+size_t Socket::sendZeroCopy(const void *buffer, size_t length, std::shared_ptr<void> owner, int flags) {
+    if (!isConnected()) {
+        return -1;
+    }
+    if (!zerocopy_threshold_ || length < zerocopy_threshold_) {
+        return send(buffer, length, flags);
+    }
+
+    // 先登记再发送，完成通知可能在 send 返回之前就被其他线程回收
+    uint32_t id;
+    {
+        Mutex::Lock lock(zerocopy_mutex_);
+        if (!zerocopy_reactor_ && !zerocopy_pending_.empty()) {
+            reapZeroCopy();             // 没有反应堆回收时，每次发送前回收一次
+        }
+        id = zerocopy_next_++;
+        zerocopy_pending_.emplace_back(id, std::move(owner));
+    }
+
+    ssize_t n = ::send(fd_, buffer, length, flags | MSG_ZEROCOPY);
+    int error = errno;
+
+    Mutex::Lock lock(zerocopy_mutex_);
+    if (n < 0) {
+        // 失败的发送不占用内核的序号
+        --zerocopy_next_;
+        for (auto it = zerocopy_pending_.rbegin(); it != zerocopy_pending_.rend(); ++it) {
+            if (it->first == id) {
+                zerocopy_pending_.erase(std::next(it).base());
+                break;
+            }
+        }
+        lock.unlock();
+        if (error == ENOBUFS) {
+            // 锁页的内存超过了 optmem_max，退化为普通发送
+            return send(buffer, length, flags);
+        }
+        errno = error;
+        return -1;
+    }
+    armZeroCopy();
+    return touch(n);
+}
+
+size_t Socket::getZeroCopyPending() {
+    Mutex::Lock lock(zerocopy_mutex_);
+    return zerocopy_pending_.size();
+}
+
+void Socket::armZeroCopy() {
+    Reactor *reactor = Reactor::GetThis();
+    if (zerocopy_reactor_ || !reactor || zerocopy_pending_.empty()) {
+        return;
+    }
+    // 回调只持有弱引用，套接字析构时不需要等待完成通知
+    std::weak_ptr<Socket> weak = shared_from_this();
+    if (reactor->addEvent(fd_, ReactorEvent::ERROR, [weak]() {
+        if (auto sock = weak.lock()) {
+            sock->onZeroCopy();
+        }
+    })) {
+        zerocopy_reactor_ = reactor;
+    }
+}
+
+void Socket::onZeroCopy() {
+    Mutex::Lock lock(zerocopy_mutex_);
+    Reactor *reactor = zerocopy_reactor_;
+    zerocopy_reactor_ = nullptr;
+    if (!reactor || fd_ == -1) {
+        return;
+    }
+    if (reapZeroCopy()) {
+        armZeroCopy();
+        return;
+    }
+    lock.unlock();
+    // 错误队列是空的，是套接字本身出错了，唤醒读写的等待者，由它们的读写返回错误
+    reactor->delEvent(fd_, ReactorEvent::READ, true);
+    reactor->delEvent(fd_, ReactorEvent::WRITE, true);
+}
+
+size_t Socket::reapZeroCopy() {
+    size_t count = 0;
+    char control[128];
+    while (true) {
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        // 错误队列没有数据时立即返回，不能走 hook 的等待
+        if (recvmsg_f(fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            break;
+        }
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                && !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+            auto *err = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cm));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                ++zerocopy_copied_;
+            }
+            // 一条通知覆盖序号区间 [ee_info, ee_data]，序号会回绕
+            uint32_t lo = err->ee_info;
+            uint32_t span = err->ee_data - lo;
+            for (auto it = zerocopy_pending_.begin(); it != zerocopy_pending_.end();) {
+                if (it->first - lo <= span) {
+                    it = zerocopy_pending_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            ++count;
+        }
+    }
+    return count;
+}
+
+size_t Socket::sendAll(const char *buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = ::send(fd_, buffer + total, length - total, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+bool Socket::waitReady(bool write) {
+    auto ctx = FdMgr::GetInstance().get(fd_);
+    uint64_t timeout = ctx ? ctx->getTimeout(write ? SO_SNDTIMEO : SO_RCVTIMEO) : 0;
+    Reactor *reactor = Reactor::GetThis();
+    if (isHooked() && reactor) {
+        return reactor->waitEvent(fd_, write ? ReactorEvent::WRITE : ReactorEvent::READ, timeout);
+    }
+
+    pollfd pfd{fd_, static_cast<short>(write ? POLLOUT : POLLIN), 0};
+    int rt = ::poll(&pfd, 1, timeout ? static_cast<int>(timeout) : -1);
+    if (rt == 0) {
+        errno = ETIMEDOUT;
+    }
+    return rt > 0;
+}
+
+size_t Socket::touch(size_t rt) {
+    if (static_cast<ssize_t>(rt) > 0) {
+        last_active_ms_.store(Clock::NowMs(), std::memory_order_relaxed);
+    }
+    return rt;
+}
+
 int Socket::getError() const {
     int error = 0;
     if (!getOption(SOL_SOCKET, SO_ERROR, error)) {
@@ -249,37 +720,35 @@ bool Socket::setOption(int level, int option, const void *result, socklen_t len)
 void Socket::setReuseAndNodelay() {
     int val = 1;
     setOption(SOL_SOCKET, SO_REUSEADDR, val);
-    if (type_ == SOCK_STREAM) {
+    // Unix 域套接字没有 TCP 层
+    if (type_ == SOCK_STREAM && (family_ == AF_INET || family_ == AF_INET6)) {
         setOption(IPPROTO_TCP, TCP_NODELAY, val);
     }
 }
 
 // region # Socket::Socket(fd)
 Socket::Socket(int fd, int family, int type, int protocol)
-        : fd_(fd), family_(family), type_(type), protocol_(protocol), connected_(false){
+        : fd_(fd), family_(family), type_(type), protocol_(protocol), connected_(false)
+        , last_active_ms_(Clock::NowMs())
+        , zerocopy_threshold_(0), zerocopy_next_(0), zerocopy_reactor_(nullptr), zerocopy_copied_(0) {
     ZY_ASSERT(fd_ != -1);
     setReuseAndNodelay();
 }
 // endregion
 
+Socket::ptr Socket::newSocket(int fd) {
+    return Socket::ptr(new Socket(fd, family_, type_, protocol_));
+}
+
 void Socket::setLocalAddress() {
     if (local_address) {
         return;
     }
 
-    Address::ptr addr;
-    switch (family_) {
-        case AF_INET:
-            addr.reset(new IPv4Address);
-            break;
-        default:
-            addr.reset();
-            break;
-    }
-
-    socklen_t addrlen = addr->getAddrLen();
-    if (getsockname(fd_, addr->getAddr(), &addrlen) == 0) {
-        local_address = addr;
+    sockaddr_storage addr{};
+    socklen_t addrlen = sizeof addr;
+    if (getsockname(fd_, (sockaddr *) &addr, &addrlen) == 0) {
+        local_address = Address::Create((sockaddr *) &addr, addrlen);
     }
 }
 
@@ -288,19 +757,10 @@ void Socket::setPeerAddress() {
         return;
     }
 
-    Address::ptr addr;
-    switch (family_) {
-        case AF_INET:
-            addr.reset(new IPv4Address);
-            break;
-        default:
-            addr.reset();
-            break;
-    }
-
-    socklen_t addrlen = addr->getAddrLen();
-    if (getpeername(fd_, addr->getAddr(), &addrlen) == 0) {
-        peer_address = addr;
+    sockaddr_storage addr{};
+    socklen_t addrlen = sizeof addr;
+    if (getpeername(fd_, (sockaddr *) &addr, &addrlen) == 0) {
+        peer_address = Address::Create((sockaddr *) &addr, addrlen);
     }
 }
 }
\ No newline at end of file
@@ -2,11 +2,96 @@
 #define __ZY_SOCKET_H__
 
 #include <memory>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <sys/socket.h>
 #include "address.h"
+#include "utils/mutex.h"
 #include "utils/noncopyable.h"
 #include <string>
 
 namespace zy {
+class Reactor;
+
+/**
+ * @brief 批量收发的数据报缓冲区
+ * @details 构造时按容量分配好所有数据报的缓冲区、地址和控制消息，反复 clear 之后复用，收发过程不分配内存。
+ * 发送时用 push 追加数据报，接收时由 Socket::recvBatch 填满。
+ */
+class DatagramBatch : NonCopyable {
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 一批最多的数据报数量
+     * @param max_size 单个数据报的最大长度，开启 GRO 接收或者 GSO 发送时一个数据报包含多个分段，最大 65535
+     */
+    explicit DatagramBatch(size_t capacity, size_t max_size = 2048);
+
+    /**
+     * @brief 追加一个要发送的数据报，数据被拷贝到内部缓冲区
+     * @param data 数据
+     * @param length 数据长度
+     * @param to 目的地址，已连接的套接字可以为空
+     * @param segment GSO 分段长度，非 0 时内核把数据按这个长度切成多个数据报发送，不支持时由 Socket 逐段发送
+     * @return 是否追加成功，批已满或数据过长时返回 false
+     */
+    bool push(const void *data, size_t length, const Address::ptr &to = nullptr, uint16_t segment = 0);
+
+    /**
+     * @brief 清空，之后可以重新 push 或接收
+     */
+    void clear();
+
+    // region # Getter
+    size_t size() const { return size_; }
+
+    size_t capacity() const { return msgs_.size(); }
+
+    bool empty() const { return size_ == 0; }
+
+    const char *data(size_t i) const { return &buffer_[i * max_size_]; }
+
+    size_t length(size_t i) const { return msgs_[i].msg_len; }
+
+    /**
+     * @brief 接收到的第 i 个数据报的 GRO 分段长度，0 表示没有合并，数据报需要按这个长度切开
+     */
+    uint16_t segment(size_t i) const;
+
+    /**
+     * @brief 接收到的第 i 个数据报的来源地址
+     */
+    Address::ptr getAddress(size_t i) const;
+    // endregion
+
+private:
+    friend class Socket;
+
+    /**
+     * @brief 把第 i 个消息恢复成可以接收的状态
+     */
+    void prepareRecv(size_t i);
+
+private:
+    /// 单个数据报的最大长度
+    size_t max_size_;
+    /// 当前数据报数量
+    size_t size_;
+    /// 数据区，每个数据报占 max_size_ 字节
+    std::vector<char> buffer_;
+    /// 每个数据报一个 iovec
+    std::vector<iovec> iovs_;
+    /// 每个数据报的地址
+    std::vector<sockaddr_storage> addrs_;
+    /// 每个数据报的控制消息，放 UDP_SEGMENT/UDP_GRO
+    std::vector<char> controls_;
+    /// recvmmsg/sendmmsg 的参数
+    std::vector<mmsghdr> msgs_;
+    /// 每个数据报的 GSO/GRO 分段长度
+    std::vector<uint16_t> segments_;
+};
+
 /**
  * @brief 套接字封装
  */
@@ -14,6 +99,9 @@ class Socket : public std::enable_shared_from_this<Socket>, NonCopyable {
 public:
     using ptr = std::shared_ptr<Socket>;
 
+    /// 默认的零拷贝阈值，小于这个长度时锁页和完成通知的开销比拷贝还大，见 tests/bench_zerocopy.cc
+    static const size_t ZEROCOPY_THRESHOLD = 32 * 1024;
+
     /**
      * @brief 创建一个 TCP 套接字
      * @param family 协议簇，默认为 AF_INET
@@ -28,6 +116,13 @@ public:
      */
     static Socket::ptr CreateUDP(int family = AF_INET);
 
+    /**
+     * @brief 创建一个 Unix 域套接字，用于同一台机器上的进程之间通信
+     * @param type 套接字类型，SOCK_STREAM 或 SOCK_DGRAM
+     * @return 套接字
+     */
+    static Socket::ptr CreateUnix(int type = SOCK_STREAM);
+
     /**
      * @brief 构造函数
      * @param family 协议簇
@@ -39,7 +134,7 @@ public:
     /**
      * @brief 析构函数
      */
-    ~Socket();
+    virtual ~Socket();
 
     // region # timeout Getter and Setter
     /**
@@ -120,31 +215,100 @@ public:
      * @param addr 目标网络地址
      * @return 操作是否成功
      */
-    bool connect(const Address::ptr& addr);
+    virtual bool connect(const Address::ptr& addr);
 
     /**
      * @brief 关闭套接字
      * @return 操作是否成功
      */
-    bool close();
+    virtual bool close();
+
+    /**
+     * @brief 关闭连接的读写端，阻塞在该套接字上的读写会立即返回，可以在其他线程调用
+     * @param how SHUT_RD、SHUT_WR 或 SHUT_RDWR
+     * @return 操作是否成功
+     */
+    bool shutdown(int how = SHUT_RDWR);
     // endregion
 
     // region # Send and Recv
-    size_t send(const void *buffer, size_t length, int flags = 0);
+    virtual size_t send(const void *buffer, size_t length, int flags = 0);
 
-    size_t send(const iovec *buffer, size_t length, int flags = 0);
+    virtual size_t send(const iovec *buffer, size_t length, int flags = 0);
 
     size_t sendTo(const void *buffer, size_t length, const Address::ptr &to, int flags = 0);
 
     size_t sendTo(const iovec *buffer, size_t length, const Address::ptr &to, int flags = 0);
 
-    size_t recv(void *buffer, size_t length, int flags = 0);
+    virtual size_t recv(void *buffer, size_t length, int flags = 0);
 
-    size_t recv(iovec *buffer, size_t length, int flags = 0);
+    virtual size_t recv(iovec *buffer, size_t length, int flags = 0);
 
     size_t recvFrom(void *buffer, size_t length, const Address::ptr &from, int flags = 0);
 
     size_t recvFrom(iovec *buffer, size_t length, const Address::ptr &from, int flags = 0);
+
+    /**
+     * @brief 把文件的一段发送到套接字，数据由内核从页缓存直接拷贝到套接字，不经过用户态
+     * @details 套接字不可写时挂起当前协程等待，sendfile 不支持时退化为 pread + send
+     * @param fd 文件描述符
+     * @param offset 文件偏移，不改变文件的读写位置
+     * @param length 发送长度
+     * @return 发送的字节数，文件比 length 短时发送到文件末尾，没有发送任何数据就出错时返回 -1
+     */
+    virtual size_t sendFile(int fd, off_t offset, size_t length);
+
+    /**
+     * @brief 把 from 收到的数据转发到 to，数据经过内核管道，不经过用户态
+     * @details 等待 from 可读、to 可写时挂起当前协程，splice 不支持时退化为 recv + send
+     * @param from 数据来源
+     * @param to 数据去向
+     * @param length 最多转发的字节数
+     * @return 转发的字节数，from 提前关闭时小于 length，没有转发任何数据就出错时返回 -1
+     */
+    static size_t Splice(const Socket::ptr &from, const Socket::ptr &to, size_t length);
+
+    /**
+     * @brief 批量发送数据报，一次 sendmmsg 发送多个，发送缓冲区满时挂起当前协程
+     * @param batch 要发送的数据报
+     * @param flags 标志位
+     * @return 发送的数据报数量，小于 batch.size() 表示出错，一个都没发送就出错时返回 -1
+     */
+    size_t sendBatch(DatagramBatch &batch, int flags = 0);
+
+    /**
+     * @brief 批量接收数据报，没有数据报时挂起当前协程，读到第一个之后把已经到达的一起读出，最多 batch.capacity() 个
+     * @param batch 接收缓冲区，原有内容被清空
+     * @param flags 标志位
+     * @return 接收的数据报数量，出错返回 -1
+     */
+    size_t recvBatch(DatagramBatch &batch, int flags = 0);
+
+    /**
+     * @brief 开启 UDP GRO，内核把同一条流连续到达的数据报合并成一个交给 recvBatch，减少系统调用和协议栈开销
+     * @param on 是否开启
+     * @return 操作是否成功，内核不支持时返回 false
+     */
+    bool setGRO(bool on);
+
+    /**
+     * @brief 开启零拷贝发送（SO_ZEROCOPY）
+     * @param threshold sendZeroCopy 的长度达到这个值才使用 MSG_ZEROCOPY
+     * @return 操作是否成功，内核或协议不支持时返回 false，sendZeroCopy 退化为普通发送
+     */
+    bool setZeroCopy(size_t threshold = ZEROCOPY_THRESHOLD);
+
+    /**
+     * @brief 零拷贝发送，内核直接引用 buffer 的内存，发送完成的通知到来之前 owner 一直被持有
+     * @details 完成通知在错误队列中，由 Reactor 的 ERROR 事件回调回收；没有开启零拷贝或长度小于阈值时就是普通的 send。
+     * 同一个套接字同时只能有一个协程发送
+     * @param buffer 数据
+     * @param length 数据长度
+     * @param owner buffer 的所有者，buffer 在 owner 释放之前不能修改
+     * @param flags 标志位
+     * @return 发送的字节数，与 send 相同，可能只发送了一部分
+     */
+    size_t sendZeroCopy(const void *buffer, size_t length, std::shared_ptr<void> owner, int flags = 0);
     // endregion
 
     // region # Getter
@@ -158,9 +322,24 @@ public:
 
     bool isConnected() const { return connected_; }
 
-    Address::ptr getLocalAddress() { return local_address; }
+    /**
+     * @brief 最后一次成功收发数据的时间，单调时钟，毫秒
+     */
+    uint64_t getLastActiveTime() const { return last_active_ms_.load(std::memory_order_relaxed); }
+
+    Address::ptr getLocalAddress() const { return local_address; }
+
+    Address::ptr getPeerAddress() const { return peer_address; }
+
+    /**
+     * @brief 还在等待完成通知的零拷贝发送次数
+     */
+    size_t getZeroCopyPending();
 
-    Address::ptr getPeerAddress() { return peer_address; }
+    /**
+     * @brief 内核没能零拷贝、实际做了拷贝的完成通知数量（一条通知可能覆盖多次发送），回环地址和不支持分散聚集的网卡上总是拷贝
+     */
+    uint64_t getZeroCopyCopied() const { return zerocopy_copied_; }
 
     int getError() const;
     // endregion
@@ -190,6 +369,30 @@ public:
      */
     std::string toString() const;
 
+protected:
+    /**
+     * @brief 根据现有的 fd 构造套接字(例如根据conn_fd创建一个套接字对象)
+     * @param fd socket 文件描述符
+     * @param family 协议簇
+     * @param type 套接字类型
+     * @param protocol 传输协议
+     */
+    Socket(int fd, int family, int type, int protocol);
+
+    /**
+     * @brief 为 accept 得到的连接创建套接字对象，子类返回自己的类型
+     * @param fd 连接的文件描述符
+     * @return 套接字
+     */
+    virtual Socket::ptr newSocket(int fd);
+
+    /**
+     * @brief 收发成功时记录活跃时间，只是一次写入，不操作定时器
+     * @param rt 收发的返回值
+     * @return rt
+     */
+    size_t touch(size_t rt);
+
 private:
     /**
      * @brief 获取 socket 选项值实际操作
@@ -216,14 +419,47 @@ private:
      */
     void setReuseAndNodelay();
 
+
     /**
-     * @brief 私有构造函数，根据现有的 fd 构造套接字(例如根据conn_fd创建一个套接字对象)
-     * @param fd socket 文件描述符
-     * @param family 协议簇
-     * @param type 套接字类型
-     * @param protocol 传输协议
+     * @brief 发送完整个缓冲区，send 只发送了一部分时继续发送
+     * @return 发送的字节数，出错时小于 length
      */
-    Socket(int fd, int family, int type, int protocol);
+    size_t sendAll(const char *buffer, size_t length);
+
+    /**
+     * @brief 等待套接字可读或可写，超时时间与 hook 后的 recv/send 相同
+     * @details hook 时挂起当前协程，否则阻塞在 poll 上
+     * @param write 是否等待可写
+     * @return 是否就绪，超时返回 false 且 errno 为 ETIMEDOUT
+     */
+    bool waitReady(bool write);
+
+    /**
+     * @brief 不支持 GSO 时把 batch 中第 i 个数据报按分段长度逐段发送
+     * @return 是否全部发送成功
+     */
+    bool sendSegments(DatagramBatch &batch, size_t i, int flags);
+
+    /**
+     * @brief 数据报套接字不连接也可以收发，流式套接字要连接之后
+     */
+    bool canTransfer() const { return fd_ != -1 && (connected_ || type_ == SOCK_DGRAM); }
+
+    /**
+     * @brief 注册错误事件，等待零拷贝的完成通知，调用时持有 zerocopy_mutex_
+     */
+    void armZeroCopy();
+
+    /**
+     * @brief 错误事件的回调，回收完成通知，还有没完成的发送时重新注册
+     */
+    void onZeroCopy();
+
+    /**
+     * @brief 从错误队列读出所有完成通知，释放对应的缓冲区，调用时持有 zerocopy_mutex_
+     * @return 读到的完成通知数量
+     */
+    size_t reapZeroCopy();
 
     /**
      * @brief 设置本地地址
@@ -250,6 +486,20 @@ private:
     Address::ptr local_address;
     /// 远端地址
     Address::ptr peer_address;
+    /// 最后一次成功收发数据的时间，空闲检测在其他线程读取
+    std::atomic<uint64_t> last_active_ms_;
+    /// 保护零拷贝的状态，完成通知可能在其他线程回收
+    Mutex zerocopy_mutex_;
+    /// 零拷贝阈值，0 表示没有开启
+    size_t zerocopy_threshold_;
+    /// 下一次零拷贝发送的序号，与内核的计数保持一致
+    uint32_t zerocopy_next_;
+    /// 等待完成通知的发送，序号 - 缓冲区所有者
+    std::deque<std::pair<uint32_t, std::shared_ptr<void>>> zerocopy_pending_;
+    /// 注册了错误事件的反应堆，没有注册时为空
+    Reactor *zerocopy_reactor_;
+    /// 内核实际做了拷贝的次数
+    uint64_t zerocopy_copied_;
 };
 }
 
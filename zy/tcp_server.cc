@@ -1,12 +1,20 @@
 #include "tcp_server.h"
 
 #include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "log.h"
+#include "clock.h"
 #include "utils/macro.h"
 
 namespace zy {
+    const uint64_t TCPServer::s_idle_timeout;
+    const uint64_t TCPServer::s_sweep_interval;
+
     TCPServer::TCPServer(std::string name, Reactor *acceptor, Reactor *worker)
-        : name_(std::move(name)), acceptor_(acceptor), worker_(worker), stop_(false) {
+        : name_(std::move(name)), acceptor_(acceptor), worker_(worker), stop_(false)
+        , idle_timeout_(s_idle_timeout) {
         //ZY_LOG_INFO(ZY_LOG_ROOT()) << "create a new tcp server, name = " << getName();
     }
 
@@ -18,7 +26,19 @@ namespace zy {
     }
 
     bool TCPServer::bind(const Address::ptr &address) {
-        sock_ = Socket::CreateTCP(address->getFamily());
+        auto unix_address = std::dynamic_pointer_cast<UnixAddress>(address);
+        if (unix_address && !unix_address->isAbstract()) {
+            // 上次退出时留下的套接字文件会让 bind 返回 EADDRINUSE，只删除套接字文件，不碰普通文件
+            struct stat st{};
+            if (::stat(unix_address->getPath().c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+                ::unlink(unix_address->getPath().c_str());
+            }
+        }
+        if (tls_ctx_) {
+            sock_ = SecureSocket::CreateTCP(tls_ctx_, address->getFamily());
+        } else {
+            sock_ = Socket::CreateTCP(address->getFamily());
+        }
         if (!sock_->bind(address)) {
             ZY_LOG_ERROR(ZY_LOG_ROOT()) << "bind filed errno=" << errno
                                             << " errstr=" << strerror(errno)
@@ -37,10 +57,20 @@ namespace zy {
     void TCPServer::start() {
         ZY_ASSERT(!stop_);
         acceptor_->addTask(std::bind(&TCPServer::handleAccept, shared_from_this()));
+        if (idle_timeout_) {
+            // 检测间隔不超过超时时间的 1/4，超时最多推迟一个间隔
+            uint64_t interval = std::max<uint64_t>(std::min(s_sweep_interval, idle_timeout_ / 4), 1);
+            sweeper_ = worker_->addCondTimer(interval, std::bind(&TCPServer::sweepIdle, this),
+                                             shared_from_this(), true, TimerSlack::ForTimeout(interval));
+        }
     }
 
     void TCPServer::stop() {
         stop_ = true;
+        if (sweeper_) {
+            sweeper_->cancel();
+            sweeper_.reset();
+        }
         acceptor_->addTask([this](){
             sock_->cancelRead();
             sock_->close();
@@ -51,8 +81,11 @@ namespace zy {
         while (!stop_) {
             Socket::ptr client = sock_->accept();
             if (client) {
-                client->setRecvTimeout(s_recv_timeout);
-                client->setSendTimeout(s_send_timeout);
+                // 不再给每次收发设置超时，由 sweepIdle 统一检测连接是否空闲
+                if (idle_timeout_) {
+                    Mutex::Lock lock(clients_mutex_);
+                    clients_.push_back(client);
+                }
                 worker_->addTask(std::bind(&TCPServer::handleClient, shared_from_this(), client));
             } else {
                 ZY_LOG_ERROR(ZY_LOG_ROOT()) << "accept errno = " << errno
@@ -61,6 +94,29 @@ namespace zy {
         }
     }
 
+    void TCPServer::sweepIdle() {
+        // 和 Socket::touch 用同一个实时时钟，循环时间在长任务里会落后
+        uint64_t now = Clock::NowMs();
+        Mutex::Lock lock(clients_mutex_);
+        auto it = clients_.begin();
+        while (it != clients_.end()) {
+            Socket::ptr client = it->lock();
+            if (!client || !client->isConnected()) {
+                it = clients_.erase(it);
+                continue;
+            }
+            // 活跃时间由其他线程写入，可能比上面读到的当前时间还新
+            uint64_t last = client->getLastActiveTime();
+            if (now > last && now - last >= idle_timeout_) {
+                ZY_LOG_INFO(ZY_LOG_ROOT()) << "client idle timeout, " << client->toString();
+                client->shutdown();
+                it = clients_.erase(it);
+                continue;
+            }
+            ++it;
+        }
+    }
+
     void TCPServer::handleClient(const Socket::ptr &client) {
         ZY_LOG_INFO(ZY_LOG_ROOT()) << "handleClient" << client->toString();
     }
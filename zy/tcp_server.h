@@ -2,8 +2,10 @@
 #define __ZY_TCP_SERVER_H__
 
 #include <memory>
+#include <list>
 #include "reactor.h"
 #include "socket.h"
+#include "secure_socket.h"
 #include "utils/noncopyable.h"
 
 namespace zy {
@@ -44,10 +46,22 @@ namespace zy {
          */
         void stop();
 
+        /**
+         * @brief 设置 TLS 上下文，需要在 bind 之前设置，之后接受的连接都是 SecureSocket，在 worker 上第一次收发时握手
+         * @param ctx 服务端 TLS 上下文，为空表示明文
+         */
+        void setTlsContext(const TlsContext::ptr &ctx) { tls_ctx_ = ctx; }
+
+        /**
+         * @brief 设置连接的空闲超时时间，需要在 start 之前设置
+         * @param timeout 超时时间，毫秒，连接在这段时间内没有收发数据就会被关闭，0 表示不检测
+         */
+        void setIdleTimeout(uint64_t timeout) { idle_timeout_ = timeout; }
+
         // region # Getter
-        static uint64_t getRecvTimeout() { return s_recv_timeout; }
+        uint64_t getIdleTimeout() const { return idle_timeout_; }
 
-        static uint64_t getSendTimeout() { return s_send_timeout; }
+        const TlsContext::ptr &getTlsContext() const { return tls_ctx_; }
 
         const std::string &getName() const { return name_; }
 
@@ -74,10 +88,17 @@ namespace zy {
         virtual void handleClient(const Socket::ptr &client);
 
     private:
-        /// 接收超时时间
-        static const uint64_t s_recv_timeout = 1000 * 2 * 60;
-        /// 发送超时时间
-        static const uint64_t s_send_timeout = 1000 * 1 * 60;
+        /**
+         * @brief 检查所有连接，关闭空闲超时的连接，由 worker 上的循环定时器执行
+         * @details 关闭只是 shutdown 连接，阻塞在 recv 上的 handleClient 会收到 0 并自行清理
+         */
+        void sweepIdle();
+
+    private:
+        /// 默认的空闲超时时间
+        static const uint64_t s_idle_timeout = 1000 * 2 * 60;
+        /// 空闲检测的最大间隔
+        static const uint64_t s_sweep_interval = 1000;
     private:
         /// TCP 服务器名称
         std::string name_;
@@ -87,8 +108,17 @@ namespace zy {
         Reactor *worker_;
         /// 监听 socket
         Socket::ptr sock_;
+        /// TLS 上下文，为空表示明文
+        TlsContext::ptr tls_ctx_;
         /// 服务器是否停止
         bool stop_;
+        /// 空闲超时时间，毫秒
+        uint64_t idle_timeout_;
+        /// 空闲检测定时器
+        Timer::ptr sweeper_;
+        /// 需要做空闲检测的连接，连接释放后在下一次检测时移除
+        std::list<std::weak_ptr<Socket>> clients_;
+        Mutex clients_mutex_;
     };
 }
 
@@ -1,165 +1,579 @@
 #include "timer.h"
-#include "utils/util.h"
+#include "clock.h"
 
 namespace zy {
 
-bool Timer::Comparator::operator() (const Timer::ptr& lhs
-                            ,const Timer::ptr& rhs) const {
-    if(!lhs && !rhs) {
+bool Timer::cancel() {
+    uint64_t word = state_.load();
+    while (StateOf(word) == ARMED) {
+        if (state_.compare_exchange_weak(word, MakeState(word, CANCELLED))) {
+            --manager_->timer_num_;
+            // 回调和自身的引用由持有线程释放
+            manager_->abandon(this);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Timer::refresh() {
+    if (StateOf(state_.load()) != ARMED) {
         return false;
     }
-    if(!lhs) {
-        return true;
+    // 只会推迟，其他线程持有时由持有线程在原来的时间到期时重新挂上
+    req_time_.store(Clock::NowUs() + period_.load());
+    TimerQueue *queue = manager_->localQueue();
+    if (queue && owner_.load() == queue) {
+        TimerManager::place(queue, this);
     }
-    if(!rhs) {
+    return true;
+}
+
+bool Timer::resetUs(uint64_t period, bool from_now) {
+    if (StateOf(state_.load()) != ARMED) {
         return false;
     }
-    if(lhs->time_ < rhs->time_) {
-        return true;
+    uint64_t old_period = period_.exchange(period);
+    uint64_t start = from_now ? Clock::NowUs() : req_time_.load() - old_period;
+    req_time_.store(start + period);
+    // 执行时间可能提前，需要交给持有线程重新挂
+    manager_->schedule(this);
+    return true;
+}
+
+Timer::Timer(bool recurring, uint64_t period, std::function<void()> callback, TimerManager *manager,
+             uint32_t slack)
+    : recurring_(recurring), period_(period)
+    , timer_cb_(std::move(callback)), manager_(manager) {
+    req_time_.store(Clock::NowUs() + period);
+    slack_ = slack;
+}
+
+
+
+TimerQueue::TimerQueue(uint64_t tick_us)
+    : wheel_(tick_us, Clock::LoopNowUs()), inbox_(nullptr), wait_time_(0) {
+}
+
+void TimerQueue::Push(std::atomic<TimerNode *> &inbox, TimerNode *node) {
+    TimerNode *head = inbox.load();
+    do {
+        node->queue_next_ = head;
+    } while (!inbox.compare_exchange_weak(head, node));
+}
+
+TimerNode *TimerQueue::PopAll(std::atomic<TimerNode *> &inbox) {
+    TimerNode *node = inbox.exchange(nullptr);
+    // 栈是后进先出的，反转成放入的顺序
+    TimerNode *list = nullptr;
+    while (node) {
+        TimerNode *next = node->queue_next_;
+        node->queue_next_ = list;
+        list = node;
+        node = next;
     }
-    if(rhs->time_ < lhs->time_) {
-        return false;
+    return list;
+}
+
+void TimerQueue::release() {
+    // 逐个析构，定时器回调捕获的对象析构时可能再次操作定时器
+    while (!released_.empty()) {
+        Timer::ptr timer = std::move(released_.back());
+        released_.pop_back();
     }
-    return lhs.get() < rhs.get();
 }
 
 
 
-bool Timer::cancel() {
-    RWMutex::WriteLock lock(manager_->mutex_);
-    if (timer_cb_) {
-        timer_cb_ = nullptr;
-        // 在set中找到自身定时器
-        auto it = manager_->timers_.find(shared_from_this());
-        // 找到删除
-        manager_->timers_.erase(it);
-        return true;
+TimerWheel::TimerWheel(uint64_t tick_us, uint64_t now_us)
+    : tick_us_(tick_us ? tick_us : 1), current_(0), size_(0)
+    , slots_(ROOT_SIZE + (LEVELS - 1) * LEVEL_SIZE) {
+    current_ = now_us / tick_us_;
+    for (auto &size : level_size_) {
+        size = 0;
+    }
+    // 空槽位的哨兵指向自身
+    for (auto &head : slots_) {
+        head.prev_ = &head;
+        head.next_ = &head;
     }
-    return false;
 }
 
-bool Timer::refresh() {
-    RWMutex::WriteLock lock(manager_->mutex_);
-    if (!timer_cb_) {
-        return false;
+void TimerWheel::add(TimerNode *node) {
+    link(node, toTick(node->time_));
+    ++size_;
+}
+
+void TimerWheel::remove(TimerNode *node) {
+    node->prev_->next_ = node->next_;
+    node->next_->prev_ = node->prev_;
+    node->prev_ = nullptr;
+    node->next_ = nullptr;
+    --size_;
+    --level_size_[node->level_];
+}
+
+void TimerWheel::clear(std::vector<TimerNode *> &nodes) {
+    for (auto &head : slots_) {
+        TimerNode *node = head.next_;
+        while (node != &head) {
+            TimerNode *next = node->next_;
+            node->prev_ = nullptr;
+            node->next_ = nullptr;
+            nodes.push_back(node);
+            node = next;
+        }
+        head.prev_ = &head;
+        head.next_ = &head;
     }
-    // 在set中找到自身定时器
-    auto it = manager_->timers_.find(shared_from_this());
-    if (it == manager_->timers_.end()) {
-        return false;
+    size_ = 0;
+    for (auto &size : level_size_) {
+        size = 0;
     }
-    // 删除
-    manager_->timers_.erase(it);
-    // 更新执行时间
-    time_ = getCurrentTime() + period_;
-    // 重新插入，这样能按最新的时间排序
-    manager_->timers_.insert(shared_from_this());
-    return true;
 }
 
-bool Timer::reset(uint64_t period, bool from_now) {
-    RWMutex::WriteLock lock(manager_->mutex_);
-    if(!timer_cb_) {
-        return false;
+void TimerWheel::link(TimerNode *node, uint64_t expires) {
+    if (expires < current_) {
+        // 已经过期的定时器放到下一个要处理的槽位
+        expires = current_;
     }
-    // 在set中找到自身定时器
-    auto it = manager_->timers_.find(shared_from_this());
-    if (it == manager_->timers_.end()) {
-        return false;
+    uint64_t delta = expires - current_;
+    if (delta >= MAX_SPAN) {
+        // 超出时间轮范围的放到最高层最远的槽位，cascade 时会重新计算
+        expires = current_ + MAX_SPAN - 1;
+        delta = MAX_SPAN - 1;
     }
-    // 删除定时器
-    manager_->timers_.erase(it);
 
-    // 更新数据
-    period_ = period;
-    time_ = from_now ? getCurrentTime() + period_ : time_;
-    // 重新加入set中
-    manager_->addTimer(shared_from_this(), lock);
-    return true;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << Shift(level + 1))) {
+        ++level;
+    }
+    uint64_t index = (expires >> Shift(level)) & (Slots(level) - 1);
+    TimerNode &head = slot(level, index);
+    node->next_ = &head;
+    node->prev_ = head.prev_;
+    head.prev_->next_ = node;
+    head.prev_ = node;
+    node->level_ = level;
+    ++level_size_[level];
 }
 
-Timer::Timer(uint64_t time)
-    : recurring_(false), period_(0), time_(time), timer_cb_(nullptr), manager_(nullptr) {
+void TimerWheel::cascade(int level, uint64_t index) {
+    TimerNode &head = slot(level, index);
+    TimerNode *node = head.next_;
+    head.prev_ = &head;
+    head.next_ = &head;
+    while (node != &head) {
+        TimerNode *next = node->next_;
+        --level_size_[level];
+        link(node, toTick(node->time_));
+        node = next;
+    }
 }
 
-Timer::Timer(bool recurring, uint64_t period, std::function<void()> callback, TimerManager *manager)
-    : recurring_(recurring), period_(period), time_(getCurrentTime() + period_)
-    , timer_cb_(std::move(callback)), manager_(manager) {
+void TimerWheel::advance(uint64_t now_us, std::vector<TimerNode *> &expired) {
+    uint64_t now_tick = now_us / tick_us_;
+    if (size_ == 0) {
+        // 没有定时器时直接跳到当前时间
+        current_ = std::max(current_, now_tick + 1);
+        return;
+    }
+    while (current_ <= now_tick && size_ > 0) {
+        uint64_t index = current_ & (ROOT_SIZE - 1);
+        if (index == 0) {
+            // 第 0 层转完一圈，逐层 cascade
+            for (int level = 1; level < LEVELS; ++level) {
+                uint64_t level_index = (current_ >> Shift(level)) & (LEVEL_SIZE - 1);
+                cascade(level, level_index);
+                if (level_index != 0) {
+                    break;
+                }
+            }
+        }
+
+        TimerNode &head = slot(0, index);
+        TimerNode *node = head.next_;
+        while (node != &head) {
+            TimerNode *next = node->next_;
+            node->prev_ = nullptr;
+            node->next_ = nullptr;
+            expired.push_back(node);
+            --size_;
+            --level_size_[0];
+            node = next;
+        }
+        head.prev_ = &head;
+        head.next_ = &head;
+        ++current_;
+
+        if (level_size_[0] == 0 && current_ <= now_tick) {
+            // 第 0 层为空，直接跳到下一次 cascade 的位置
+            uint64_t next_cascade = (current_ + ROOT_SIZE - 1) & ~(ROOT_SIZE - 1);
+            current_ = std::min(next_cascade, now_tick + 1);
+        }
+    }
+    if (size_ == 0) {
+        current_ = std::max(current_, now_tick + 1);
+    }
+}
+
+uint64_t TimerWheel::nextExpireTime() const {
+    if (size_ == 0) {
+        return ~0ull;
+    }
+    uint64_t next = ~0ull;
+    // 第 0 层：从当前槽位开始找第一个非空槽位，就是精确的到期 tick
+    for (uint64_t i = 0; i < ROOT_SIZE; ++i) {
+        uint64_t tick = current_ + i;
+        const TimerNode &head = slot(0, tick & (ROOT_SIZE - 1));
+        if (head.next_ != &head) {
+            next = tick;
+            break;
+        }
+    }
+    // 高层：找到下一个会被 cascade 的非空槽位，它的 cascade 时间是一个下界
+    for (int level = 1; level < LEVELS; ++level) {
+        int shift = Shift(level);
+        uint64_t base = (current_ + (1ull << shift) - 1) >> shift;
+        for (uint64_t i = 0; i < LEVEL_SIZE; ++i) {
+            uint64_t pos = base + i;
+            if ((pos << shift) >= next) {
+                break;
+            }
+            const TimerNode &head = slot(level, pos & (LEVEL_SIZE - 1));
+            if (head.next_ != &head) {
+                next = pos << shift;
+                break;
+            }
+        }
+    }
+    return next == ~0ull ? next : next * tick_us_;
 }
 
 
 
-Timer::ptr TimerManager::addTimer(uint64_t period, std::function<void()> callback, bool recurring) {
-    Timer::ptr timer1(new Timer(recurring, period, std::move(callback), this));
-    RWMutex::WriteLock lock(mutex_);
-    addTimer(timer1, lock);
+/// 管理器编号
+static std::atomic<uint64_t> s_manager_id{0};
+/// 当前线程绑定的定时器队列，以管理器编号为键，管理器析构后留下的条目不会再被访问
+static thread_local std::vector<std::pair<uint64_t, TimerQueue *>> t_queues;
+
+TimerManager::TimerManager(uint64_t tick_us)
+    : id_(++s_manager_id), tick_us_(tick_us), shared_inbox_(nullptr)
+    , timer_num_(0), tickled_(false), queue_num_(0) {
+    for (auto &queue : queues_) {
+        queue.store(nullptr);
+    }
+}
+
+TimerManager::~TimerManager() {
+    clearAll();
+    for (uint32_t i = 0; i < queue_num_; ++i) {
+        delete queues_[i].load();
+    }
+}
+
+Timer::ptr TimerManager::addTimerUs(uint64_t period, std::function<void()> callback, bool recurring,
+                                    uint32_t slack) {
+    Timer::ptr timer1(new Timer(recurring, period, std::move(callback), this, slack));
+    timer1->self_ = timer1;
+    timer1->state_.store(TimerNode::ARMED);
+    ++timer_num_;
+    schedule(timer1.get());
     return timer1;
 }
 
 Timer::ptr TimerManager::addCondTimer(uint64_t period, const std::function<void()>& cb,
-                                        const std::weak_ptr<void> &weak_cond, bool recurring) {
+                                        const std::weak_ptr<void> &weak_cond, bool recurring,
+                                        uint32_t slack) {
     return addTimer(period, [weak_cond, cb]() {
         std::shared_ptr<void> tmp = weak_cond.lock();
         if (tmp) {
             cb();
         }
-    }, recurring);
+    }, recurring, slack);
 }
 
-uint64_t TimerManager::getNextTime() {
-    RWMutex::ReadLock lock(mutex_);
+uint64_t TimerManager::getNextTimeUs() {
+    TimerQueue *queue = bindThread();
+    if (!queue) {
+        return ~0ull;
+    }
     tickled_ = false;
+    uint64_t next_time = ~0ull;
+    do {
+        drain(queue);
+        next_time = queue->wheel_.nextExpireTime();
+        // 先公布等待时间再检查收件箱，和 notify 的先放入再读等待时间配对，两边至少有一边能看到对方
+        queue->wait_time_.store(next_time);
+    } while (shared_inbox_.load() || queue->inbox_.load());
+    queue->release();
+
     // 如果没有定时器，返回一个最大值
-    if (timers_.empty()) {
+    if (next_time == ~0ull) {
         return ~0ull;
     }
-    // 拿到第一个定时器
-    const Timer::ptr& next = *timers_.begin();
-    uint64_t now_ms = getCurrentTime();
+    uint64_t now_us = Clock::LoopNowUs();
     // 如果当前时间 >= 该定时器的执行时间，说明该定时器已经超时了，该执行了
-    if (now_ms >= next->time_) {
+    if (now_us >= next_time) {
         return 0;
     } else {
         // 还没超时，返回还要多久执行
-        return next->time_ - now_ms;
+        return next_time - now_us;
     }
 }
 
 void TimerManager::listExpiredCallback(std::vector<std::function<void()> >& cbs) {
-    {
-        RWMutex::ReadLock lock(mutex_);
-        if (timers_.empty()) {
-            return;
-        }
+    TimerQueue *queue = bindThread();
+    if (!queue) {
+        return;
+    }
+    // 醒着的线程稍后一定会再调用 getNextTime，其他线程不需要为它唤醒反应堆
+    queue->wait_time_.store(0);
+    drain(queue);
+    if (queue->wheel_.empty()) {
+        queue->release();
+        return;
     }
 
-    uint64_t now = getCurrentTime();
-    std::vector<Timer::ptr> expired;
-    RWMutex::WriteLock lock(mutex_);
-    Timer::ptr timer1(new Timer(now));
-    auto it = timers_.upper_bound(timer1);
-    expired.insert(expired.begin(), timers_.begin(), it);
+    uint64_t now = Clock::LoopNowUs();
+    uint64_t now_tick = now / queue->wheel_.getTickUs();
+    queue->expired_.clear();
+    queue->wheel_.advance(now, queue->expired_);
 
-    for (auto &timer : expired) {
-        cbs.push_back(timer->timer_cb_);
-        timers_.erase(timer);
+    for (auto node : queue->expired_) {
+        uint64_t word = node->state_.load();
+        if (TimerNode::StateOf(word) != TimerNode::ARMED) {
+            drop(queue, node);
+            continue;
+        }
+        // 其他线程推迟过执行时间，重新挂上
+        uint64_t time = TimerSlack::Coalesce(node->req_time_.load(), node->slack_);
+        if (queue->wheel_.toTick(time) > now_tick) {
+            place(queue, node);
+            continue;
+        }
+        if (node->on_expire_) {
+            // 调用者持有的节点直接在这里处理，不产生回调任务
+            uint64_t fired = TimerNode::MakeState(word, TimerNode::FIRED);
+            if (node->state_.compare_exchange_strong(word, fired)) {
+                node->owner_.store(nullptr);
+                node->on_expire_(node, fired);
+            } else {
+                drop(queue, node);
+            }
+            continue;
+        }
+        auto timer = static_cast<Timer *>(node);
         if (timer->recurring_) {
-            timer->time_ = now + timer->time_;
-            timers_.insert(timer);
+            cbs.push_back(timer->timer_cb_);
+            timer->req_time_.store(now + timer->period_.load());
+            place(queue, timer);
+            continue;
         }
+        if (timer->state_.compare_exchange_strong(word, TimerNode::MakeState(word, TimerNode::FIRED))) {
+            --timer_num_;
+            cbs.push_back(std::move(timer->timer_cb_));
+        }
+        drop(queue, timer);
+    }
+    queue->release();
+}
+
+TimerQueue *TimerManager::bindThread() {
+    TimerQueue *queue = localQueue();
+    if (queue) {
+        return queue;
+    }
+    Mutex::Lock lock(mutex_);
+    uint32_t num = queue_num_.load();
+    if (num >= MAX_QUEUES) {
+        return nullptr;
+    }
+    queue = new TimerQueue(tick_us_);
+    queues_[num].store(queue);
+    queue_num_.store(num + 1);
+    t_queues.emplace_back(id_, queue);
+    return queue;
+}
+
+void TimerManager::armNode(TimerNode *node, uint64_t time) {
+    node->req_time_.store(time);
+    node->state_.store(TimerNode::MakeState(node->state_.load(), TimerNode::ARMED));
+    schedule(node);
+}
+
+bool TimerManager::disarmNode(TimerNode *node) {
+    uint64_t word = node->state_.load();
+    while (TimerNode::StateOf(word) == TimerNode::ARMED) {
+        if (node->state_.compare_exchange_weak(word, TimerNode::MakeState(word, TimerNode::CANCELLED))) {
+            abandon(node);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TimerManager::clearAll() {
+    std::vector<TimerNode *> nodes;
+    std::vector<Timer::ptr> released;
+    auto clear_inbox = [&](std::atomic<TimerNode *> &inbox) {
+        TimerNode *node = TimerQueue::PopAll(inbox);
+        while (node) {
+            TimerNode *next = node->queue_next_;
+            if (!node->on_expire_) {
+                released.push_back(std::move(static_cast<Timer *>(node)->pin_));
+            }
+            node->queued_.store(false);
+            nodes.push_back(node);
+            node = next;
+        }
+    };
+    clear_inbox(shared_inbox_);
+    for (uint32_t i = 0; i < queue_num_; ++i) {
+        TimerQueue *queue = queues_[i].load();
+        queue->wheel_.clear(nodes);
+        clear_inbox(queue->inbox_);
+        queue->wait_time_.store(0);
+        queue->release();
+    }
+    for (auto node : nodes) {
+        if (!node->on_expire_) {
+            auto timer = static_cast<Timer *>(node);
+            timer->timer_cb_ = nullptr;
+            if (timer->self_) {
+                released.push_back(std::move(timer->self_));
+            }
+        }
+        node->owner_.store(nullptr);
+    }
+    timer_num_.store(0);
+}
+
+TimerQueue *TimerManager::localQueue() const {
+    for (auto &binding : t_queues) {
+        if (binding.first == id_) {
+            return binding.second;
+        }
+    }
+    return nullptr;
+}
+
+void TimerManager::schedule(TimerNode *node) {
+    TimerQueue *queue = localQueue();
+    TimerQueue *owner = node->owner_.load();
+    if (queue && (owner == queue
+                  || (owner == nullptr && node->owner_.compare_exchange_strong(owner, queue)))) {
+        // 本线程持有，直接挂上；本线程在睡眠前一定会调用 getNextTime，不需要通知
+        place(queue, node);
+        return;
+    }
+    if (enqueue(owner ? owner->inbox_ : shared_inbox_, node)) {
+        notify(owner, TimerSlack::Coalesce(node->req_time_.load(), node->slack_));
     }
 }
 
-void TimerManager::addTimer(const Timer::ptr &timer, RWMutex::WriteLock &lock) {
-    auto it = timers_.insert(timer).first;
-    if (it == timers_.begin() && !tickled_) {
-        tickled_ = true;
+void TimerManager::abandon(TimerNode *node) {
+    TimerQueue *queue = localQueue();
+    TimerQueue *owner = node->owner_.load();
+    if (queue && owner == queue) {
+        drop(queue, node);
+        queue->release();
+        return;
     }
-    lock.unlock();
-    if (tickled_) {
+    // 交给持有线程摘下，不需要通知，最晚在原来的执行时间摘下
+    enqueue(owner ? owner->inbox_ : shared_inbox_, node);
+}
+
+bool TimerManager::enqueue(std::atomic<TimerNode *> &inbox, TimerNode *node) {
+    if (node->queued_.exchange(true)) {
+        // 已经在某个收件箱中，处理时会读取最新的状态
+        return false;
+    }
+    if (!node->on_expire_) {
+        // 在收件箱中时定时器可能已经没有其他引用
+        auto timer = static_cast<Timer *>(node);
+        timer->pin_ = timer->shared_from_this();
+    }
+    TimerQueue::Push(inbox, node);
+    return true;
+}
+
+void TimerManager::notify(TimerQueue *target, uint64_t time) {
+    if (target) {
+        uint64_t wait_time = target->wait_time_.load();
+        if (wait_time == 0 || wait_time <= time) {
+            // 持有线程醒着，或者会在这之前醒来
+            return;
+        }
+    } else {
+        uint32_t num = queue_num_.load();
+        for (uint32_t i = 0; i < num; ++i) {
+            uint64_t wait_time = queues_[i].load()->wait_time_.load();
+            // 有线程会在这之前醒来，醒来后会收养共享收件箱里的定时器
+            if (wait_time != 0 && wait_time <= time) {
+                return;
+            }
+        }
+    }
+    // 同一轮等待只通知一次；反应堆唤醒的不一定是持有线程，持有线程收件箱中提前的定时器最晚在它下一次醒来时生效
+    if (!tickled_.exchange(true)) {
         onTimerInsertAtFront();
     }
 }
 
+void TimerManager::drain(TimerQueue *queue) {
+    for (auto inbox : {&shared_inbox_, &queue->inbox_}) {
+        TimerNode *node = TimerQueue::PopAll(*inbox);
+        while (node) {
+            // 清除 queued_ 之后节点可能马上被放入其他收件箱，先取出下一个
+            TimerNode *next = node->queue_next_;
+            if (!node->on_expire_) {
+                queue->released_.push_back(std::move(static_cast<Timer *>(node)->pin_));
+            }
+            node->queued_.store(false);
+            reconcile(queue, node);
+            node = next;
+        }
+    }
+}
+
+void TimerManager::reconcile(TimerQueue *queue, TimerNode *node) {
+    TimerQueue *owner = nullptr;
+    if (!node->owner_.compare_exchange_strong(owner, queue) && owner != queue) {
+        // 已经被其他线程持有，转交给它
+        if (enqueue(owner->inbox_, node) && TimerNode::StateOf(node->state_.load()) == TimerNode::ARMED) {
+            notify(owner, TimerSlack::Coalesce(node->req_time_.load(), node->slack_));
+        }
+        return;
+    }
+    if (TimerNode::StateOf(node->state_.load()) == TimerNode::ARMED) {
+        place(queue, node);
+    } else {
+        drop(queue, node);
+    }
+}
+
+void TimerManager::place(TimerQueue *queue, TimerNode *node) {
+    if (node->isLinked()) {
+        queue->wheel_.remove(node);
+    }
+    // 取整到精度窗口的边界，同一窗口内的定时器落在同一个 tick
+    node->time_ = TimerSlack::Coalesce(node->req_time_.load(), node->slack_);
+    queue->wheel_.add(node);
+}
+
+void TimerManager::drop(TimerQueue *queue, TimerNode *node) {
+    if (node->isLinked()) {
+        queue->wheel_.remove(node);
+    }
+    if (!node->on_expire_) {
+        auto timer = static_cast<Timer *>(node);
+        timer->timer_cb_ = nullptr;
+        if (timer->self_) {
+            queue->released_.push_back(std::move(timer->self_));
+        }
+    }
+    node->owner_.store(nullptr);
+}
 
-}
\ No newline at end of file
+}
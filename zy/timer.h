@@ -1,17 +1,123 @@
 #ifndef __ZY_TIMER_H__
 #define __ZY_TIMER_H__
 
-#include <set>
 #include <memory>
+#include <algorithm>
 #include <vector>
+#include <atomic>
 #include <functional>
 #include "utils/mutex.h"
+#include "utils/noncopyable.h"
 
 namespace zy {
 
 class TimerManager;
 
-class Timer : public std::enable_shared_from_this<Timer> {
+/**
+ * @brief 定时器精度（允许的延迟），单位毫秒
+ * @details 到期时间向上取整到精度的整数倍，同一个窗口内到期的定时器落在同一个 tick，
+ * 由一次唤醒统一处理；插入到已经在等待的窗口内也不会再唤醒反应堆。
+ */
+struct TimerSlack {
+    enum Precision {
+        /// 精确到时间轮的 tick
+        PRECISE = 0,
+        /// 10ms
+        FINE = 10,
+        /// 100ms
+        COARSE = 100,
+        /// 1s
+        LAZY = 1000,
+    };
+
+    /**
+     * @brief 根据超时时间选择精度，延迟不超过超时时间的 1/10
+     * @param timeout 超时时间，毫秒
+     * @return 精度
+     */
+    static Precision ForTimeout(uint64_t timeout) {
+        return timeout >= 10000 ? LAZY : timeout >= 1000 ? COARSE : timeout >= 100 ? FINE : PRECISE;
+    }
+
+    /**
+     * @brief 将到期时间向上取整到精度的整数倍
+     * @param time 到期时间
+     * @param slack 精度，和到期时间的单位相同
+     * @return 取整后的到期时间
+     */
+    static uint64_t Coalesce(uint64_t time, uint64_t slack) {
+        return slack ? (time + slack - 1) / slack * slack : time;
+    }
+};
+
+class TimerQueue;
+
+/**
+ * @brief 时间轮上的侵入式链表节点
+ * @details 节点自身携带前后指针，挂到时间轮槽位、从槽位摘下都是 O(1) 且不需要额外分配内存。
+ * 节点挂在哪个线程的时间轮上就由哪个线程持有（owner_），链表字段只由持有线程访问；
+ * 其他线程只能修改原子的状态和请求的到期时间，再通过持有线程的收件箱通知它。
+ */
+struct TimerNode {
+    /**
+     * @brief 节点状态，状态字的低 2 位是状态，高位是序号，节点每开始新的一轮使用序号加一
+     */
+    enum State {
+        /// 没有在使用
+        IDLE = 0,
+        /// 等待到期
+        ARMED = 1,
+        /// 已经到期
+        FIRED = 2,
+        /// 已经取消
+        CANCELLED = 3,
+    };
+
+    static uint64_t StateOf(uint64_t word) { return word & 3; }
+
+    static uint64_t MakeState(uint64_t word, State state) { return (word & ~3ull) | state; }
+
+    /**
+     * @brief 节点是否挂在时间轮上，只能由持有线程调用
+     */
+    bool isLinked() const { return prev_ != nullptr; }
+
+    /**
+     * @brief 开始新的一轮使用，序号加一，上一轮还没有执行完的到期处理可以据此发现自己已经过时
+     * @return 新的状态字
+     */
+    uint64_t renew() {
+        uint64_t word = (state_.load() & ~3ull) + 4;
+        state_.store(word);
+        return word;
+    }
+
+    /// 前一个节点，挂在槽位上时不为空（槽位头节点的 prev_ 指向槽位本身的哨兵）
+    TimerNode *prev_ = nullptr;
+    /// 后一个节点
+    TimerNode *next_ = nullptr;
+    /// 挂在时间轮上的执行时间，按精度取整，单调时钟，微秒
+    uint64_t time_ = 0;
+    /// 所在的时间轮层
+    uint32_t level_ = 0;
+    /// 精度，微秒，见 TimerSlack
+    uint32_t slack_ = 0;
+    /// 到期时在持有线程内直接执行的函数，参数是到期时的状态字，为空表示这是一个 Timer
+    void (*on_expire_)(TimerNode *node, uint64_t state) = nullptr;
+    /// 收件箱链表的下一个节点
+    TimerNode *queue_next_ = nullptr;
+
+    /// 状态字
+    std::atomic<uint64_t> state_{IDLE};
+    /// 请求的执行时间，其他线程刷新定时器时只修改它，持有线程在到期时发现推迟了就重新挂上
+    std::atomic<uint64_t> req_time_{0};
+    /// 持有节点的线程的队列，为空表示节点不在任何时间轮上
+    std::atomic<TimerQueue *> owner_{nullptr};
+    /// 节点是否在某个收件箱中，同一时间只能在一个收件箱中
+    std::atomic<bool> queued_{false};
+};
+
+class Timer : public TimerNode, public std::enable_shared_from_this<Timer> {
     friend class TimerManager;
 
 public:
@@ -23,106 +129,312 @@ public:
     using timer_callback = std::function<void()>;
 
     /**
-     * @brief 取消定时器
+     * @brief 取消定时器，可以在任意线程调用
+     * @details 在持有线程调用时立即从时间轮上摘下，否则交给持有线程摘下，回调不会再执行
      * @return 操作是否成功
      */
     bool cancel();
 
     /**
-     * @brief 重新设置定时器的执行时间
-     * @details time_ = getCurrentTime() + period
+     * @brief 重新设置定时器的执行时间，可以在任意线程调用
+     * @details 执行时间 = Clock::NowUs() + period，只会推迟，其他线程调用时只记录新的时间，持有线程在原来的时间发现推迟后重新挂上
      * @return 操作是否成功
      */
     bool refresh();
 
     /**
-     * @brief 重置定时器
-     * @param period 新的周期
+     * @brief 重置定时器，可以在任意线程调用
+     * @details 在其他线程把执行时间提前时，如果反应堆唤醒的不是持有线程，最多推迟到持有线程下一次醒来
+     * @param period 新的周期，毫秒
      * @param from_now 是否重当前时间开始计时
      * @return 操作是否成功
      */
-    bool reset(uint64_t period, bool from_now);
+    bool reset(uint64_t period, bool from_now) { return resetUs(period * 1000, from_now); }
 
-private:
     /**
-     * @brief 私有构造函数，用在 ClockManager::clocks_ 的二分查找中
-     * @param time 定时器发生的时间
+     * @brief 重置定时器，可以在任意线程调用
+     * @param period 新的周期，微秒
+     * @param from_now 是否重当前时间开始计时
+     * @return 操作是否成功
      */
-    explicit Timer(uint64_t time);
+    bool resetUs(uint64_t period, bool from_now);
 
+private:
     /**
      * @brief 私有构造函数
      * @param recurring 是否重复
-     * @param period 周期
+     * @param period 周期，微秒
      * @param callback 定时器回调函数
      * @param manager 所属的定时器管理器
+     * @param slack 精度，微秒
      */
     Timer(bool recurring, uint64_t period, timer_callback cb,
-        TimerManager* manager);
+        TimerManager* manager, uint32_t slack);
 
 private:
     //是否循环定时器
-    bool recurring_ = false;  
-    /// 执行周期
-    uint64_t period_ = 0;
-    //精确的执行时间
-    uint64_t time_ = 0;     
-    /// 定时器回调函数   
+    bool recurring_ = false;
+    /// 执行周期，微秒，可以被其他线程 reset
+    std::atomic<uint64_t> period_;
+    /// 定时器回调函数，只由持有线程在到期或者取消时访问
     timer_callback timer_cb_;
     /// 定时器所属的管理器
     TimerManager* manager_ = nullptr;
+    /// 到期或者取消之前持有自身，用户丢弃 Timer::ptr 后定时器依然有效，由持有线程释放
+    Timer::ptr self_;
+    /// 在收件箱中时持有自身，取出时释放
+    Timer::ptr pin_;
+};
+
+/**
+ * @brief 分层时间轮
+ * @details 第 0 层 256 个槽，每槽一个 tick；第 1~3 层各 64 个槽，每层槽的跨度是上一层的整圈。
+ * 定时器按到期 tick 与当前 tick 的差值放入对应层，低层转完一圈时把高层对应槽位的定时器重新分配（cascade）。
+ * 增加、删除都是 O(1)，到期处理均摊 O(1)。本类不加锁，只由所属线程访问。
+ */
+class TimerWheel {
+public:
+    /**
+     * @brief 构造函数
+     * @param tick_us 每个 tick 的微秒数
+     * @param now_us 当前时间
+     */
+    TimerWheel(uint64_t tick_us, uint64_t now_us);
+
+    /**
+     * @brief 将节点加入时间轮，节点的 time_ 必须已经设置
+     * @param node 节点
+     */
+    void add(TimerNode *node);
+
+    /**
+     * @brief 将节点从时间轮上摘下
+     * @param node 节点
+     */
+    void remove(TimerNode *node);
+
+    /**
+     * @brief 推进时间轮到 now_us，摘下所有到期的节点
+     * @param now_us 当前时间
+     * @param expired 到期的节点
+     */
+    void advance(uint64_t now_us, std::vector<TimerNode *> &expired);
+
+    /**
+     * @brief 摘下时间轮上的所有节点
+     * @param nodes 所有节点
+     */
+    void clear(std::vector<TimerNode *> &nodes);
+
+    /**
+     * @brief 获取下一次需要推进时间轮的时间
+     * @details 对第 0 层是精确的到期时间，对高层是对应槽位 cascade 的时间，只会提前不会推迟
+     * @return 时间，微秒，没有节点时返回 ~0ull
+     */
+    uint64_t nextExpireTime() const;
+
+    /**
+     * @brief 获取 time_us 所在的 tick
+     * @param time_us 时间，微秒
+     * @return 向上取整的 tick
+     */
+    uint64_t toTick(uint64_t time_us) const { return (time_us + tick_us_ - 1) / tick_us_; }
+
+    // region # Getter
+    bool empty() const { return size_ == 0; }
+
+    size_t size() const { return size_; }
+
+    uint64_t getTickUs() const { return tick_us_; }
+    // endregion
+
 private:
-    struct Comparator {
-        bool operator() (const Timer::ptr& lhs, const Timer::ptr& rhs) const;
-    };//比较定时器的智能指针的大小(按执行时间排序)
+    /// 第 0 层槽位数的位数
+    static const int ROOT_BITS = 8;
+    /// 第 1~3 层槽位数的位数
+    static const int LEVEL_BITS = 6;
+    /// 层数
+    static const int LEVELS = 4;
+    static const uint64_t ROOT_SIZE = 1ull << ROOT_BITS;
+    static const uint64_t LEVEL_SIZE = 1ull << LEVEL_BITS;
+    /// 时间轮能表示的最大 tick 差值
+    static const uint64_t MAX_SPAN = 1ull << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS);
+
+    /**
+     * @brief 第 level 层每个槽位跨度的位数
+     */
+    static int Shift(int level) { return level == 0 ? 0 : ROOT_BITS + (level - 1) * LEVEL_BITS; }
+
+    /**
+     * @brief 第 level 层的槽位数
+     */
+    static uint64_t Slots(int level) { return level == 0 ? ROOT_SIZE : LEVEL_SIZE; }
+
+    /**
+     * @brief 获取第 level 层第 index 个槽位的哨兵
+     */
+    TimerNode &slot(int level, uint64_t index) { return slots_[offset(level) + index]; }
+
+    const TimerNode &slot(int level, uint64_t index) const { return slots_[offset(level) + index]; }
+
+    static uint64_t offset(int level) { return level == 0 ? 0 : ROOT_SIZE + (level - 1) * LEVEL_SIZE; }
+
+    /**
+     * @brief 根据到期 tick 将节点挂到对应槽位
+     * @param node 节点
+     * @param expires 到期 tick
+     */
+    void link(TimerNode *node, uint64_t expires);
+
+    /**
+     * @brief 将第 level 层第 index 个槽位的节点重新分配到低层
+     * @param level 层
+     * @param index 槽位
+     */
+    void cascade(int level, uint64_t index);
+
+private:
+    /// 每个 tick 的微秒数
+    uint64_t tick_us_;
+    /// 下一个需要处理的 tick
+    uint64_t current_;
+    /// 节点总数
+    size_t size_;
+    /// 每层的节点数，第 0 层为空时可以直接跳到下一次 cascade
+    size_t level_size_[LEVELS];
+    /// 所有槽位的哨兵节点，槽位是以哨兵为头的双向循环链表
+    std::vector<TimerNode> slots_;
+};
+
+/**
+ * @brief 每个线程一个的定时器队列
+ * @details 时间轮只由所属线程访问，不加锁；其他线程通过收件箱（无锁的侵入式栈）把需要处理的节点交给所属线程
+ */
+class TimerQueue : NonCopyable {
+public:
+    /**
+     * @brief 构造函数
+     * @param tick_us 时间轮每个 tick 的微秒数
+     */
+    explicit TimerQueue(uint64_t tick_us);
+
+    /**
+     * @brief 把节点放入收件箱，可以在任意线程调用，节点的 queued_ 必须已经由调用者置位
+     * @param inbox 收件箱
+     * @param node 节点
+     */
+    static void Push(std::atomic<TimerNode *> &inbox, TimerNode *node);
+
+    /**
+     * @brief 取出收件箱中的所有节点
+     * @param inbox 收件箱
+     * @return 按放入顺序排列的链表，通过 queue_next_ 连接
+     */
+    static TimerNode *PopAll(std::atomic<TimerNode *> &inbox);
+
+    /**
+     * @brief 释放处理过程中摘下的定时器
+     */
+    void release();
+
+    /// 时间轮
+    TimerWheel wheel_;
+    /// 收件箱
+    std::atomic<TimerNode *> inbox_;
+    /// 所属线程正在等待到的时间，微秒，醒着的时候为 0，其他线程据此判断插入的定时器是否需要唤醒反应堆
+    std::atomic<uint64_t> wait_time_;
+    /// 到期节点的缓冲区，重复使用，到期处理不需要每次分配内存
+    std::vector<TimerNode *> expired_;
+    /// 摘下的定时器，处理完之后统一释放，重复使用
+    std::vector<Timer::ptr> released_;
 };
 
+/**
+ * @brief 定时器管理器
+ * @details 调用 getNextTime / listExpiredCallback 的线程各自拥有一个时间轮，在这些线程上增删定时器不加锁、不唤醒反应堆。
+ * 其他线程新增的定时器放入共享收件箱，由下一个醒来的线程收养；取消和提前则放入持有线程的收件箱。
+ * 新增的定时器早于所有线程正在等待的时间时才唤醒反应堆。
+ */
 class TimerManager {
     friend class Timer;
 public:
     /**
      * @brief 构造函数
+     * @param tick_us 时间轮每个 tick 的微秒数，定时器的精度
      */
-    TimerManager() : tickled_(false) {}
+    explicit TimerManager(uint64_t tick_us = 1000);
 
     /**
      * @brief 默认虚析构函数
      */
-    virtual ~TimerManager() = default;
+    virtual ~TimerManager();
 
     /**
      * @brief 向管理器新增一个定时器
-     * @param period 周期
+     * @param period 周期，毫秒
      * @param callback 定时器回调函数
      * @param recurring 是否重复
+     * @param slack 精度，毫秒，见 TimerSlack
      * @return 新增的定时器智能指针
      */
     Timer::ptr addTimer(uint64_t period, Timer::timer_callback cb
-                        ,bool recurring = false);
- 
+                        ,bool recurring = false, uint32_t slack = TimerSlack::PRECISE) {
+        // 毫秒接口至少按毫秒合并，和微秒级的时间轮 tick 无关
+        return addTimerUs(period * 1000, std::move(cb), recurring, std::max<uint32_t>(slack, 1) * 1000);
+    }
+
+    /**
+     * @brief 向管理器新增一个微秒级的定时器
+     * @details 实际精度受时间轮的 tick 限制，见构造函数
+     * @param period 周期，微秒
+     * @param callback 定时器回调函数
+     * @param recurring 是否重复
+     * @param slack 精度，微秒
+     * @return 新增的定时器智能指针
+     */
+    Timer::ptr addTimerUs(uint64_t period, Timer::timer_callback cb,
+                          bool recurring = false, uint32_t slack = 0);
+
     /**
      * @brief 向管理器新增一个条件定时器
-     * @param period 周期
+     * @param period 周期，毫秒
      * @param callback 定时器回调函数
      * @param weak_cond 弱智能指针作为条件
      * @param recurring 是否重复
+     * @param slack 精度，毫秒，见 TimerSlack
      * @return 新增的定时器智能指针
-     */ 
+     */
     Timer::ptr addCondTimer(uint64_t period, const Timer::timer_callback& cb,
-                            const std::weak_ptr<void> &weak_cond, bool recurring = false);
+                            const std::weak_ptr<void> &weak_cond, bool recurring = false,
+                            uint32_t slack = TimerSlack::PRECISE);
+
+    /**
+     * @brief 获得当前线程距离最近发生的定时器的时间，无锁
+     * @details 调用线程会成为管理器的一个定时器线程，之后它负责执行自己时间轮上的定时器
+     * @return 距离最近发生的定时器的时间，毫秒，向上取整
+     */
+    uint64_t getNextTime() {
+        uint64_t next = getNextTimeUs();
+        return next == ~0ull ? next : (next + 999) / 1000;
+    }
 
-    /** 
-     * @brief 获得距离最近发生的定时器的时间
-     * @return 距离最近发生的定时器的时间
-     */    
-    uint64_t getNextTime();
+    /**
+     * @brief 获得当前线程距离最近发生的定时器的时间，无锁
+     * @return 距离最近发生的定时器的时间，微秒
+     */
+    uint64_t getNextTimeUs();
 
     /**
-     * @brief 列出所有超时的定时器需要执行的回调函数
+     * @brief 列出当前线程所有超时的定时器需要执行的回调函数
      * @param callbacks 所有需要执行的回调函数
      */
     void listExpiredCallback(std::vector<Timer::timer_callback>& cbs);
-    
+
+    /**
+     * @brief 是否还有没有到期、没有取消的定时器
+     */
+    bool hasTimer() const { return timer_num_.load() != 0; }
+
 protected:
     /**
      * @brief 当插入一个定时器到堆顶时需要执行的操作
@@ -130,21 +442,114 @@ protected:
     virtual void onTimerInsertAtFront() {};
 
     /**
-     * @brief 向管理器新增一个定时器，有锁
-     * @param timer 新增的定时器
-     * @param lock 写锁
-     */    
-    void addTimer(const Timer::ptr &timer, RWMutex::WriteLock& lock);
+     * @brief 将当前线程绑定为定时器线程，已经绑定时直接返回
+     * @return 当前线程的定时器队列，线程数超过上限时返回 nullptr
+     */
+    TimerQueue *bindThread();
+
+    /**
+     * @brief 让一个由调用者持有内存的节点开始等待，不分配内存
+     * @details 节点的 slack_ 和 on_expire_ 必须已经设置，调用者应当先 renew() 开始新的一轮。
+     * 当前线程是定时器线程时挂到本线程的时间轮上，on_expire_ 在持有线程内执行，不能阻塞
+     * @param node 节点
+     * @param time 执行时间，微秒
+     */
+    void armNode(TimerNode *node, uint64_t time);
+
+    /**
+     * @brief 取消节点本轮的等待
+     * @param node 节点
+     * @return 是否在到期前取消，false 表示已经到期（on_expire_ 已经或者正在执行）或者没有在等待
+     */
+    bool disarmNode(TimerNode *node);
+
+    /**
+     * @brief 摘下所有节点，只能在所有定时器线程都停止之后调用
+     */
+    void clearAll();
+
+private:
+    /**
+     * @brief 获取当前线程的定时器队列
+     * @return 当前线程不是定时器线程时返回 nullptr
+     */
+    TimerQueue *localQueue() const;
+
+    /**
+     * @brief 让处于 ARMED 状态的节点按 req_time_ 生效：本线程能持有就直接挂上，否则交给持有线程或者共享收件箱
+     * @param node 节点
+     */
+    void schedule(TimerNode *node);
+
+    /**
+     * @brief 通知反应堆，只有新的执行时间早于相关线程的等待时间时才需要
+     * @param target 放入了哪个线程的收件箱，为空表示共享收件箱
+     * @param time 执行时间
+     */
+    void notify(TimerQueue *target, uint64_t time);
+
+    /**
+     * @brief 节点不再等待，持有线程是当前线程时立即摘下，否则交给持有线程摘下
+     * @param node 节点
+     */
+    void abandon(TimerNode *node);
+
+    /**
+     * @brief 把节点放入收件箱，节点已经在某个收件箱中时什么都不做
+     * @param inbox 收件箱
+     * @param node 节点
+     * @return 是否放入
+     */
+    static bool enqueue(std::atomic<TimerNode *> &inbox, TimerNode *node);
+
+    /**
+     * @brief 处理共享收件箱和本线程收件箱中的节点
+     * @param queue 当前线程的队列
+     */
+    void drain(TimerQueue *queue);
+
+    /**
+     * @brief 根据节点当前的状态把它挂到本线程的时间轮上或者摘下，由其他线程持有时转交
+     * @param queue 当前线程的队列
+     * @param node 节点
+     */
+    void reconcile(TimerQueue *queue, TimerNode *node);
 
+    /**
+     * @brief 按 req_time_ 和精度把节点挂到时间轮上，已经挂上的重新挂
+     * @param queue 持有节点的队列
+     * @param node 节点
+     */
+    static void place(TimerQueue *queue, TimerNode *node);
+
+    /**
+     * @brief 节点不再等待：摘下，定时器释放回调和自身的引用，节点不再被任何线程持有
+     * @param queue 持有节点的队列
+     * @param node 节点
+     */
+    static void drop(TimerQueue *queue, TimerNode *node);
 
 private:
-    RWMutex mutex_;
-    // 定时器集合,按发生时间排列
-    std::set<Timer::ptr, Timer::Comparator> timers_; 
-    // 是否需要通知
-    bool tickled_;           
+    /// 定时器线程数的上限
+    static const uint32_t MAX_QUEUES = 256;
+
+    /// 管理器的唯一编号，线程局部的绑定表以它为键
+    uint64_t id_;
+    /// 时间轮每个 tick 的微秒数
+    uint64_t tick_us_;
+    /// 非定时器线程新增的定时器，由下一个醒来的定时器线程收养
+    std::atomic<TimerNode *> shared_inbox_;
+    /// 没有到期、没有取消的定时器数量
+    std::atomic<uint64_t> timer_num_;
+    /// 本轮等待是否已经通知过
+    std::atomic<bool> tickled_;
+    /// 所有定时器线程的队列，只增不减
+    std::atomic<TimerQueue *> queues_[MAX_QUEUES];
+    std::atomic<uint32_t> queue_num_;
+    /// 只用于创建队列
+    Mutex mutex_;
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
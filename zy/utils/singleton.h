@@ -18,7 +18,18 @@ public:
     }
 };
 
-
+/**
+ * @brief 不析构的单例，用于退出时仍可能被其它静态对象或 thread_local 对象的析构函数使用的实例
+ * @tparam T 类型
+ */
+template<typename T>
+class ImmortalSingleton : NonCopyable {
+public:
+    static T &GetInstance() {
+        static T *instance_ = new T;
+        return *instance_;
+    }
+};
 
 }
 
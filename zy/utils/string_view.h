@@ -0,0 +1,96 @@
+#ifndef __ZY_STRING_VIEW_H__
+#define __ZY_STRING_VIEW_H__
+
+#include <cstring>
+#include <string>
+#include <ostream>
+#include <algorithm>
+
+namespace zy {
+
+/**
+ * @brief 不持有内存的只读字符串视图，C++11 中 std::string_view 的替代
+ * @details 只保存指针和长度，复制的开销和指针相同；视图有效期不超过底层内存，由调用方保证。
+ */
+class StringView {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    StringView() : data_(nullptr), size_(0) { }
+
+    StringView(const char *data, size_t size) : data_(data), size_(size) { }
+
+    StringView(const char *str) : data_(str), size_(strlen(str)) { }
+
+    StringView(const std::string &str) : data_(str.data()), size_(str.size()) { }
+
+    const char *data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const char *begin() const { return data_; }
+
+    const char *end() const { return data_ + size_; }
+
+    char operator[](size_t pos) const { return data_[pos]; }
+
+    /**
+     * @brief 子视图，pos 超出范围时返回空视图
+     */
+    StringView substr(size_t pos, size_t n = npos) const {
+        if (pos > size_) {
+            return StringView();
+        }
+        return StringView(data_ + pos, std::min(n, size_ - pos));
+    }
+
+    /**
+     * @brief 查找字符
+     * @return 下标，找不到时返回 npos
+     */
+    size_t find(char c, size_t pos = 0) const {
+        if (pos >= size_) {
+            return npos;
+        }
+        const void *p = memchr(data_ + pos, c, size_ - pos);
+        return p ? static_cast<const char *>(p) - data_ : npos;
+    }
+
+    /**
+     * @brief 查找子串
+     * @return 下标，找不到时返回 npos
+     */
+    size_t find(StringView str, size_t pos = 0) const {
+        if (pos > size_ || str.size_ > size_ - pos) {
+            return npos;
+        }
+        const char *p = std::search(data_ + pos, data_ + size_, str.data_, str.data_ + str.size_);
+        return p == data_ + size_ && !str.empty() ? npos : p - data_;
+    }
+
+    bool startsWith(StringView prefix) const {
+        return size_ >= prefix.size_ && memcmp(data_, prefix.data_, prefix.size_) == 0;
+    }
+
+    std::string toString() const { return std::string(data_, size_); }
+
+    bool operator==(StringView rhs) const {
+        return size_ == rhs.size_ && (size_ == 0 || memcmp(data_, rhs.data_, size_) == 0);
+    }
+
+    bool operator!=(StringView rhs) const { return !(*this == rhs); }
+
+private:
+    const char *data_;
+    size_t size_;
+};
+
+inline std::ostream &operator<<(std::ostream &os, StringView view) {
+    return os.write(view.data(), view.size());
+}
+
+}
+
+#endif //__ZY_STRING_VIEW_H__
@@ -1,6 +1,7 @@
 #include "../log.h"
 #include "util.h"
 #include "../fiber.h"
+#include "../clock.h"
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
@@ -19,9 +20,7 @@ uint32_t getFiberId() {
 }
 
 uint64_t getElapseMs() {
-    struct timespec ts{};
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);            // 系统开始运行到现在的时间
-    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    return Clock::CoarseMs();                           // 系统开始运行到现在的时间，日志使用，粗粒度即可
 }
 
 std::string getThreadName() {
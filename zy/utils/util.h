@@ -39,8 +39,8 @@ uint64_t getElapseMs();
 void setThreadName(const std::string &name);
 
 /**
- * @brief 获取当前时间
- * @return 系统当前时间
+ * @brief 获取当前墙上时间，会随 NTP 调整跳变，计时请使用 Clock
+ * @return 系统当前时间，毫秒
  */
 uint64_t getCurrentTime();
 